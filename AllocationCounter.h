@@ -0,0 +1,4 @@
+#pragma once
+
+/// Number of global operator new calls made by the process so far
+unsigned long long AllocationCount();
@@ -0,0 +1,94 @@
+#include "ClockSync.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+long long MonotonicMicroseconds(std::chrono::steady_clock::time_point time)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+long long MonotonicMicroseconds()
+{
+	return MonotonicMicroseconds(std::chrono::steady_clock::now());
+}
+
+ClockSync::ClockSync(size_t window)
+	: window(std::max<size_t>(window, 1)),
+	hasEstimate(false),
+	offset(0),
+	delay(0),
+	exchanges(0),
+	rejected(0)
+{
+}
+
+bool ClockSync::OnExchange(long long t0, long long t1, long long t2, long long t3)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	// The server may hold the request, the time it did is not part of the path
+	Sample sample;
+	sample.Delay = (t3 - t0) - (t2 - t1);
+	sample.Offset = ((t1 - t0) + (t2 - t3)) / 2;
+
+	if (t3 < t0 || t2 < t1 || sample.Delay < 0)
+	{
+		this->rejected++;
+		return false;
+	}
+
+	this->exchanges++;
+	this->samples.push_back(sample);
+	if (this->samples.size() > this->window)
+	{
+		this->samples.pop_front();
+	}
+
+	auto best = *std::min_element(this->samples.begin(), this->samples.end(), [](Sample const& a, Sample const& b) { return a.Delay < b.Delay; });
+	if (this->hasEstimate && best.Offset == this->offset && best.Delay == this->delay)
+	{
+		return false;
+	}
+
+	if (!this->hasEstimate)
+	{
+		spdlog::info("Clock sync :: First estimate, offset {} us, round trip {} us", best.Offset, best.Delay);
+	}
+
+	this->hasEstimate = true;
+	this->offset = best.Offset;
+	this->delay = best.Delay;
+	return true;
+}
+
+bool ClockSync::HasEstimate() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->hasEstimate;
+}
+
+long long ClockSync::Offset() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->offset;
+}
+
+long long ClockSync::Delay() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->delay;
+}
+
+void ClockSync::LogSummary()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (!this->hasEstimate)
+	{
+		spdlog::info("Clock sync :: No estimate, {} exchanges rejected", this->rejected);
+		return;
+	}
+
+	spdlog::info("Clock sync :: Offset {} us, round trip {} us from {} exchanges, {} rejected", this->offset, this->delay, this->exchanges, this->rejected);
+}
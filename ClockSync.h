@@ -0,0 +1,63 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+/// Controller time sent to the server, the steady clock in us. It never steps, so differences of
+/// two timestamps are durations; the server relates them to its own clock with the ClockSync offset.
+long long MonotonicMicroseconds(std::chrono::steady_clock::time_point time);
+long long MonotonicMicroseconds();
+
+/// Timestamps a time message carries, in the clock of the side that took them
+class ClockExchange
+{
+public:
+	/// Request sent
+	long long T0;
+	/// Request received by the answering side, only set in answers
+	long long T1;
+	/// Answer sent by the answering side, only set in answers
+	long long T2;
+	bool IsAnswer;
+};
+
+/// Estimates the offset of the server clock from the controller clock with NTP-style exchanges:
+/// t0 request sent, t1 request received by the server, t2 answer sent, t3 answer received.
+/// Of the last exchanges the one with the shortest round trip wins, as queuing delays make paths asymmetric.
+class ClockSync
+{
+public:
+	/// window is the number of recent exchanges the estimate is picked from
+	ClockSync(size_t window = 8);
+
+	/// Adds an exchange (t0 and t3 controller, t1 and t2 server time), returns whether the estimate changed
+	bool OnExchange(long long t0, long long t1, long long t2, long long t3);
+
+	bool HasEstimate() const;
+	/// Server time minus controller time (in us)
+	long long Offset() const;
+	/// Network round trip of the exchange the offset was taken from (in us)
+	long long Delay() const;
+
+	void LogSummary();
+
+private:
+	class Sample
+	{
+	public:
+		long long Offset;
+		long long Delay;
+	};
+
+	const size_t window;
+
+	/// Guards everything below
+	mutable std::mutex mutex;
+	std::deque<Sample> samples;
+	bool hasEstimate;
+	long long offset;
+	long long delay;
+	unsigned long long exchanges;
+	/// Exchanges whose timestamps contradict each other, e.g. an answer to a request never sent
+	unsigned long long rejected;
+};
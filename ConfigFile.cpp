@@ -1,5 +1,6 @@
 #include "ConfigFile.h"
 
+#include <algorithm>
 #include <fstream>
 
 std::string trim(std::string const& source, char const* delims = " \t\r\n") {
@@ -33,6 +34,8 @@ ConfigFile::ConfigFile(std::string const& configFile) {
 
 		if (line[0] == '[') {
 			inSection = trim(line.substr(1, line.find(']') - 1));
+			if (std::find(sections_.begin(), sections_.end(), inSection) == sections_.end())
+				sections_.push_back(inSection);
 			continue;
 		}
 
@@ -69,4 +72,8 @@ Chameleon const& ConfigFile::Value(std::string const& section, std::string const
 	catch (const char *) {
 		return content_.insert(std::make_pair(section + '/' + entry, Chameleon(value))).first->second;
 	}
-}
\ No newline at end of file
+}
+
+std::vector<std::string> const& ConfigFile::Sections() const {
+	return sections_;
+}
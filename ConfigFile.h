@@ -3,11 +3,13 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include "Chameleon.h"
 
 class ConfigFile {
 	std::map<std::string, Chameleon> content_;
+	std::vector<std::string> sections_;
 
 public:
 	ConfigFile(std::string const& configFile);
@@ -16,6 +18,9 @@ public:
 
 	Chameleon const& Value(std::string const& section, std::string const& entry, double value);
 	Chameleon const& Value(std::string const& section, std::string const& entry, std::string const& value);
+
+	// Section names in the order they appear in the file
+	std::vector<std::string> const& Sections() const;
 };
 
 #endif
\ No newline at end of file
@@ -1,13 +1,33 @@
 #include "EnginesController.h" 
+#include "Tracer.h"
 
+#ifdef WDS_SIMULATED_HARDWARE
+#include "SimulatedDriver.h"
+#else
 #include <fastech/StdAfx.h>
-#include <iostream> 
 #include <fastech/FAS_EziMOTIONPlusR.h>
 #include <fastech/COMM_Define.h>
 #include <fastech/MOTION_DEFINE.h>
 #include <fastech/ReturnCodes_Define.h>
+#endif
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream> 
+#include <stdexcept>
+#include <thread>
 #include <spdlog/spdlog.h>  
 
+namespace
+{
+	/// Result of a driver command skipped because a stop preempted the running update
+	const int CommandDiscarded = -1;
+	/// Axis status bit set while the drive reports any alarm
+	const DWORD AxisStatusError = 0x00000001;
+}
+
+/// Issues a driver call on an axis as a trace event named after the driver function
+#define TRACED_BUS_CALL(function, portNo, slaveNo, ...) (TraceScope(#function, "bus", slaveNo), function(portNo, slaveNo, ##__VA_ARGS__))
+
 EnginesController::EnginesController(
 	int portNo,
 	int baudrate, 
@@ -18,17 +38,31 @@ EnginesController::EnginesController(
 	int engine1EasyStop,
 	int engine2EasyStop, 
 	int engine1EasyChange,
-	int engine2EasyChange
+	int engine2EasyChange,
+	HardwareStateStore* stateStore,
+	PeriodicScheduler* scheduler,
+	StateCheckpoint* checkpoint
 ) : portNo(portNo),
-	baudrate((unsigned long)baudrate), 
 	engine1SlaveNo(engine1SlaveNo),
 	engine2SlaveNo(engine2SlaveNo),
+	baudrate((unsigned long)baudrate), 
+	stateStore(stateStore),
+	scheduler(scheduler),
+	checkpoint(checkpoint),
 	engine1EasyStart(engine1EasyStart),
 	engine2EasyStart(engine2EasyStart),
 	engine1EasyStop(engine1EasyStop),
 	engine2EasyStop(engine2EasyStop),
 	engine1EasyChange(engine1EasyChange),
-	engine2EasyChange(engine2EasyChange)
+	engine2EasyChange(engine2EasyChange),
+	stopGeneration(0),
+	activeGeneration(0),
+	programActive(false),
+	maxStopLatency(0),
+	rampTickInterval(std::chrono::milliseconds(10)),
+	velocityPollInterval(0),
+	velocityPollTask(0),
+	velocityTolerance(0)
 {
 	spdlog::info("Created Hardware Controller to connect on portNo {} with baudrate {}", portNo, baudrate);
 
@@ -43,6 +77,10 @@ EnginesController::EnginesController(
 
 EnginesController::~EnginesController()
 {
+	if (this->velocityPollTask != 0)
+	{
+		this->scheduler->Remove(this->velocityPollTask);
+	}
 }
 
 bool EnginesController::Connect()
@@ -56,11 +94,16 @@ bool EnginesController::Connect()
 	spdlog::info("Hardware Controller :: Connecting on portNo {} with baudrate {}.", this->portNo, this->baudrate);
 
 	// Connect to engines
+	bool connected;
+	{
+		TraceScope trace("FAS_Connect", "bus");
+		connected = FAS_Connect(this->portNo, this->baudrate);
+	}
 
 	// D E B U G
 
     //if (false)
-	if (!FAS_Connect(this->portNo, this->baudrate)) 
+	if (!connected) 
 	{
 		spdlog::error("Hardware Controller :: Connecting on portNo {} with baudrate {} failed.", this->portNo, this->baudrate);
 		this->IsConnectedToEngines = FALSE;
@@ -71,7 +114,17 @@ bool EnginesController::Connect()
 	//this->enginesEnabled = true;
 	this->SetEnginesEnabled(1); 
 	this->IsConnectedToEngines = TRUE;
+
+	if (this->velocityPollInterval.count() > 0)
+	{
+		this->velocityPollTask = this->scheduler->Add("velocity poll", this->velocityPollInterval, [this]
+		{
+			this->PollVelocity();
+			return true;
+		});
+	}
 	
+	this->SaveCheckpoint(0, this->engine1Direction, 0, this->engine2Direction);
 	spdlog::info("Hardware Controller :: Successfully connected to engines."); 
 
 	return true;
@@ -84,11 +137,22 @@ void EnginesController::Disconnect()
 		return;
 	}
 
+	if (this->velocityPollTask != 0)
+	{
+		this->scheduler->Remove(this->velocityPollTask);
+		this->velocityPollTask = 0;
+	}
+
 	// D E B U G
 	//this->enginesEnabled = false;
 	this->SetEnginesEnabled(0);   
-	FAS_Close((byte)this->portNo);  
+	{
+		std::lock_guard<std::mutex> lock(this->busMutex);
+		TraceScope trace("FAS_Close", "bus");
+		FAS_Close((BYTE)this->portNo);  
+	}
 	this->IsConnectedToEngines = FALSE;
+	this->SaveCheckpoint(0, this->engine1Direction, 0, this->engine2Direction);
 
 	spdlog::info("Hardware Controller :: Disconnected from engines.");
 }
@@ -112,7 +176,128 @@ bool EnginesController::ToogleConnection(CommandType command)
 	return false;
 }
 
-HardwareState EnginesController::UpdateHardwareState(HardwareState update)
+bool EnginesController::IsConnected() const
+{
+	return this->IsConnectedToEngines;
+}
+
+void EnginesController::SetRampTickInterval(std::chrono::microseconds interval)
+{
+	this->rampTickInterval = interval;
+}
+
+void EnginesController::SetVelocityPollInterval(std::chrono::microseconds interval)
+{
+	this->velocityPollInterval = interval;
+}
+
+void EnginesController::SetVelocityTolerance(int tolerance)
+{
+	this->velocityTolerance = tolerance;
+}
+
+void EnginesController::SetGearing(AxisGearing gearing)
+{
+	if (gearing.Enabled && (gearing.Master < 1 || gearing.Master > 2 || gearing.Ratio < 0))
+	{
+		throw std::invalid_argument("Gearing needs master engine 1 or 2 and a non-negative ratio");
+	}
+
+	std::lock_guard<std::mutex> lock(this->updateMutex);
+	this->gearing = gearing;
+
+	if (gearing.Enabled)
+	{
+		spdlog::info("Hardware Controller :: Engine {} follows engine {} at ratio {} offset {}{}", 3 - gearing.Master, gearing.Master, gearing.Ratio, gearing.Offset, gearing.Inverted ? " inverted" : "");
+	}
+}
+
+int EnginesController::FollowerEngine() const
+{
+	return this->gearing.Enabled ? 3 - this->gearing.Master : 0;
+}
+
+bool EnginesController::ResumeFromCheckpoint()
+{
+	auto saved = this->checkpoint != nullptr ? this->checkpoint->Restored() : CheckpointState();
+	if (!saved.Valid || !saved.EnginesConnected)
+	{
+		return false;
+	}
+
+	spdlog::info("Hardware Controller :: Engines were connected before the restart, reconnecting.");
+
+	// Enabling a servo that is already enabled leaves a running engine untouched
+	if (!this->Connect())
+	{
+		return false;
+	}
+
+	long actualEngine1Speed = 0;
+	long actualEngine2Speed = 0;
+	{
+		std::lock_guard<std::mutex> lock(this->busMutex);
+		TRACED_BUS_CALL(FAS_GetActualVel, this->portNo, this->engine1SlaveNo, &actualEngine1Speed);
+		TRACED_BUS_CALL(FAS_GetActualVel, this->portNo, this->engine2SlaveNo, &actualEngine2Speed);
+	}
+
+	std::lock_guard<std::mutex> lock(this->updateMutex);
+	this->engine1Speed = this->ReconcileSpeed(actualEngine1Speed, saved.Engine1Speed);
+	this->engine2Speed = this->ReconcileSpeed(actualEngine2Speed, saved.Engine2Speed);
+	this->engine1Direction = saved.Engine1Direction;
+	this->engine2Direction = saved.Engine2Direction;
+
+	if (this->engine1Speed != saved.Engine1Speed || this->engine2Speed != saved.Engine2Speed)
+	{
+		spdlog::warn("Hardware Controller :: Engines run at e1s: {} e2s: {} instead of the checkpointed e1s: {} e2s: {}, resuming from the actual speeds.",
+			actualEngine1Speed, actualEngine2Speed, saved.Engine1Speed, saved.Engine2Speed);
+	}
+
+	spdlog::info("Hardware Controller :: Resumed engines at e1s: {} e2s: {}", this->engine1Speed, this->engine2Speed);
+
+	this->stateStore->SetEngines(this->engine1Speed, this->engine1Direction, this->engine2Speed, this->engine2Direction, StateSource::EnginesDriver);
+	this->SaveCheckpoint(this->engine1Speed, this->engine1Direction, this->engine2Speed, this->engine2Direction);
+	return true;
+}
+
+int EnginesController::ReconcileSpeed(long actualSpeed, int commandedSpeed) const
+{
+	if (commandedSpeed > 0 && std::labs(actualSpeed - commandedSpeed) <= this->velocityTolerance)
+	{
+		return commandedSpeed;
+	}
+
+	return (int)actualSpeed;
+}
+
+void EnginesController::SaveCheckpoint(int engine1Speed, int engine1Direction, int engine2Speed, int engine2Direction)
+{
+	if (this->checkpoint != nullptr)
+	{
+		this->checkpoint->SetEngines(this->IsConnectedToEngines, engine1Speed, engine1Direction, engine2Speed, engine2Direction);
+	}
+}
+
+void EnginesController::ApplyGearing(HardwareState& state) const
+{
+	if (!this->gearing.Enabled)
+	{
+		return;
+	}
+
+	if (this->gearing.Master == 1)
+	{
+		state.Engine2Speed = this->gearing.FollowerSpeed(state.Engine1Speed);
+		state.Engine2Direction = this->gearing.FollowerDirection(state.Engine1Direction);
+	}
+	else
+	{
+		state.Engine1Speed = this->gearing.FollowerSpeed(state.Engine2Speed);
+		state.Engine1Direction = this->gearing.FollowerDirection(state.Engine2Direction);
+	}
+}
+
+HardwareState EnginesController::UpdateHardwareState(HardwareState update, unsigned long stopGeneration)
 {
 	// Set engines parameters
 	if (!this->IsConnectedToEngines)
@@ -121,26 +306,54 @@ HardwareState EnginesController::UpdateHardwareState(HardwareState update)
 		return HardwareState();
 	}
 
+	if (this->programActive)
+	{
+		spdlog::warn("Hardware Controller :: Refused engine parameters while a motion program is running.");
+		return this->stateStore->Current()->ToHardwareState();
+	}
+
+	std::lock_guard<std::mutex> lock(this->updateMutex);
+
+	if (stopGeneration != this->stopGeneration.load())
+	{
+		spdlog::warn("Hardware Controller :: Discarded engine parameters received before a stop request.");
+		return this->stateStore->Current()->ToHardwareState();
+	}
+
+	this->activeGeneration = stopGeneration;
 	this->UpdateEnginesState(update);
 
-	auto returnedState = HardwareState();
-	returnedState.Engine1Direction = this->engine1Direction;
-	returnedState.Engine2Direction = this->engine2Direction;
-	returnedState.Engine1Speed = this->engine1Speed;
-	returnedState.Engine2Speed = this->engine2Speed;
+	if (this->IsRampAborted())
+	{
+		spdlog::warn("Hardware Controller :: Engine parameters update was preempted by a stop request.");
+		this->engine1Speed = 0;
+		this->engine2Speed = 0;
+	}
+
+	this->stateStore->SetEngines(this->engine1Speed, this->engine1Direction, this->engine2Speed, this->engine2Direction, StateSource::EnginesDriver);
+	this->SaveCheckpoint(this->engine1Speed, this->engine1Direction, this->engine2Speed, this->engine2Direction);
 
-	return returnedState;
+	return this->stateStore->Current()->ToHardwareState();
 }
 
 void EnginesController::UpdateEnginesState(HardwareState update)
 {  
+	TraceScope trace("UpdateEnginesState", "engines");
+
+	// Setpoints sent for the follower are ignored, it always runs geared to the master
+	this->ApplyGearing(update);
+
 	long actualEngine1Speed = 0;
 	long actualEngine2Speed = 0;
-	FAS_GetActualVel(this->portNo, this->engine1SlaveNo, &actualEngine1Speed);
-	FAS_GetActualVel(this->portNo, this->engine2SlaveNo, &actualEngine2Speed);
+	{
+		std::lock_guard<std::mutex> lock(this->busMutex);
+		TRACED_BUS_CALL(FAS_GetActualVel, this->portNo, this->engine1SlaveNo, &actualEngine1Speed);
+		TRACED_BUS_CALL(FAS_GetActualVel, this->portNo, this->engine2SlaveNo, &actualEngine2Speed);
+	}
 
-	this->engine1Speed = actualEngine1Speed;
-	this->engine2Speed = actualEngine2Speed;
+	// An engine within tolerance of its commanded speed is not ramped again for the difference
+	this->engine1Speed = this->ReconcileSpeed(actualEngine1Speed, this->engine1Speed);
+	this->engine2Speed = this->ReconcileSpeed(actualEngine2Speed, this->engine2Speed);
 
 	spdlog::info("Hardware Controller :: Current engine 1 speed: {} current engine 2 speed {}", actualEngine1Speed, actualEngine2Speed);
 	spdlog::info("Hardware Controller :: Updated engine 1 speed: {} current engine 2 speed {}", update.Engine1Speed, update.Engine2Speed);
@@ -168,6 +381,12 @@ void EnginesController::UpdateEnginesState(HardwareState update)
 		this->SetEnginesEnabled(true);
 	} 
 
+	if (this->gearing.Enabled)
+	{
+		this->MoveGearedEngines(previousEngine1Speed, previousEngine2Speed);
+		return;
+	}
+
 	if (engine1Starting && engine2Starting)
 	{
 		StartEngines();
@@ -219,25 +438,297 @@ void EnginesController::UpdateEnginesState(HardwareState update)
 	}
 }
 
+VelocityResult EnginesController::SetVelocities(int engine1Speed, int engine1Direction, int engine2Speed, int engine2Direction, unsigned long stopGeneration)
+{
+	// Runs on the scheduler thread, which must not wait for an update that is ramping on it
+	std::unique_lock<std::mutex> lock(this->updateMutex, std::try_to_lock);
+	if (!lock.owns_lock())
+	{
+		return VelocitiesBusy;
+	}
+
+	if (!this->IsConnectedToEngines || stopGeneration != this->stopGeneration.load())
+	{
+		return VelocitiesStopped;
+	}
+
+	this->activeGeneration = stopGeneration;
+
+	HardwareState velocities = HardwareState();
+	velocities.Engine1Speed = engine1Speed;
+	velocities.Engine1Direction = engine1Direction;
+	velocities.Engine2Speed = engine2Speed;
+	velocities.Engine2Direction = engine2Direction;
+	this->ApplyGearing(velocities);
+
+	engine1Speed = velocities.Engine1Speed;
+	engine1Direction = velocities.Engine1Direction;
+	engine2Speed = velocities.Engine2Speed;
+	engine2Direction = velocities.Engine2Direction;
+
+	this->SetEngineVelocity(this->engine1SlaveNo, this->engine1Speed, this->engine1Direction, engine1Speed, engine1Direction);
+	this->SetEngineVelocity(this->engine2SlaveNo, this->engine2Speed, this->engine2Direction, engine2Speed, engine2Direction);
+
+	this->engine1Speed = engine1Speed;
+	this->engine2Speed = engine2Speed;
+	this->engine1Direction = engine1Direction;
+	this->engine2Direction = engine2Direction;
+
+	if (this->IsRampAborted())
+	{
+		return VelocitiesStopped;
+	}
+
+	this->stateStore->SetEngines(this->engine1Speed, this->engine1Direction, this->engine2Speed, this->engine2Direction, StateSource::EnginesDriver);
+	this->SaveCheckpoint(this->engine1Speed, this->engine1Direction, this->engine2Speed, this->engine2Direction);
+	return VelocitiesApplied;
+}
+
+void EnginesController::SetProgramActive(bool active)
+{
+	this->programActive = active;
+}
+
+bool EnginesController::IsApplyingUpdate()
+{
+	std::unique_lock<std::mutex> lock(this->updateMutex, std::try_to_lock);
+	return !lock.owns_lock();
+}
+
+std::chrono::microseconds EnginesController::EmergencyStop(bool decelerate, std::chrono::steady_clock::time_point receivedAt)
+{
+	int result1;
+	int result2;
+	{
+		// Bumping the generation under the bus lock guarantees no ramp step is issued after the stop
+		std::lock_guard<std::mutex> lock(this->busMutex);
+		this->stopGeneration++;
+
+		if (decelerate)
+		{
+			result1 = TRACED_BUS_CALL(FAS_MoveStop, this->portNo, this->engine1SlaveNo);
+			result2 = TRACED_BUS_CALL(FAS_MoveStop, this->portNo, this->engine2SlaveNo);
+		}
+		else
+		{
+			result1 = TRACED_BUS_CALL(FAS_EmergencyStop, this->portNo, this->engine1SlaveNo);
+			result2 = TRACED_BUS_CALL(FAS_EmergencyStop, this->portNo, this->engine2SlaveNo);
+		}
+	}
+
+	auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - receivedAt);
+
+	auto maxLatency = this->maxStopLatency.load();
+	while (latency.count() > maxLatency && !this->maxStopLatency.compare_exchange_weak(maxLatency, latency.count()))
+	{
+	}
+
+	if (result1 != FMM_OK || result2 != FMM_OK)
+	{
+		spdlog::error("Hardware Controller :: Stop request failed with results {} and {}", result1, result2);
+	}
+
+	spdlog::info("Hardware Controller :: Engines stopped in {} us (worst {} us)", latency.count(), this->maxStopLatency.load());
+
+	auto snapshot = this->stateStore->Current();
+	this->stateStore->SetEngines(0, snapshot->Engine1Direction.Value, 0, snapshot->Engine2Direction.Value, StateSource::EnginesDriver);
+	this->SaveCheckpoint(0, snapshot->Engine1Direction.Value, 0, snapshot->Engine2Direction.Value);
+
+	return latency;
+}
+
+unsigned long EnginesController::StopGeneration() const
+{
+	return this->stopGeneration.load();
+}
+
+std::chrono::microseconds EnginesController::MaxStopLatency() const
+{
+	return std::chrono::microseconds(this->maxStopLatency.load());
+}
+
+bool EnginesController::IsRampAborted() const
+{
+	return this->stopGeneration.load() != this->activeGeneration;
+}
+
+int EnginesController::MoveVelocity(int engineSlaveNo, int speed, int direction)
+{
+	std::lock_guard<std::mutex> lock(this->busMutex);
+
+	if (this->IsRampAborted())
+	{
+		return CommandDiscarded;
+	}
+
+	return TRACED_BUS_CALL(FAS_MoveVelocity, this->portNo, engineSlaveNo, speed, direction);
+}
+
+int EnginesController::VelocityOverride(int engineSlaveNo, int speed)
+{
+	std::lock_guard<std::mutex> lock(this->busMutex);
+
+	if (this->IsRampAborted())
+	{
+		return CommandDiscarded;
+	}
+
+	return TRACED_BUS_CALL(FAS_VelocityOverride, this->portNo, engineSlaveNo, speed);
+}
+
+int EnginesController::MoveStop(int engineSlaveNo)
+{
+	std::lock_guard<std::mutex> lock(this->busMutex);
+
+	if (this->IsRampAborted())
+	{
+		return CommandDiscarded;
+	}
+
+	return TRACED_BUS_CALL(FAS_MoveStop, this->portNo, engineSlaveNo);
+}
+
+void EnginesController::RunRamp(Ramp& ramp)
+{
+	std::mutex doneMutex;
+	std::condition_variable doneCondition;
+	bool done = false;
+
+	this->scheduler->Add("ramp", this->rampTickInterval, [&]
+	{
+		if (this->RampTick(ramp))
+		{
+			return true;
+		}
+
+		std::lock_guard<std::mutex> lock(doneMutex);
+		done = true;
+		doneCondition.notify_one();
+		return false;
+	});
+
+	std::unique_lock<std::mutex> lock(doneMutex);
+	doneCondition.wait(lock, [&] { return done; });
+}
+
+bool EnginesController::RampTick(Ramp& ramp)
+{
+	TraceScope trace("ramp tick", "engines", ramp.StepsDone);
+
+	if (this->IsRampAborted())
+	{
+		return false;
+	}
+
+	if (ramp.StepsDone == ramp.Steps)
+	{
+		for (int i = 0; i < ramp.AxisCount; i++)
+		{
+			if (ramp.Axes[i].StopsAxis)
+			{
+				this->MoveStop(ramp.Axes[i].SlaveNo);
+			}
+		}
+
+		return false;
+	}
+
+	for (int i = 0; i < ramp.AxisCount; i++)
+	{
+		RampAxis& axis = ramp.Axes[i];
+
+		// Derived from the speed just commanded to the master, so both axes change in the same step
+		if (axis.FollowsAxis >= 0)
+		{
+			int speed = ramp.Gearing.FollowerSpeed((int)ceil(ramp.Axes[axis.FollowsAxis].Speed));
+			this->SetEngineVelocity(axis.SlaveNo, (int)axis.Speed, axis.Direction, speed, axis.Direction);
+			axis.Speed = speed;
+			continue;
+		}
+
+		axis.Speed += axis.Step;
+
+		if (ramp.StepsDone == 0 && axis.StartsAxis)
+		{
+			this->MoveVelocity(axis.SlaveNo, (int)ceil(axis.Speed), axis.Direction);
+		}
+		else
+		{
+			this->VelocityOverride(axis.SlaveNo, (int)ceil(axis.Speed));
+		}
+	}
+
+	ramp.StepsDone++;
+	return true;
+}
+
+void EnginesController::PollVelocity()
+{
+	if (!this->IsConnectedToEngines)
+	{
+		return;
+	}
+
+	long actualEngine1Speed = 0;
+	long actualEngine2Speed = 0;
+	DWORD engine1Status = 0;
+	DWORD engine2Status = 0;
+	{
+		std::lock_guard<std::mutex> lock(this->busMutex);
+		TRACED_BUS_CALL(FAS_GetActualVel, this->portNo, this->engine1SlaveNo, &actualEngine1Speed);
+		TRACED_BUS_CALL(FAS_GetActualVel, this->portNo, this->engine2SlaveNo, &actualEngine2Speed);
+		TRACED_BUS_CALL(FAS_GetAxisStatus, this->portNo, this->engine1SlaveNo, &engine1Status);
+		TRACED_BUS_CALL(FAS_GetAxisStatus, this->portNo, this->engine2SlaveNo, &engine2Status);
+	}
+
+	int alarms = ((engine1Status & AxisStatusError) ? 1 : 0) | ((engine2Status & AxisStatusError) ? 2 : 0);
+	this->stateStore->SetEngineReadings((int)actualEngine1Speed, (int)actualEngine2Speed, alarms, StateSource::EnginesDriver);
+}
+
+void EnginesController::SetEngineVelocity(int engineSlaveNo, int previousSpeed, int previousDirection, int speed, int direction)
+{
+	if (speed <= 0)
+	{
+		if (previousSpeed > 0)
+		{
+			this->MoveStop(engineSlaveNo);
+		}
+		return;
+	}
+
+	if (previousSpeed <= 0 || direction != previousDirection)
+	{
+		this->MoveVelocity(engineSlaveNo, speed, direction);
+		return;
+	}
+
+	if (speed != previousSpeed)
+	{
+		this->VelocityOverride(engineSlaveNo, speed);
+	}
+}
+
 void EnginesController::SetEnginesEnabled(int enabled)
 {
+	std::lock_guard<std::mutex> lock(this->busMutex);
+
 	int result1 = 0;
 	int result2 = 0;
 
 	if (!enabled) 
 	{
-		result1 = FAS_MoveStop(this->portNo, this->engine1SlaveNo);
-		result2 = FAS_MoveStop(this->portNo, this->engine2SlaveNo);
+		result1 = TRACED_BUS_CALL(FAS_MoveStop, this->portNo, this->engine1SlaveNo);
+		result2 = TRACED_BUS_CALL(FAS_MoveStop, this->portNo, this->engine2SlaveNo);
 	}
 
-	if (FAS_IsSlaveExist((byte)this->portNo, this->engine1SlaveNo))
+	if (TRACED_BUS_CALL(FAS_IsSlaveExist, (BYTE)this->portNo, this->engine1SlaveNo))
 	{
-		result1 = FAS_ServoEnable(this->portNo, this->engine1SlaveNo, enabled);
+		result1 = TRACED_BUS_CALL(FAS_ServoEnable, this->portNo, this->engine1SlaveNo, enabled);
 	}
 
-	if (FAS_IsSlaveExist((byte)this->portNo, this->engine2SlaveNo))
+	if (TRACED_BUS_CALL(FAS_IsSlaveExist, (BYTE)this->portNo, this->engine2SlaveNo))
 	{
-		result2 = FAS_ServoEnable(this->portNo, this->engine2SlaveNo, enabled);
+		result2 = TRACED_BUS_CALL(FAS_ServoEnable, this->portNo, this->engine2SlaveNo, enabled);
 	}
 
 	if (result1 == FMM_OK && result2 == FMM_OK)
@@ -254,7 +745,6 @@ void EnginesController::SetEnginesEnabled(int enabled)
 
 void EnginesController::StartEngine(int engineSlaveNo)
 {
-	int result;
 	int engineSpeed;
 	int engineDirection;
 	bool easyStart;
@@ -274,150 +764,92 @@ void EnginesController::StartEngine(int engineSlaveNo)
 
 	if (!easyStart)
 	{
-		result = FAS_MoveVelocity(this->portNo, engineSlaveNo, engineSpeed, engineDirection);
+		this->MoveVelocity(engineSlaveNo, engineSpeed, engineDirection);
 	}
 	else
 	{
-		double speed = 0;
-		int maxSpeed = engineSpeed;
 		int iterations = 200;
-		double velocityStep = (double)maxSpeed / iterations;
-		speed = velocityStep;
-		result = FAS_MoveVelocity(this->portNo, engineSlaveNo, (int)ceil(speed), engineDirection);
-
-		for (int i = 1; i < iterations; i++)
-		{
-			speed += velocityStep;
-			result = FAS_VelocityOverride(this->portNo, engineSlaveNo, (int)ceil(speed));
-			Sleep(10);
-		} 
+		Ramp ramp(iterations);
+		ramp.AddAxis(engineSlaveNo, engineDirection, 0, (double)engineSpeed / iterations, true, false);
+		this->RunRamp(ramp);
 	} 
 }  
 
 void EnginesController::StartEngines()
 {
-	int result;
-
 	if (!this->engine1EasyStart && !this->engine2EasyStart)
 	{
-		result = FAS_MoveVelocity(this->portNo, this->engine1SlaveNo, this->engine1Speed, this->engine1Direction);
-		result = FAS_MoveVelocity(this->portNo, this->engine2SlaveNo, this->engine2Speed, this->engine2Direction);
+		this->MoveVelocity(this->engine1SlaveNo, this->engine1Speed, this->engine1Direction);
+		this->MoveVelocity(this->engine2SlaveNo, this->engine2Speed, this->engine2Direction);
 	}
 	else
 	{
-		int speed1 = 0;
-		int speed2 = 0;
-
-		int maxSpeed1 = this->engine1Speed;
-		int maxSpeed2 = this->engine2Speed;
-		
 		int iterations = 200;
 
-		int velocityStep1 = int(maxSpeed1 / iterations);
-		int velocityStep2 = int(maxSpeed2 / iterations);
-
-		speed1 = velocityStep1;
-		speed2 = velocityStep2;
+		int velocityStep1 = int(this->engine1Speed / iterations);
+		int velocityStep2 = int(this->engine2Speed / iterations);
 
-		result = FAS_MoveVelocity(this->portNo, this->engine1SlaveNo, speed1, this->engine1Direction);
-		result = FAS_MoveVelocity(this->portNo, this->engine2SlaveNo, speed2, this->engine2Direction);
-
-		for (int i = 1; i < iterations; i++)
-		{
-			speed1 += velocityStep1;
-			speed2 += velocityStep2;
-			result = FAS_VelocityOverride(this->portNo, this->engine1SlaveNo, speed1);
-			result = FAS_VelocityOverride(this->portNo, this->engine2SlaveNo, speed2);
-			Sleep(10);
-		} 
+		Ramp ramp(iterations);
+		ramp.AddAxis(this->engine1SlaveNo, this->engine1Direction, 0, velocityStep1, true, false);
+		ramp.AddAxis(this->engine2SlaveNo, this->engine2Direction, 0, velocityStep2, true, false);
+		this->RunRamp(ramp);
 	}
 }
 
 void EnginesController::StopEngine(int engineSlaveNo, int previousSpeed)
 { 
-	int result;
-	int engineSpeed;
 	int engineDirection;
 	bool easyStop;
 
 	if (engineSlaveNo == this->engine1SlaveNo)
 	{ 
-		engineSpeed = this->engine1Speed;
 		engineDirection = this->engine1Direction;
 		easyStop = this->engine1EasyStop;
 	}
 	else
 	{ 
-		engineSpeed = this->engine2Speed;
 		engineDirection = this->engine2Direction;
 		easyStop = this->engine2EasyStop;
 	}
 
 	if (easyStop)
 	{
-		result = FAS_MoveStop(this->portNo, engineSlaveNo);
+		this->MoveStop(engineSlaveNo);
 	}
 	else
 	{ 
-		int speed = 0;
-		int maxSpeed = previousSpeed;
 		int iterations = 200;
-		int velocityStep = int(maxSpeed / iterations); 
-		speed = maxSpeed; 
-
-		for (int i = 1; i < iterations; i++)
-		{
-			speed -= velocityStep;
-			result = FAS_VelocityOverride(this->portNo, engineSlaveNo, speed);
-			Sleep(10);
-		} 
+		int velocityStep = int(previousSpeed / iterations); 
 
-		result = FAS_MoveStop(this->portNo, engineSlaveNo);
+		Ramp ramp(iterations - 1);
+		ramp.AddAxis(engineSlaveNo, engineDirection, previousSpeed, -velocityStep, false, true);
+		this->RunRamp(ramp);
 	}
 }
 
 void EnginesController::StopEngines(int previousSpeed1, int previousSpeed2)
 {
-	int result;
-
 	if (!this->engine1EasyStart && !this->engine2EasyStart)
 	{
-		result = FAS_MoveStop(this->portNo, this->engine1SlaveNo);
-		result = FAS_MoveStop(this->portNo, this->engine2SlaveNo);
+		this->MoveStop(this->engine1SlaveNo);
+		this->MoveStop(this->engine2SlaveNo);
 	}
 	else
 	{
-		int speed1 = 0;
-		int speed2 = 0;
-
-		int maxSpeed1 = previousSpeed1;
-		int maxSpeed2 = previousSpeed2;
-
 		int iterations = 200;
 
-		int velocityStep1 = int(maxSpeed1 / iterations);
-		int velocityStep2 = int(maxSpeed2 / iterations);
-
-		speed1 = maxSpeed1;
-		speed2 = maxSpeed2;
+		int velocityStep1 = int(previousSpeed1 / iterations);
+		int velocityStep2 = int(previousSpeed2 / iterations);
 
-		for (int i = 1; i < iterations; i++)
-		{
-			speed1 -= velocityStep1;
-			speed2 -= velocityStep2;
-			result = FAS_VelocityOverride(this->portNo, this->engine1SlaveNo, speed1);
-			result = FAS_VelocityOverride(this->portNo, this->engine2SlaveNo, speed2);
-			Sleep(10);
-		} 
-
-		result = FAS_MoveStop(this->portNo, this->engine1SlaveNo);
-		result = FAS_MoveStop(this->portNo, this->engine2SlaveNo);
+		Ramp ramp(iterations - 1);
+		ramp.AddAxis(this->engine1SlaveNo, this->engine1Direction, previousSpeed1, -velocityStep1, false, true);
+		ramp.AddAxis(this->engine2SlaveNo, this->engine2Direction, previousSpeed2, -velocityStep2, false, true);
+		this->RunRamp(ramp);
 	}
 }
 
 void EnginesController::ChangeEngineSpeed(int engineSlaveNo, int previousSpeed)
 {  
-	int result;
 	int engineSpeed;
 	int engineDirection;
 	bool easyChange;
@@ -442,30 +874,22 @@ void EnginesController::ChangeEngineSpeed(int engineSlaveNo, int previousSpeed)
 
 	if (!easyChange)
 	{
-		result = FAS_VelocityOverride(this->portNo, engineSlaveNo, engineSpeed);
+		this->VelocityOverride(engineSlaveNo, engineSpeed);
 	}
 	else
 	{ 
-		double speed = 0;
 		int speedChange = engineSpeed - previousSpeed;
 		int iterations = 100;
 		double velocityStep = (double)speedChange / iterations;
-		speed = (double)previousSpeed + velocityStep;
-
-		for (int i = 1; i < iterations; i++)
-		{ 
-			speed += velocityStep; 
-			auto s = (int)ceil(speed);
-			result = FAS_VelocityOverride(this->portNo, engineSlaveNo, (int)ceil(speed));
-			Sleep(10);
-		}
+
+		Ramp ramp(iterations - 1);
+		ramp.AddAxis(engineSlaveNo, engineDirection, (double)previousSpeed + velocityStep, velocityStep, false, false);
+		this->RunRamp(ramp);
 	}
 }
 
 void EnginesController::ChangeEnginesSpeed(int previousSpeed1, int previousSpeed2)
 {
-	int result;
-
 	if (this->engine1Speed == 0 || this->engine2Speed == 0)
 	{
 		spdlog::warn("Hardware Controller :: Change engine speed method can be used only when engine is already moving.");
@@ -473,32 +897,80 @@ void EnginesController::ChangeEnginesSpeed(int previousSpeed1, int previousSpeed
 
 	if (!this->engine1EasyChange && !this->engine2EasyChange)
 	{
-		result = FAS_VelocityOverride(this->portNo, this->engine1SlaveNo, this->engine1Speed);
-		result = FAS_VelocityOverride(this->portNo, this->engine2SlaveNo, this->engine2Speed);
+		this->VelocityOverride(this->engine1SlaveNo, this->engine1Speed);
+		this->VelocityOverride(this->engine2SlaveNo, this->engine2Speed);
 	}
 	else
 	{
-		int speed1 = 0;
-		int speed2 = 0;
+		int iterations = 100;
 
-		int speedChange1 = this->engine1Speed - previousSpeed1;
-		int speedChange2 = this->engine2Speed - previousSpeed2;
+		int velocityStep1 = int((this->engine1Speed - previousSpeed1) / iterations);
+		int velocityStep2 = int((this->engine2Speed - previousSpeed2) / iterations);
 
-		int iterations = 100;
+		Ramp ramp(iterations - 1);
+		ramp.AddAxis(this->engine1SlaveNo, this->engine1Direction, previousSpeed1 + velocityStep1, velocityStep1, false, false);
+		ramp.AddAxis(this->engine2SlaveNo, this->engine2Direction, previousSpeed2 + velocityStep2, velocityStep2, false, false);
+		this->RunRamp(ramp);
+	}
+}
 
-		int velocityStep1 = int(speedChange1 / iterations);
-		int velocityStep2 = int(speedChange2 / iterations);
+void EnginesController::MoveGearedEngines(int previousSpeed1, int previousSpeed2)
+{
+	bool masterIsEngine1 = this->gearing.Master == 1;
+	int masterSlaveNo = masterIsEngine1 ? this->engine1SlaveNo : this->engine2SlaveNo;
+	int followerSlaveNo = masterIsEngine1 ? this->engine2SlaveNo : this->engine1SlaveNo;
+	int masterSpeed = masterIsEngine1 ? this->engine1Speed : this->engine2Speed;
+	int followerSpeed = masterIsEngine1 ? this->engine2Speed : this->engine1Speed;
+	int masterDirection = masterIsEngine1 ? this->engine1Direction : this->engine2Direction;
+	int followerDirection = masterIsEngine1 ? this->engine2Direction : this->engine1Direction;
+	int previousMasterSpeed = masterIsEngine1 ? previousSpeed1 : previousSpeed2;
+	int previousFollowerSpeed = masterIsEngine1 ? previousSpeed2 : previousSpeed1;
 
-		speed1 = previousSpeed1 + velocityStep1;
-		speed2 = previousSpeed2 + velocityStep2;
+	bool starting = previousMasterSpeed <= 0 && masterSpeed > 0;
+	bool stopping = previousMasterSpeed > 0 && masterSpeed <= 0;
 
-		for (int i = 1; i < iterations; i++)
-		{
-			speed1 += velocityStep1;
-			speed2 += velocityStep2;
-			result = FAS_VelocityOverride(this->portNo, this->engine1SlaveNo, speed1);
-			result = FAS_VelocityOverride(this->portNo, this->engine2SlaveNo, speed2);
-			Sleep(10);
-		} 
+	// Same meaning of the easy flags as for a single engine
+	bool ramped;
+	if (starting)
+	{
+		ramped = masterIsEngine1 ? this->engine1EasyStart : this->engine2EasyStart;
+	}
+	else if (stopping)
+	{
+		ramped = !(masterIsEngine1 ? this->engine1EasyStop : this->engine2EasyStop);
 	}
+	else
+	{
+		ramped = masterIsEngine1 ? this->engine1EasyChange : this->engine2EasyChange;
+	}
+
+	// A follower out of step with an unchanged master (after a restart or a gearing change) is corrected directly
+	if (!ramped || masterSpeed == previousMasterSpeed)
+	{
+		this->SetEngineVelocity(masterSlaveNo, previousMasterSpeed, masterDirection, masterSpeed, masterDirection);
+		this->SetEngineVelocity(followerSlaveNo, previousFollowerSpeed, followerDirection, followerSpeed, followerDirection);
+		return;
+	}
+
+	int iterations = starting || stopping ? 200 : 100;
+	double velocityStep = (double)(masterSpeed - (starting ? 0 : previousMasterSpeed)) / iterations;
+
+	Ramp ramp(starting ? iterations : iterations - 1);
+	ramp.Gearing = this->gearing;
+
+	if (starting)
+	{
+		ramp.AddAxis(masterSlaveNo, masterDirection, 0, velocityStep, true, false);
+	}
+	else if (stopping)
+	{
+		ramp.AddAxis(masterSlaveNo, masterDirection, previousMasterSpeed, velocityStep, false, true);
+	}
+	else
+	{
+		ramp.AddAxis(masterSlaveNo, masterDirection, previousMasterSpeed + velocityStep, velocityStep, false, false);
+	}
+
+	ramp.AddFollower(followerSlaveNo, followerDirection, previousFollowerSpeed, stopping);
+	this->RunRamp(ramp);
 }
@@ -1,7 +1,14 @@
 #pragma once    
 #include "HardwareState.h"
+#include "HardwareStateStore.h"
+#include "PeriodicScheduler.h"
+#include "Ramp.h"
+#include "StateCheckpoint.h"
 #include "Enums.h"   
 #include <math.h> 
+#include <atomic>
+#include <chrono>
+#include <mutex>
 
 typedef unsigned char BYTE;
 
@@ -18,7 +25,10 @@ public:
 		int engine1EasyStop,
 		int engine2EasyStop,
 		int engine1EasyChange,
-		int engine2EasyChange
+		int engine2EasyChange,
+		HardwareStateStore* stateStore,
+		PeriodicScheduler* scheduler,
+		StateCheckpoint* checkpoint = nullptr
 		);
 
 	~EnginesController();
@@ -26,13 +36,45 @@ public:
 	bool Connect(); 
 	void Disconnect();
 
-	HardwareState UpdateHardwareState(HardwareState hardwareState);
+	/// Applies update unless a stop was requested after stopGeneration was taken
+	HardwareState UpdateHardwareState(HardwareState hardwareState, unsigned long stopGeneration);
 	void UpdateEnginesState(HardwareState update);
 	bool ToogleConnection(CommandType command);
+	bool IsConnected() const;
+	/// Time between two velocity steps of a ramp
+	void SetRampTickInterval(std::chrono::microseconds interval);
+	/// Time between two reads of the actual engine velocities while connected, zero disables polling
+	void SetVelocityPollInterval(std::chrono::microseconds interval);
+	/// Largest difference (in pps) between the actual and the commanded velocity for which an engine counts as running at the commanded speed
+	void SetVelocityTolerance(int tolerance);
+	/// Couples the follower engine to the master, throws std::invalid_argument for an invalid gearing
+	void SetGearing(AxisGearing gearing);
+	/// Engine (1 or 2) whose setpoints are derived from the other one, 0 if the engines are not geared
+	int FollowerEngine() const;
+	/// Reconnects the engines if they were connected when the checkpoint was taken, and takes over the
+	/// checkpointed speeds of engines that are still running at them. Returns false if there was nothing to resume.
+	bool ResumeFromCheckpoint();
+
+	/// Commands both engines directly, without ramping. Used by motion programs once per tick.
+	/// Returns VelocitiesBusy without commanding anything while an update is being applied, and
+	/// VelocitiesStopped if the engines are disconnected or a stop was requested after stopGeneration was taken.
+	VelocityResult SetVelocities(int engine1Speed, int engine1Direction, int engine2Speed, int engine2Direction, unsigned long stopGeneration);
+	/// While a motion program runs, engine updates from the server are refused
+	void SetProgramActive(bool active);
+	/// Indicates that an engine update from the server is being applied, possibly still ramping
+	bool IsApplyingUpdate();
+
+	/// Aborts running ramps and stops every axis, immediately or with deceleration.
+	/// Returns time elapsed since the stop request was received.
+	std::chrono::microseconds EmergencyStop(bool decelerate, std::chrono::steady_clock::time_point receivedAt);
+	/// Incremented on every stop, commands taken before a stop are discarded
+	unsigned long StopGeneration() const;
+	/// Worst stop latency measured since start
+	std::chrono::microseconds MaxStopLatency() const;
 
 private:
 	/// Indicates if software is connected to engines driver
-	bool IsConnectedToEngines;
+	std::atomic<bool> IsConnectedToEngines;
 	/// Specifies COM port on which connection to engines driver is made
 	const BYTE portNo;
 	/// Specifies engine 1 slave number
@@ -43,7 +85,13 @@ private:
 	const unsigned long baudrate;
 	/// Indicates if engines are enabled
 	bool enginesEnabled;
-	/// Speed of engine 1 (in pps)
+	/// Shared hardware state the commanded engine parameters are published to
+	HardwareStateStore* stateStore;
+	/// Runs ramp steps and velocity polling
+	PeriodicScheduler* scheduler;
+	/// Receives the commanded state on every change, nullptr if not checkpointing
+	StateCheckpoint* checkpoint;
+	/// Speed of engine 1 (in pps) used while ramping, published to the state store once applied
 	int engine1Speed;
 	/// Speed of engine 2 (in pps)
 	int engine2Speed;
@@ -64,8 +112,49 @@ private:
 	int engine1Direction;
 	int engine2Direction;
 
+	/// Serializes calls to the engines driver between the command and stop lanes
+	std::mutex busMutex;
+	/// Serializes updates arriving through the websocket and the shared memory interface
+	std::mutex updateMutex;
+	/// Incremented by every stop request
+	std::atomic<unsigned long> stopGeneration;
+	/// Stop generation the update being applied was accepted in
+	unsigned long activeGeneration;
+	/// Indicates that a motion program is driving the engines
+	std::atomic<bool> programActive;
+	/// Worst measured stop latency (in us)
+	std::atomic<long long> maxStopLatency;
+	/// Time between two velocity steps of a ramp
+	std::chrono::microseconds rampTickInterval;
+	/// Time between two actual velocity reads
+	std::chrono::microseconds velocityPollInterval;
+	/// Scheduler task polling actual velocities, 0 if not polling
+	PeriodicScheduler::TaskId velocityPollTask;
+	/// Largest velocity error (in pps) still treated as running at the commanded speed
+	int velocityTolerance;
+	/// Relationship of the follower engine to the master, applied to every update and ramp step
+	AxisGearing gearing;
+
+	/// Velocity an engine commanded to commandedSpeed is considered to run at, given its actual velocity
+	int ReconcileSpeed(long actualSpeed, int commandedSpeed) const;
+	void SaveCheckpoint(int engine1Speed, int engine1Direction, int engine2Speed, int engine2Direction);
+	/// Replaces the follower setpoints in state by the ones geared to the master
+	void ApplyGearing(HardwareState& state) const;
+
 	void SetEnginesEnabled(int enabled);
 
+	bool IsRampAborted() const;
+	int MoveVelocity(int engineSlaveNo, int speed, int direction);
+	int VelocityOverride(int engineSlaveNo, int speed);
+	int MoveStop(int engineSlaveNo);
+	void SetEngineVelocity(int engineSlaveNo, int previousSpeed, int previousDirection, int speed, int direction);
+
+	/// Executes ramp on the scheduler, returns once it completed or was aborted
+	void RunRamp(Ramp& ramp);
+	/// Makes the next step of ramp, returns false when it is done
+	bool RampTick(Ramp& ramp);
+	void PollVelocity();
+
 	void StartEngine(int engineSlaveNo);
 	void StartEngines();
 
@@ -73,4 +162,6 @@ private:
 	void StopEngines(int previousSpeed1, int previousSpeed2);
 	void ChangeEngineSpeed(int engineSlaveNo, int previousSpeed);
 	void ChangeEnginesSpeed(int previousSpeed1, int previousSpeed2);
+	/// Moves the master to its new speed, the follower is derived from it in every ramp step
+	void MoveGearedEngines(int previousSpeed1, int previousSpeed2);
 };
\ No newline at end of file
@@ -1,3 +1,8 @@
 #pragma once
-enum MessageType { Update, Status, Command, Unknown };
-enum CommandType { Connect, Disconnect, Other };
\ No newline at end of file
+enum MessageType { Update, Status, Command, Subscribe, Program, History, Time, Unknown };
+enum CommandType { Connect, Disconnect, Stop, StartProgram, PauseProgram, ResumeProgram, AbortProgram, StartTrace, StopTrace, DumpTrace, Other };
+enum StateSource { Initial, Server, EnginesDriver, PowerSupply, Arduino };
+enum TelemetryField { Engine1Speed, Engine2Speed, Engine1ActualSpeed, Engine2ActualSpeed, Alarms, DesiredTemperature, CurrentTemperature, SupplyVoltage, TelemetryFieldCount };
+enum RequestStatus { Accepted, Completed, Superseded, Failed };
+enum VelocityResult { VelocitiesApplied, VelocitiesBusy, VelocitiesStopped };
+enum OutboundType { Reply, StatusReply, TemperatureReading, TelemetryUpdate, OutboundTypeCount };
\ No newline at end of file
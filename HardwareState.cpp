@@ -1 +1,32 @@
 #include "HardwareState.h"
+
+HardwareState HardwareState::MergedInto(HardwareState current) const
+{
+	if (this->Fields & Engine1SpeedField)
+	{
+		current.Engine1Speed = this->Engine1Speed;
+	}
+
+	if (this->Fields & Engine2SpeedField)
+	{
+		current.Engine2Speed = this->Engine2Speed;
+	}
+
+	if (this->Fields & Engine1DirectionField)
+	{
+		current.Engine1Direction = this->Engine1Direction;
+	}
+
+	if (this->Fields & Engine2DirectionField)
+	{
+		current.Engine2Direction = this->Engine2Direction;
+	}
+
+	if (this->Fields & DesiredTemperatureField)
+	{
+		current.DesiredTemperature = this->DesiredTemperature;
+	}
+
+	current.Fields |= this->Fields;
+	return current;
+}
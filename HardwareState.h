@@ -2,11 +2,24 @@
 class HardwareState
 {
 public:
+	/// Bits of Fields, one per setpoint
+	static const unsigned int Engine1SpeedField = 1;
+	static const unsigned int Engine2SpeedField = 2;
+	static const unsigned int Engine1DirectionField = 4;
+	static const unsigned int Engine2DirectionField = 8;
+	static const unsigned int DesiredTemperatureField = 16;
+	static const unsigned int EngineFields = Engine1SpeedField | Engine2SpeedField | Engine1DirectionField | Engine2DirectionField;
+	static const unsigned int AllFields = EngineFields | DesiredTemperatureField;
+
 	int Engine1Speed;
 	int Engine2Speed; 
 	int Engine1Direction;
 	int Engine2Direction;
 	int DesiredTemperature;
 	int CurrentTemperature;
-};
+	/// Setpoints this state carries, an update leaves the others as they are
+	unsigned int Fields;
 
+	/// Returns current with the setpoints carried by this state replaced
+	HardwareState MergedInto(HardwareState current) const;
+};
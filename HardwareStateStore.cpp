@@ -0,0 +1,152 @@
+#include "HardwareStateStore.h"
+
+#include <cmath>
+
+namespace
+{
+	template <typename T>
+	bool Assign(StateField<T>& field, T value, StateSource source, std::chrono::steady_clock::time_point now)
+	{
+		if (field.Source != StateSource::Initial && field.Value == value)
+		{
+			return false;
+		}
+
+		field.Value = value;
+		field.Timestamp = now;
+		field.Source = source;
+		return true;
+	}
+
+	template <typename T>
+	StateField<T> InitialField(T value, std::chrono::steady_clock::time_point now)
+	{
+		StateField<T> field;
+		field.Value = value;
+		field.Timestamp = now;
+		field.Source = StateSource::Initial;
+		return field;
+	}
+}
+
+HardwareState HardwareSnapshot::ToHardwareState() const
+{
+	auto state = HardwareState();
+	state.Engine1Speed = this->Engine1Speed.Value;
+	state.Engine2Speed = this->Engine2Speed.Value;
+	state.Engine1Direction = this->Engine1Direction.Value;
+	state.Engine2Direction = this->Engine2Direction.Value;
+	state.DesiredTemperature = this->DesiredTemperature.Value;
+	state.CurrentTemperature = (int)std::lround(this->CurrentTemperature.Value);
+	state.Fields = HardwareState::AllFields;
+
+	return state;
+}
+
+HardwareStateStore::HardwareStateStore() : nextSubscriptionId(1)
+{
+	auto now = std::chrono::steady_clock::now();
+	auto initial = std::make_shared<HardwareSnapshot>();
+
+	initial->Version = 0;
+	initial->Engine1Speed = InitialField(0, now);
+	initial->Engine2Speed = InitialField(0, now);
+	initial->Engine1Direction = InitialField(1, now);
+	initial->Engine2Direction = InitialField(1, now);
+	initial->Engine1ActualSpeed = InitialField(0, now);
+	initial->Engine2ActualSpeed = InitialField(0, now);
+	initial->Alarms = InitialField(0, now);
+	initial->DesiredTemperature = InitialField(0, now);
+	initial->CurrentTemperature = InitialField(0.0, now);
+	initial->SupplyVoltage = InitialField(0.0, now);
+
+	this->current = initial;
+}
+
+std::shared_ptr<const HardwareSnapshot> HardwareStateStore::Current() const
+{
+	return std::atomic_load(&this->current);
+}
+
+template <typename Mutate>
+void HardwareStateStore::Publish(Mutate mutate)
+{
+	std::lock_guard<std::mutex> lock(this->writeMutex);
+
+	// Mutate a stack copy first so unchanged writes do not allocate a snapshot
+	HardwareSnapshot candidate = *std::atomic_load(&this->current);
+	if (!mutate(candidate, std::chrono::steady_clock::now()))
+	{
+		return;
+	}
+
+	candidate.Version++;
+	auto next = std::make_shared<const HardwareSnapshot>(candidate);
+	std::atomic_store(&this->current, next);
+
+	for (auto const& subscriber : this->subscribers)
+	{
+		subscriber.second(*next);
+	}
+}
+
+void HardwareStateStore::SetEngines(int engine1Speed, int engine1Direction, int engine2Speed, int engine2Direction, StateSource source)
+{
+	this->Publish([=](HardwareSnapshot& snapshot, std::chrono::steady_clock::time_point now)
+	{
+		bool changed = Assign(snapshot.Engine1Speed, engine1Speed, source, now);
+		changed |= Assign(snapshot.Engine1Direction, engine1Direction, source, now);
+		changed |= Assign(snapshot.Engine2Speed, engine2Speed, source, now);
+		changed |= Assign(snapshot.Engine2Direction, engine2Direction, source, now);
+		return changed;
+	});
+}
+
+void HardwareStateStore::SetEngineReadings(int engine1ActualSpeed, int engine2ActualSpeed, int alarms, StateSource source)
+{
+	this->Publish([=](HardwareSnapshot& snapshot, std::chrono::steady_clock::time_point now)
+	{
+		bool changed = Assign(snapshot.Engine1ActualSpeed, engine1ActualSpeed, source, now);
+		changed |= Assign(snapshot.Engine2ActualSpeed, engine2ActualSpeed, source, now);
+		changed |= Assign(snapshot.Alarms, alarms, source, now);
+		return changed;
+	});
+}
+
+void HardwareStateStore::SetDesiredTemperature(int temperature, StateSource source)
+{
+	this->Publish([=](HardwareSnapshot& snapshot, std::chrono::steady_clock::time_point now)
+	{
+		return Assign(snapshot.DesiredTemperature, temperature, source, now);
+	});
+}
+
+void HardwareStateStore::SetCurrentTemperature(double temperature, StateSource source)
+{
+	this->Publish([=](HardwareSnapshot& snapshot, std::chrono::steady_clock::time_point now)
+	{
+		return Assign(snapshot.CurrentTemperature, temperature, source, now);
+	});
+}
+
+void HardwareStateStore::SetSupplyVoltage(double voltage, StateSource source)
+{
+	this->Publish([=](HardwareSnapshot& snapshot, std::chrono::steady_clock::time_point now)
+	{
+		return Assign(snapshot.SupplyVoltage, voltage, source, now);
+	});
+}
+
+int HardwareStateStore::Subscribe(Subscriber subscriber)
+{
+	std::lock_guard<std::mutex> lock(this->writeMutex);
+	auto id = this->nextSubscriptionId++;
+	this->subscribers[id] = subscriber;
+	return id;
+}
+
+void HardwareStateStore::Unsubscribe(int subscriptionId)
+{
+	std::lock_guard<std::mutex> lock(this->writeMutex);
+	this->subscribers.erase(subscriptionId);
+}
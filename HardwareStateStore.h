@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "HardwareState.h"
+#include "Enums.h"
+
+/// Value of a single state field together with when and by whom it was last changed
+template <typename T>
+class StateField
+{
+public:
+	T Value;
+	std::chrono::steady_clock::time_point Timestamp;
+	StateSource Source;
+};
+
+/// Immutable, versioned view of the whole hardware state
+class HardwareSnapshot
+{
+public:
+	/// Incremented on every published change
+	unsigned long long Version;
+
+	StateField<int> Engine1Speed;
+	StateField<int> Engine2Speed;
+	StateField<int> Engine1Direction;
+	StateField<int> Engine2Direction;
+	/// Velocities reported by the engines driver (in pps), as opposed to the commanded ones
+	StateField<int> Engine1ActualSpeed;
+	StateField<int> Engine2ActualSpeed;
+	/// Alarm bits, bit 0 set while engine 1 reports an alarm, bit 1 for engine 2
+	StateField<int> Alarms;
+	StateField<int> DesiredTemperature;
+	StateField<double> CurrentTemperature;
+	/// Voltage last set on the power supply output
+	StateField<double> SupplyVoltage;
+
+	HardwareState ToHardwareState() const;
+};
+
+/// Single owner of the current hardware state.
+/// Writers are serialized and publish a new snapshot on every change, readers
+/// take the latest snapshot without blocking writers.
+class HardwareStateStore
+{
+public:
+	typedef std::function<void(HardwareSnapshot const&)> Subscriber;
+
+	HardwareStateStore();
+
+	/// Latest published snapshot, never null
+	std::shared_ptr<const HardwareSnapshot> Current() const;
+
+	void SetEngines(int engine1Speed, int engine1Direction, int engine2Speed, int engine2Direction, StateSource source);
+	void SetEngineReadings(int engine1ActualSpeed, int engine2ActualSpeed, int alarms, StateSource source);
+	void SetDesiredTemperature(int temperature, StateSource source);
+	void SetCurrentTemperature(double temperature, StateSource source);
+	void SetSupplyVoltage(double voltage, StateSource source);
+
+	/// Registers callback invoked with every new snapshot. Callbacks run on the
+	/// publishing thread and must not publish to the store themselves.
+	int Subscribe(Subscriber subscriber);
+	void Unsubscribe(int subscriptionId);
+
+private:
+	/// Snapshot currently visible to readers, accessed with atomic shared_ptr operations
+	std::shared_ptr<const HardwareSnapshot> current;
+	/// Serializes writers and subscriber list changes
+	std::mutex writeMutex;
+	std::map<int, Subscriber> subscribers;
+	int nextSubscriptionId;
+
+	template <typename Mutate>
+	void Publish(Mutate mutate);
+};
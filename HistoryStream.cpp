@@ -0,0 +1,96 @@
+#include "HistoryStream.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+
+namespace
+{
+	/// Queries a session may have in flight, each one holds a cursor into the history
+	const size_t MaxPendingQueries = 8;
+}
+
+HistoryStream::HistoryStream(TelemetryHistory* history, OutboundQueue* outbound, size_t chunkSize, size_t maxQueueDepth)
+	: history(history),
+	outbound(outbound),
+	chunkSize(std::max<size_t>(chunkSize, 1)),
+	maxQueueDepth(std::max<size_t>(maxQueueDepth, 1))
+{
+}
+
+void HistoryStream::Enqueue(HistoryQuery const& query, std::string const& id)
+{
+	if (this->history == nullptr)
+	{
+		throw std::runtime_error("Telemetry history is disabled");
+	}
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (this->queries.size() >= MaxPendingQueries)
+	{
+		throw std::runtime_error("Too many history queries in progress");
+	}
+
+	PendingQuery pending;
+	pending.Query = query;
+	pending.Id = id;
+	pending.Channel = 0;
+	pending.Cursor = this->history->Find(query.Channels.front(), query.From);
+	pending.Chunks = 0;
+	this->queries.push_back(pending);
+
+	spdlog::info("History :: Query for {} channels from {} to {} every {} samples queued", query.Channels.size(), query.From, query.To, query.Decimation);
+}
+
+bool HistoryStream::Tick()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (this->queries.empty())
+	{
+		return true;
+	}
+
+	// Live traffic goes first, history waits until the writer caught up
+	if (this->outbound->Depth() >= this->maxQueueDepth)
+	{
+		return true;
+	}
+
+	auto& pending = this->queries.front();
+
+	HistoryChunk chunk;
+	chunk.Id = pending.Id;
+	chunk.Index = pending.Chunks++;
+
+	// Channels are sent one after the other, a chunk is filled up with the start of the next one
+	size_t samples = 0;
+	while (samples < this->chunkSize && pending.Channel < pending.Query.Channels.size())
+	{
+		auto channel = pending.Query.Channels[pending.Channel];
+		chunk.Channels.push_back(channel);
+		chunk.Times.emplace_back();
+		chunk.Columns.emplace_back();
+
+		bool finished = this->history->Read(channel, pending.Cursor, pending.Query.To, pending.Query.Decimation, this->chunkSize - samples, chunk.Times.back(), chunk.Columns.back());
+		samples += chunk.Times.back().size();
+
+		if (finished && ++pending.Channel < pending.Query.Channels.size())
+		{
+			pending.Cursor = this->history->Find(pending.Query.Channels[pending.Channel], pending.Query.From);
+		}
+	}
+
+	chunk.Last = pending.Channel >= pending.Query.Channels.size();
+
+	this->outbound->Push(this->messageParser.ParseToHistoryChunk(chunk), OutboundType::Reply);
+
+	if (chunk.Last)
+	{
+		spdlog::info("History :: Query from {} to {} sent in {} chunks", pending.Query.From, pending.Query.To, pending.Chunks);
+		this->queries.pop_front();
+	}
+
+	return true;
+}
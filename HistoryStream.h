@@ -0,0 +1,46 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "MessageParser.h"
+#include "OutboundQueue.h"
+#include "TelemetryFrame.h"
+#include "TelemetryHistory.h"
+
+/// Answers the history queries of a session in chunks. A chunk is only sent while the outbound
+/// queue is shallow and only one per tick, so a large query never delays live replies and telemetry.
+class HistoryStream
+{
+public:
+	/// history may be null if the rig keeps none, queries then fail
+	HistoryStream(TelemetryHistory* history, OutboundQueue* outbound, size_t chunkSize, size_t maxQueueDepth);
+
+	/// Queues query behind the ones still being sent, throws if history is disabled or too many are queued
+	void Enqueue(HistoryQuery const& query, std::string const& id);
+
+	/// Sends the next chunk if the outbound queue has room, run periodically by the scheduler
+	bool Tick();
+
+private:
+	class PendingQuery
+	{
+	public:
+		HistoryQuery Query;
+		std::string Id;
+		/// Index into Query.Channels of the channel being sent, and the cursor into its samples
+		size_t Channel;
+		unsigned long long Cursor;
+		unsigned long long Chunks;
+	};
+
+	TelemetryHistory* history;
+	OutboundQueue* outbound;
+	MessageParser messageParser;
+	const size_t chunkSize;
+	const size_t maxQueueDepth;
+
+	/// Guards queries, the message worker enqueues while the scheduler sends
+	std::mutex mutex;
+	std::deque<PendingQuery> queries;
+};
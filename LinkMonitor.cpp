@@ -0,0 +1,191 @@
+#include "LinkMonitor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <spdlog/spdlog.h>
+
+const int LinkMonitor::HistogramBounds[LinkMonitor::HistogramBuckets - 1] = { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+
+namespace
+{
+	long long NowMs()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+LinkMonitor::LinkMonitor(
+	int idleTimeoutMs,
+	int rttThresholdMs,
+	int queueDepthThreshold,
+	int minTelemetryIntervalMs,
+	int maxTelemetryIntervalMs
+) : idleTimeout(idleTimeoutMs),
+	rttThreshold(rttThresholdMs),
+	queueDepthThreshold(queueDepthThreshold),
+	minTelemetryInterval(minTelemetryIntervalMs),
+	maxTelemetryInterval(maxTelemetryIntervalMs),
+	pingSequence(0),
+	outstandingPing(0),
+	pingOutstanding(false),
+	missedPongs(0),
+	smoothedRtt(0),
+	rttVariation(0),
+	hasRtt(false),
+	tcpHandshake(0),
+	tlsHandshake(0),
+	websocketHandshake(0),
+	tlsResumed(false),
+	lastActivity(NowMs()),
+	queueDepth(0),
+	telemetryInterval(minTelemetryIntervalMs)
+{
+	std::fill(this->histogram, this->histogram + HistogramBuckets, 0);
+}
+
+std::string LinkMonitor::NextPingPayload()
+{
+	bool missed;
+	std::string payload;
+	{
+		std::lock_guard<std::mutex> lock(this->statsMutex);
+
+		missed = this->pingOutstanding;
+		if (missed)
+		{
+			this->missedPongs++;
+		}
+
+		this->outstandingPing = ++this->pingSequence;
+		this->pingOutstanding = true;
+		this->pingSentAt = std::chrono::steady_clock::now();
+		payload = std::to_string(this->outstandingPing);
+	}
+
+	if (missed)
+	{
+		this->Adapt(true);
+	}
+
+	return payload;
+}
+
+void LinkMonitor::OnPong(std::string const& payload)
+{
+	auto receivedAt = std::chrono::steady_clock::now();
+	this->OnFrameReceived();
+
+	bool congested;
+	{
+		std::lock_guard<std::mutex> lock(this->statsMutex);
+
+		if (!this->pingOutstanding || payload != std::to_string(this->outstandingPing))
+		{
+			return;
+		}
+
+		this->pingOutstanding = false;
+		double rtt = std::chrono::duration<double, std::milli>(receivedAt - this->pingSentAt).count();
+
+		if (!this->hasRtt)
+		{
+			this->smoothedRtt = rtt;
+			this->rttVariation = rtt / 2;
+			this->hasRtt = true;
+		}
+		else
+		{
+			this->rttVariation = 0.75 * this->rttVariation + 0.25 * std::fabs(this->smoothedRtt - rtt);
+			this->smoothedRtt = 0.875 * this->smoothedRtt + 0.125 * rtt;
+		}
+
+		int bucket = 0;
+		while (bucket < HistogramBuckets - 1 && rtt >= HistogramBounds[bucket])
+		{
+			bucket++;
+		}
+		this->histogram[bucket]++;
+
+		congested = this->smoothedRtt > this->rttThreshold;
+	}
+
+	this->Adapt(congested || this->queueDepth.load() > this->queueDepthThreshold);
+}
+
+void LinkMonitor::OnFrameReceived()
+{
+	this->lastActivity.store(NowMs());
+}
+
+void LinkMonitor::OnConnected(std::chrono::microseconds tcp, std::chrono::microseconds tls, std::chrono::microseconds websocket, bool resumed)
+{
+	std::lock_guard<std::mutex> lock(this->statsMutex);
+	this->tcpHandshake = tcp.count();
+	this->tlsHandshake = tls.count();
+	this->websocketHandshake = websocket.count();
+	this->tlsResumed = resumed;
+}
+
+void LinkMonitor::OnQueueDepth(size_t depth)
+{
+	auto previousDepth = this->queueDepth.exchange(depth);
+
+	if (depth > this->queueDepthThreshold && previousDepth <= this->queueDepthThreshold)
+	{
+		this->Adapt(true);
+	}
+}
+
+bool LinkMonitor::IsIdle() const
+{
+	return NowMs() - this->lastActivity.load() > this->idleTimeout.count();
+}
+
+std::chrono::milliseconds LinkMonitor::TelemetryInterval() const
+{
+	return std::chrono::milliseconds(this->telemetryInterval.load());
+}
+
+void LinkMonitor::Adapt(bool congested)
+{
+	// Back off multiplicatively when the link degrades, recover additively
+	int interval = this->telemetryInterval.load();
+	int adapted;
+
+	if (congested)
+	{
+		adapted = std::min(this->maxTelemetryInterval, std::max(interval * 2, 50));
+	}
+	else
+	{
+		adapted = std::max(this->minTelemetryInterval, interval - 50);
+	}
+
+	if (adapted != interval && this->telemetryInterval.compare_exchange_strong(interval, adapted))
+	{
+		spdlog::info("Link Monitor :: Telemetry interval changed from {} ms to {} ms", interval, adapted);
+	}
+}
+
+void LinkMonitor::LogSummary()
+{
+	std::lock_guard<std::mutex> lock(this->statsMutex);
+
+	std::stringstream buckets;
+	for (int i = 0; i < HistogramBuckets; i++)
+	{
+		if (i < HistogramBuckets - 1)
+		{
+			buckets << "<" << HistogramBounds[i] << "ms:" << this->histogram[i] << " ";
+		}
+		else
+		{
+			buckets << ">=" << HistogramBounds[i - 1] << "ms:" << this->histogram[i];
+		}
+	}
+
+	spdlog::info("Link Monitor :: rtt {:.2f} ms jitter {:.2f} ms missed pongs {} telemetry interval {} ms histogram [{}] handshake tcp {} us tls {} us{} websocket {} us",
+		this->smoothedRtt, this->rttVariation, this->missedPongs, this->telemetryInterval.load(), buckets.str(),
+		this->tcpHandshake, this->tlsHandshake, this->tlsResumed ? " (resumed)" : "", this->websocketHandshake);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+/// Tracks websocket link health from ping/pong round trips and derives the
+/// telemetry send interval from the measured RTT and the send queue depth.
+class LinkMonitor
+{
+public:
+	LinkMonitor(
+		int idleTimeoutMs,
+		int rttThresholdMs,
+		int queueDepthThreshold,
+		int minTelemetryIntervalMs,
+		int maxTelemetryIntervalMs
+		);
+
+	/// Returns payload for the next ping and records when it was sent
+	std::string NextPingPayload();
+	/// Called from the websocket control callback when a pong arrives
+	void OnPong(std::string const& payload);
+	/// Called whenever anything was received from the server
+	void OnFrameReceived();
+	/// Called by the telemetry writer with the number of frames waiting to be sent
+	void OnQueueDepth(size_t depth);
+	/// Records how long establishing the session took, tls is zero on plain connections
+	void OnConnected(std::chrono::microseconds tcp, std::chrono::microseconds tls, std::chrono::microseconds websocket, bool resumed);
+
+	/// Indicates that nothing was received for longer than the idle timeout
+	bool IsIdle() const;
+	/// Minimum time between two telemetry frames, zero if not throttled
+	std::chrono::milliseconds TelemetryInterval() const;
+
+	void LogSummary();
+
+private:
+	static const int HistogramBuckets = 10;
+	/// Upper bounds of RTT histogram buckets (in ms), last bucket is open ended
+	static const int HistogramBounds[HistogramBuckets - 1];
+
+	const std::chrono::milliseconds idleTimeout;
+	const double rttThreshold;
+	const size_t queueDepthThreshold;
+	const int minTelemetryInterval;
+	const int maxTelemetryInterval;
+
+	/// Guards RTT statistics, updated from ping and reader threads
+	std::mutex statsMutex;
+	unsigned long pingSequence;
+	unsigned long outstandingPing;
+	std::chrono::steady_clock::time_point pingSentAt;
+	bool pingOutstanding;
+	unsigned long missedPongs;
+	/// Smoothed RTT and RTT variation (in ms), as in RFC 6298
+	double smoothedRtt;
+	double rttVariation;
+	bool hasRtt;
+	unsigned long histogram[HistogramBuckets];
+	/// Handshake durations of the session (in us)
+	long long tcpHandshake;
+	long long tlsHandshake;
+	long long websocketHandshake;
+	bool tlsResumed;
+
+	std::atomic<long long> lastActivity;
+	std::atomic<size_t> queueDepth;
+	std::atomic<int> telemetryInterval;
+
+	void Adapt(bool congested);
+};
@@ -0,0 +1,36 @@
+#include "MessageArena.h"
+
+namespace
+{
+	thread_local std::pmr::memory_resource* currentMessageResource = nullptr;
+}
+
+std::pmr::memory_resource* CurrentMessageResource()
+{
+	return currentMessageResource != nullptr ? currentMessageResource : std::pmr::new_delete_resource();
+}
+
+MessageArena::MessageArena(size_t size) : buffer(new char[size]), resource(buffer.get(), size)
+{
+}
+
+std::pmr::memory_resource* MessageArena::Resource()
+{
+	return &this->resource;
+}
+
+void MessageArena::Reset()
+{
+	this->resource.release();
+}
+
+MessageArenaScope::MessageArenaScope(MessageArena& arena) : arena(arena), previous(currentMessageResource)
+{
+	currentMessageResource = arena.Resource();
+}
+
+MessageArenaScope::~MessageArenaScope()
+{
+	currentMessageResource = this->previous;
+	this->arena.Reset();
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string>
+
+/// Resource ArenaAllocator allocates from on the calling thread: the arena of the
+/// innermost active MessageArenaScope, or the heap outside of one.
+std::pmr::memory_resource* CurrentMessageResource();
+
+/// Monotonic arena backing the allocations made while one message is handled
+class MessageArena
+{
+public:
+	explicit MessageArena(size_t size = 64 * 1024);
+
+	MessageArena(const MessageArena&) = delete;
+	MessageArena& operator=(const MessageArena&) = delete;
+
+	std::pmr::memory_resource* Resource();
+
+	/// Releases everything allocated since the last reset in one step
+	void Reset();
+
+private:
+	std::unique_ptr<char[]> buffer;
+	std::pmr::monotonic_buffer_resource resource;
+};
+
+/// Makes arena the current message resource of this thread and resets it when the scope ends.
+/// Everything allocated through ArenaAllocator inside the scope must also be destroyed inside it.
+class MessageArenaScope
+{
+public:
+	explicit MessageArenaScope(MessageArena& arena);
+	~MessageArenaScope();
+
+	MessageArenaScope(const MessageArenaScope&) = delete;
+	MessageArenaScope& operator=(const MessageArenaScope&) = delete;
+
+private:
+	MessageArena& arena;
+	std::pmr::memory_resource* previous;
+};
+
+/// Stateless allocator bound to the current message resource. Used where a library
+/// (nlohmann::json) default constructs its allocators and cannot be handed a
+/// polymorphic_allocator instance.
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	ArenaAllocator() noexcept
+	{
+	}
+
+	template <typename U>
+	ArenaAllocator(ArenaAllocator<U> const&) noexcept
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(CurrentMessageResource()->allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* pointer, size_t count)
+	{
+		CurrentMessageResource()->deallocate(pointer, count * sizeof(T), alignof(T));
+	}
+};
+
+template <typename T, typename U>
+bool operator==(ArenaAllocator<T> const&, ArenaAllocator<U> const&) noexcept
+{
+	return true;
+}
+
+template <typename T, typename U>
+bool operator!=(ArenaAllocator<T> const&, ArenaAllocator<U> const&) noexcept
+{
+	return false;
+}
+
+/// String living in the current message arena
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> MessageString;
@@ -2,40 +2,289 @@
 #include <nlohmann/json.hpp> 
 #include <spdlog/spdlog.h>   
 
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
 using namespace nlohmann;
 
-HardwareState MessageParser::ParseToHardwareState(std::string message)
+/// JSON document whose nodes and strings live in the current message arena
+typedef basic_json<std::map, std::vector, MessageString, bool, std::int64_t, std::uint64_t, double, ArenaAllocator> ArenaJson;
+
+namespace
+{
+	int ParseIntField(ArenaJson const& message, const char* name)
+	{
+		auto const& text = message.at(name).get_ref<MessageString const&>();
+		char* end;
+		long value = std::strtol(text.c_str(), &end, 10);
+
+		if (end == text.c_str())
+		{
+			throw std::invalid_argument(name);
+		}
+
+		return (int)value;
+	}
+
+	/// Parses the update field name into value if present and marks it in fields
+	void ParseUpdateField(ArenaJson const& message, const char* name, unsigned int field, int& value, unsigned int& fields)
+	{
+		if (!message.contains(name))
+		{
+			return;
+		}
+
+		value = ParseIntField(message, name);
+		fields |= field;
+	}
+
+	/// Wire names of the setpoints an update may carry
+	const struct
+	{
+		const char* Name;
+		unsigned int Field;
+	} UpdateFieldNames[] = {
+		{ "engine1Speed", HardwareState::Engine1SpeedField },
+		{ "engine2Speed", HardwareState::Engine2SpeedField },
+		{ "engine1Direction", HardwareState::Engine1DirectionField },
+		{ "engine2Direction", HardwareState::Engine2DirectionField },
+		{ "desiredTemperature", HardwareState::DesiredTemperatureField },
+	};
+
+	/// Wire names of the telemetry fields, in TelemetryField order
+	const char* const TelemetryFieldNames[TelemetryFieldCount] = {
+		"engine1Speed",
+		"engine2Speed",
+		"engine1ActualSpeed",
+		"engine2ActualSpeed",
+		"alarms",
+		"desiredTemperature",
+		"currentTemperature",
+		"supplyVoltage",
+	};
+
+	/// Wire names of the thermocouples beyond the first, which is currentTemperature
+	const char* const ThermocoupleNames[TelemetryChannelCount - TelemetryFieldCount] = {
+		"temperature1",
+		"temperature2",
+		"temperature3",
+		"temperature4",
+		"temperature5",
+		"temperature6",
+		"temperature7",
+	};
+
+	/// Accepts numbers as well as numbers sent as strings
+	int ParseIntValue(json const& value, std::string const& name)
+	{
+		if (value.is_number())
+		{
+			return value.get<int>();
+		}
+
+		auto const& text = value.get_ref<std::string const&>();
+		char* end;
+		long parsed = std::strtol(text.c_str(), &end, 10);
+
+		if (end == text.c_str())
+		{
+			throw std::invalid_argument(name);
+		}
+
+		return (int)parsed;
+	}
+
+	/// Times in us do not fit an int
+	long long ParseTimeValue(json const& value, std::string const& name)
+	{
+		if (value.is_number())
+		{
+			return value.get<long long>();
+		}
+
+		auto const& text = value.get_ref<std::string const&>();
+		char* end;
+		long long parsed = std::strtoll(text.c_str(), &end, 10);
+
+		if (end == text.c_str())
+		{
+			throw std::invalid_argument(name);
+		}
+
+		return parsed;
+	}
+
+	TelemetryField ParseTelemetryField(std::string const& name)
+	{
+		auto field = std::find(std::begin(TelemetryFieldNames), std::end(TelemetryFieldNames), name);
+		if (field == std::end(TelemetryFieldNames))
+		{
+			throw std::invalid_argument("Unknown telemetry field " + name);
+		}
+
+		return (TelemetryField)(field - std::begin(TelemetryFieldNames));
+	}
+
+	TelemetryChannel ParseTelemetryChannel(std::string const& name)
+	{
+		auto thermocouple = std::find(std::begin(ThermocoupleNames), std::end(ThermocoupleNames), name);
+		if (thermocouple != std::end(ThermocoupleNames))
+		{
+			return TelemetryFieldCount + (TelemetryChannel)(thermocouple - std::begin(ThermocoupleNames));
+		}
+
+		return ParseTelemetryField(name);
+	}
+
+	/// Engine fields are integral, temperature and voltage are sent as they are
+	bool IsIntegralField(TelemetryField field)
+	{
+		return field != TelemetryField::CurrentTemperature && field != TelemetryField::SupplyVoltage;
+	}
+
+	std::optional<int> ParseOptionalInt(json const& values, const char* name)
+	{
+		auto value = values.find(name);
+		if (value == values.end())
+		{
+			return std::optional<int>();
+		}
+
+		return ParseIntValue(*value, name);
+	}
+
+	std::vector<MotionInstruction> ParseMotionSteps(json const& steps)
+	{
+		std::vector<MotionInstruction> instructions;
+
+		for (auto const& step : steps)
+		{
+			auto instruction = MotionInstruction();
+			instruction.DurationMs = 0;
+			instruction.Count = 0;
+
+			if (step.contains("set"))
+			{
+				auto const& set = step["set"];
+				instruction.Operation = MotionOperation::Set;
+				instruction.Engine1Speed = ParseOptionalInt(set, "engine1Speed");
+				instruction.Engine2Speed = ParseOptionalInt(set, "engine2Speed");
+				instruction.Engine1Direction = ParseOptionalInt(set, "engine1Direction");
+				instruction.Engine2Direction = ParseOptionalInt(set, "engine2Direction");
+				instruction.DesiredTemperature = ParseOptionalInt(set, "desiredTemperature");
+				instruction.DurationMs = ParseOptionalInt(step, "ramp").value_or(0);
+			}
+			else if (step.contains("wait"))
+			{
+				instruction.Operation = MotionOperation::Wait;
+				instruction.DurationMs = ParseIntValue(step["wait"], "wait");
+			}
+			else if (step.contains("loop"))
+			{
+				instruction.Operation = MotionOperation::Loop;
+				instruction.Count = ParseIntValue(step["loop"], "loop");
+				instruction.Body = ParseMotionSteps(step.at("steps"));
+
+				if (instruction.Body.empty())
+				{
+					throw std::invalid_argument("Motion program loop must have steps");
+				}
+			}
+			else
+			{
+				throw std::invalid_argument("Motion program step must be a set, wait or loop");
+			}
+
+			instructions.push_back(instruction);
+		}
+
+		return instructions;
+	}
+
+	MessageString FormatInt(int value)
+	{
+		char digits[16];
+		snprintf(digits, sizeof(digits), "%d", value);
+		return MessageString(digits);
+	}
+}
+
+const char* TelemetryFieldName(TelemetryField field)
+{
+	return TelemetryFieldNames[field];
+}
+
+const char* TelemetryChannelName(TelemetryChannel channel)
+{
+	return channel < TelemetryFieldCount ? TelemetryFieldNames[channel] : ThermocoupleNames[channel - TelemetryFieldCount];
+}
+
+HardwareState MessageParser::ParseToHardwareState(std::string const& message)
 {
 	try
 	{
-		json json = json::parse(message); 
-		spdlog::info(json.dump());
+		auto json = ArenaJson::parse(message); 
 	
+		// Fields left out keep their current values
 		auto state = HardwareState();  
-		state.DesiredTemperature = std::stoi(json["desiredTemperature"].get<std::string>());
-		state.Engine1Direction = std::stoi(json["engine1Direction"].get<std::string>());
-		state.Engine1Speed = std::stoi(json["engine1Speed"].get<std::string>());
-		state.Engine2Direction = std::stoi(json["engine2Direction"].get<std::string>());
-		state.Engine2Speed = std::stoi(json["engine2Speed"].get<std::string>()); 
+		ParseUpdateField(json, "desiredTemperature", HardwareState::DesiredTemperatureField, state.DesiredTemperature, state.Fields);
+		ParseUpdateField(json, "engine1Direction", HardwareState::Engine1DirectionField, state.Engine1Direction, state.Fields);
+		ParseUpdateField(json, "engine1Speed", HardwareState::Engine1SpeedField, state.Engine1Speed, state.Fields);
+		ParseUpdateField(json, "engine2Direction", HardwareState::Engine2DirectionField, state.Engine2Direction, state.Fields);
+		ParseUpdateField(json, "engine2Speed", HardwareState::Engine2SpeedField, state.Engine2Speed, state.Fields);
+
+		if (state.Fields == 0)
+		{
+			throw std::invalid_argument("Update carries no hardware fields");
+		}
 
-		spdlog::info("Parsed message dt: {} e1d: {} e1s:{} e2d: {} e2s: {}", state.DesiredTemperature, state.Engine1Direction, state.Engine1Speed, state.Engine2Direction, state.Engine2Speed);
+		spdlog::info("Parsed message dt: {} e1d: {} e1s:{} e2d: {} e2s: {} fields: {:#x}", state.DesiredTemperature, state.Engine1Direction, state.Engine1Speed, state.Engine2Direction, state.Engine2Speed, state.Fields);
 
 		return state;
 	}
-	catch (std::exception ex)
+	catch (std::exception const& ex)
 	{
 		spdlog::error("Error while parsing message: {}", ex.what());
+		throw;
 	} 
 }
 
-std::string MessageParser::ParseToUpdate(HardwareState state)
+unsigned int MessageParser::GetUpdateFields(std::string const& message)
+{
+	try
+	{
+		auto json = ArenaJson::parse(message);
+
+		unsigned int fields = 0;
+		for (auto const& field : UpdateFieldNames)
+		{
+			if (json.contains(field.Name))
+			{
+				fields |= field.Field;
+			}
+		}
+
+		return fields;
+	}
+	catch (std::exception const& ex)
+	{
+		spdlog::error("Error while parsing message: {}", ex.what());
+	}
+
+	return 0;
+}
+
+MessageString MessageParser::ParseToUpdate(HardwareState state)
 {
-	json json;
+	ArenaJson json;
 	json["type"] = "update";
-	json["engine1Direction"] = std::to_string(state.Engine1Direction);
-	json["engine2Direction"] = std::to_string(state.Engine2Direction);
-	json["engine1Speed"] = std::to_string(state.Engine1Speed);
-	json["engine2Speed"] = std::to_string(state.Engine2Speed);
+	json["engine1Direction"] = FormatInt(state.Engine1Direction);
+	json["engine2Direction"] = FormatInt(state.Engine2Direction);
+	json["engine1Speed"] = FormatInt(state.Engine1Speed);
+	json["engine2Speed"] = FormatInt(state.Engine2Speed);
 
 	return json.dump();
 }
@@ -50,22 +299,293 @@ std::string MessageParser::ParseToEngineConnectionState(bool connectedToEngines)
 	return j.dump();
 } 
 
-std::string MessageParser::ParseToTemperatureState(std::string temperature)
+std::string MessageParser::ParseToStatus(HardwareSnapshot const& snapshot, bool connectedToEngines, long long sampledAt)
+{
+	json j;
+
+	j["type"] = "status";
+	j["sampledAt"] = sampledAt;
+	j["connectedToEngines"] = connectedToEngines;
+	j["version"] = snapshot.Version;
+	j["engine1Direction"] = std::to_string(snapshot.Engine1Direction.Value);
+	j["engine2Direction"] = std::to_string(snapshot.Engine2Direction.Value);
+	j["engine1Speed"] = std::to_string(snapshot.Engine1Speed.Value);
+	j["engine2Speed"] = std::to_string(snapshot.Engine2Speed.Value);
+	j["engine1ActualSpeed"] = std::to_string(snapshot.Engine1ActualSpeed.Value);
+	j["engine2ActualSpeed"] = std::to_string(snapshot.Engine2ActualSpeed.Value);
+	j["desiredTemperature"] = std::to_string(snapshot.DesiredTemperature.Value);
+	j["currentTemperature"] = snapshot.CurrentTemperature.Value;
+
+	return j.dump();
+}
+
+std::string MessageParser::ParseToStopState(long long receivedAt, std::chrono::microseconds latency, std::chrono::microseconds maxLatency)
+{
+	json j;
+
+	j["type"] = "status";
+	j["stopped"] = true;
+	j["receivedAt"] = receivedAt;
+	j["appliedAt"] = receivedAt + latency.count();
+	j["stopLatencyUs"] = latency.count();
+	j["maxStopLatencyUs"] = maxLatency.count();
+
+	return j.dump();
+}
+
+std::string MessageParser::ParseToTemperatureState(std::string temperature, long long sampledAt, int channel, long long deviceTime)
 {
 	json j;
 
 	j["type"] = "update";
-	j["currentTemperature"] = temperature;
+	j["sampledAt"] = sampledAt;
+
+	if (channel == 0)
+	{
+		j["currentTemperature"] = temperature;
+	}
+	else
+	{
+		j["channel"] = channel;
+		j["temperature"] = temperature;
+	}
+
+	if (deviceTime >= 0)
+	{
+		j["deviceTime"] = deviceTime;
+	}
+
+	return j.dump();
+}
+
+std::string MessageParser::ParseToTraceState(bool enabled, std::string const& path, size_t events)
+{
+	json j;
+
+	j["type"] = "status";
+	j["tracing"] = enabled;
+
+	if (!path.empty())
+	{
+		j["traceFile"] = path;
+		j["traceEvents"] = events;
+	}
+
+	return j.dump();
+}
+
+TelemetrySubscription MessageParser::ParseToSubscription(std::string const& message)
+{
+	auto j = json::parse(message);
+
+	auto subscription = TelemetrySubscription();
+	subscription.KeyframeInterval = std::chrono::milliseconds(j.contains("keyframeInterval") ? ParseIntValue(j["keyframeInterval"], "keyframeInterval") : 0);
+
+	for (auto const& field : j.at("fields").items())
+	{
+		FieldSubscription fieldSubscription;
+		fieldSubscription.Field = ParseTelemetryField(field.key());
+		fieldSubscription.Interval = std::chrono::milliseconds(ParseIntValue(field.value(), field.key()));
+		subscription.Fields.push_back(fieldSubscription);
+	}
+
+	return subscription;
+}
+
+std::string MessageParser::ParseToTelemetry(TelemetryFrame const& frame)
+{
+	json j;
+
+	j["type"] = "telemetry";
+	j["sequence"] = frame.Sequence;
+	j["keyframe"] = frame.Keyframe;
+	j["sampledAt"] = frame.SampledAt;
+
+	auto& fields = j["fields"] = json::object();
+	for (auto const& value : frame.Values)
+	{
+		auto name = TelemetryFieldNames[value.first];
+
+		if (IsIntegralField(value.first))
+		{
+			fields[name] = (int)value.second;
+		}
+		else
+		{
+			fields[name] = value.second;
+		}
+	}
+
+	return j.dump();
+}
+
+HistoryQuery MessageParser::ParseToHistoryQuery(std::string const& message)
+{
+	auto j = json::parse(message);
+
+	auto query = HistoryQuery();
+	query.From = j.contains("from") ? ParseTimeValue(j["from"], "from") : 0;
+	query.To = j.contains("to") ? ParseTimeValue(j["to"], "to") : std::numeric_limits<long long>::max();
+	query.Decimation = j.contains("decimation") ? ParseIntValue(j["decimation"], "decimation") : 1;
+
+	for (auto const& channel : j.at("fields"))
+	{
+		// Chunks name their columns by channel, a channel asked for twice is sent once
+		auto parsed = ParseTelemetryChannel(channel.get<std::string>());
+		if (std::find(query.Channels.begin(), query.Channels.end(), parsed) == query.Channels.end())
+		{
+			query.Channels.push_back(parsed);
+		}
+	}
+
+	if (query.Channels.empty() || query.From > query.To || query.Decimation < 1)
+	{
+		throw std::invalid_argument("History query needs fields, from not after to and a decimation of at least 1");
+	}
+
+	return query;
+}
+
+std::string MessageParser::ParseToHistoryChunk(HistoryChunk const& chunk)
+{
+	json j;
+
+	j["type"] = "history";
+	if (!chunk.Id.empty())
+	{
+		j["id"] = json::parse(chunk.Id);
+	}
+	j["chunk"] = chunk.Index;
+	j["last"] = chunk.Last;
+
+	// Columnar per channel, the n-th value was sampled at the n-th time
+	auto& fields = j["fields"] = json::object();
+	for (size_t i = 0; i < chunk.Channels.size(); i++)
+	{
+		auto channel = chunk.Channels[i];
+		auto& samples = fields[TelemetryChannelName(channel)] = json::object();
+		samples["times"] = chunk.Times[i];
+
+		auto& column = samples["values"] = json::array();
+		for (auto value : chunk.Columns[i])
+		{
+			if (channel < TelemetryFieldCount && IsIntegralField((TelemetryField)channel))
+			{
+				column.push_back((int)value);
+			}
+			else
+			{
+				column.push_back(value);
+			}
+		}
+	}
+
+	return j.dump();
+}
+
+std::string MessageParser::ParseToRequestStatus(std::string const& id, RequestStatus status, long long receivedAt, std::chrono::microseconds elapsed, std::string const& error)
+{
+	static const char* const statusNames[] = { "accepted", "completed", "superseded", "failed" };
+
+	json j;
+
+	j["type"] = "request";
+	j["id"] = json::parse(id);
+	j["status"] = statusNames[status];
+	j["elapsedUs"] = elapsed.count();
+	j["receivedAt"] = receivedAt;
+
+	if (status == RequestStatus::Completed)
+	{
+		j["appliedAt"] = receivedAt + elapsed.count();
+	}
+
+	if (!error.empty())
+	{
+		j["error"] = error;
+	}
+
+	return j.dump();
+}
+
+ClockExchange MessageParser::ParseToClockExchange(std::string const& message)
+{
+	auto j = json::parse(message);
+
+	auto exchange = ClockExchange();
+	exchange.IsAnswer = j.contains("t1");
+	exchange.T0 = ParseTimeValue(j.at("t0"), "t0");
+	exchange.T1 = exchange.IsAnswer ? ParseTimeValue(j["t1"], "t1") : 0;
+	exchange.T2 = exchange.IsAnswer ? ParseTimeValue(j.at("t2"), "t2") : 0;
+
+	return exchange;
+}
+
+std::string MessageParser::ParseToTimeRequest()
+{
+	json j;
+
+	j["type"] = "time";
+
+	return j.dump();
+}
+
+std::string MessageParser::ParseToTimeAnswer(long long t0, long long t1)
+{
+	json j;
+
+	j["type"] = "time";
+	j["t0"] = t0;
+	j["t1"] = t1;
 
 	return j.dump();
 }
 
-MessageType MessageParser::GetMessageType(std::string message)
+std::string MessageParser::ParseToClockState(long long offset, long long delay)
+{
+	json j;
+
+	j["type"] = "clock";
+	j["offsetUs"] = offset;
+	j["delayUs"] = delay;
+
+	return j.dump();
+}
+
+MotionProgramSource MessageParser::ParseToMotionProgram(std::string const& message)
+{
+	auto j = json::parse(message);
+
+	MotionProgramSource source;
+	source.Name = j.contains("name") ? j["name"].get<std::string>() : std::string("program");
+	source.Steps = ParseMotionSteps(j.at("steps"));
+
+	return source;
+}
+
+std::string MessageParser::ParseToProgramStatus(MotionProgramStatus const& status)
+{
+	static const char* const stateNames[] = { "empty", "loaded", "running", "paused", "finished", "aborted" };
+
+	json j;
+
+	j["type"] = "program";
+	j["name"] = status.Name;
+	j["state"] = stateNames[(int)status.State];
+	j["step"] = status.Segment;
+	j["steps"] = status.Segments;
+	j["ticksDone"] = status.TicksDone;
+	j["totalTicks"] = status.TotalTicks;
+
+	return j.dump();
+}
+
+MessageType MessageParser::GetMessageType(std::string const& message)
 {
 	try 
 	{
-		json json = json::parse(message);
-		auto type = json["type"].get<std::string>();
+		auto json = ArenaJson::parse(message);
+		auto const& type = json.at("type").get_ref<MessageString const&>();
 	   
 		if (type == "update") 
 		{
@@ -82,20 +602,65 @@ MessageType MessageParser::GetMessageType(std::string message)
 			return MessageType::Command;
 		}
 
+		if (type == "subscribe")
+		{
+			return MessageType::Subscribe;
+		}
+
+		if (type == "program")
+		{
+			return MessageType::Program;
+		}
+
+		if (type == "history")
+		{
+			return MessageType::History;
+		}
+
+		if (type == "time")
+		{
+			return MessageType::Time;
+		}
+
 		return MessageType::Unknown;
 	}
-	catch (std::exception ex)
+	catch (std::exception const& ex)
+	{
+		spdlog::error("Error while parsing message: {}", ex.what());
+	}
+
+	return MessageType::Unknown;
+}
+
+std::string MessageParser::GetMessageId(std::string const& message)
+{
+	try
+	{
+		auto json = ArenaJson::parse(message);
+		auto id = json.find("id");
+
+		if (id == json.end() || id->is_null())
+		{
+			return std::string();
+		}
+
+		auto serialized = id->dump();
+		return std::string(serialized.data(), serialized.size());
+	}
+	catch (std::exception const& ex)
 	{
 		spdlog::error("Error while parsing message: {}", ex.what());
 	}
+
+	return std::string();
 }
 
-CommandType MessageParser::GetCommandType(std::string message)
+CommandType MessageParser::GetCommandType(std::string const& message)
 {
 	try
 	{
-		json json = json::parse(message);
-		auto command = json["command"].get<std::string>();
+		auto json = ArenaJson::parse(message);
+		auto const& command = json.at("command").get_ref<MessageString const&>();
 
 		if (command == "connect")
 		{
@@ -106,11 +671,53 @@ CommandType MessageParser::GetCommandType(std::string message)
 		{
 			return CommandType::Disconnect;
 		}
+
+		if (command == "stop")
+		{
+			return CommandType::Stop;
+		}
+
+		if (command == "startProgram")
+		{
+			return CommandType::StartProgram;
+		}
+
+		if (command == "pauseProgram")
+		{
+			return CommandType::PauseProgram;
+		}
+
+		if (command == "resumeProgram")
+		{
+			return CommandType::ResumeProgram;
+		}
+
+		if (command == "abortProgram")
+		{
+			return CommandType::AbortProgram;
+		}
+
+		if (command == "startTrace")
+		{
+			return CommandType::StartTrace;
+		}
+
+		if (command == "stopTrace")
+		{
+			return CommandType::StopTrace;
+		}
+
+		if (command == "dumpTrace")
+		{
+			return CommandType::DumpTrace;
+		}
 		  
 		return CommandType::Other;
 	}
-	catch (std::exception ex)
+	catch (std::exception const& ex)
 	{
 		spdlog::error("Error while parsing message: {}", ex.what());
 	}
+
+	return CommandType::Other;
 }
@@ -1,16 +1,53 @@
 #pragma once
 #include <string>
+#include <chrono>
 #include "HardwareState.h"
+#include "HardwareStateStore.h"
 #include "Enums.h"
+#include "MessageArena.h"
+#include "TelemetryFrame.h"
+#include "MotionProgram.h"
+#include "ClockSync.h"
+
+/// Name of field in telemetry messages
+const char* TelemetryFieldName(TelemetryField field);
+/// Name of channel in history messages, the field name or temperature1 to temperature7
+const char* TelemetryChannelName(TelemetryChannel channel);
 
 class MessageParser
 {
 public:
-	HardwareState ParseToHardwareState(std::string);
-	std::string ParseToUpdate(HardwareState);
+	/// Only the fields present in the message are set in Fields, throws if it carries none or a malformed one
+	HardwareState ParseToHardwareState(std::string const& message);
+	MessageString ParseToUpdate(HardwareState);
 	std::string ParseToEngineConnectionState(bool connectedToEngines);
-	std::string ParseToTemperatureState(std::string temperature); 
-	MessageType GetMessageType(std::string message);
-	CommandType GetCommandType(std::string message);
+	/// Controller times (sampledAt, receivedAt, appliedAt) are MonotonicMicroseconds
+	std::string ParseToStatus(HardwareSnapshot const& snapshot, bool connectedToEngines, long long sampledAt);
+	std::string ParseToStopState(long long receivedAt, std::chrono::microseconds latency, std::chrono::microseconds maxLatency);
+	/// Channel 0 is reported as currentTemperature, the device time only if the firmware sent one (>= 0)
+	std::string ParseToTemperatureState(std::string temperature, long long sampledAt, int channel = 0, long long deviceTime = -1); 
+	/// Tracing state, with the file and number of events of the last dump if any
+	std::string ParseToTraceState(bool enabled, std::string const& path, size_t events);
+	TelemetrySubscription ParseToSubscription(std::string const& message);
+	std::string ParseToTelemetry(TelemetryFrame const& frame);
+	/// Throws if a channel is unknown, the range is empty or decimation is below 1
+	HistoryQuery ParseToHistoryQuery(std::string const& message);
+	std::string ParseToHistoryChunk(HistoryChunk const& chunk);
+	MotionProgramSource ParseToMotionProgram(std::string const& message);
+	std::string ParseToProgramStatus(MotionProgramStatus const& status);
+	/// Acknowledgement or outcome of the request with the given id, a completed request carries when it was applied
+	std::string ParseToRequestStatus(std::string const& id, RequestStatus status, long long receivedAt, std::chrono::microseconds elapsed, std::string const& error);
+	/// Throws if a timestamp is missing or malformed
+	ClockExchange ParseToClockExchange(std::string const& message);
+	/// The writer stamps sentAt, which is t0 of a request and t2 of an answer
+	std::string ParseToTimeRequest();
+	std::string ParseToTimeAnswer(long long t0, long long t1);
+	std::string ParseToClockState(long long offset, long long delay);
+	MessageType GetMessageType(std::string const& message);
+	/// Correlation id the message carries (serialized JSON value), empty if none
+	std::string GetMessageId(std::string const& message);
+	CommandType GetCommandType(std::string const& message);
+	/// HardwareState field bits of the setpoints an update message carries, 0 if it is malformed
+	unsigned int GetUpdateFields(std::string const& message);
 };
 
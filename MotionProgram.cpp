@@ -0,0 +1,201 @@
+#include "MotionProgram.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	const int MaxLoopDepth = 8;
+
+	class Compiler
+	{
+	public:
+		Compiler(MotionProgram& program, std::chrono::microseconds tickInterval, MotionProgramLimits const& limits)
+			: program(program), tickInterval(tickInterval), limits(limits)
+		{
+		}
+
+		void Compile(std::vector<MotionInstruction> const& steps, std::string const& path, int depth)
+		{
+			if (depth > MaxLoopDepth)
+			{
+				throw std::invalid_argument(path + ": loops nested deeper than " + std::to_string(MaxLoopDepth));
+			}
+
+			for (size_t i = 0; i < steps.size(); i++)
+			{
+				auto const& step = steps[i];
+				auto stepPath = path + "/" + std::to_string(i);
+
+				switch (step.Operation)
+				{
+					case MotionOperation::Set:
+						this->CompileSet(step, stepPath);
+						break;
+					case MotionOperation::Wait:
+						this->CompileWait(step, stepPath);
+						break;
+					case MotionOperation::Loop:
+					{
+						if (step.Count < 1)
+						{
+							throw std::invalid_argument(stepPath + ": loop count must be at least 1");
+						}
+
+						// Checked before unrolling, a loop over an empty body never reaches Append
+						auto bodySegments = this->CountSegments(step.Body, stepPath, depth + 1);
+						if (bodySegments == 0)
+						{
+							throw std::invalid_argument(stepPath + ": loop has no steps");
+						}
+
+						if ((size_t)step.Count > (this->limits.MaxSegments - this->program.Segments.size()) / bodySegments)
+						{
+							throw std::invalid_argument(stepPath + ": program exceeds " + std::to_string(this->limits.MaxSegments) + " steps once loops are unrolled");
+						}
+
+						for (int repetition = 0; repetition < step.Count; repetition++)
+						{
+							this->Compile(step.Body, stepPath, depth + 1);
+						}
+						break;
+					}
+				}
+			}
+		}
+
+	private:
+		MotionProgram& program;
+		std::chrono::microseconds tickInterval;
+		MotionProgramLimits const& limits;
+
+		void CompileSet(MotionInstruction const& step, std::string const& path)
+		{
+			auto segment = this->Segment(step, path);
+
+			CheckRange(step.Engine1Speed, 0, this->limits.MaxSpeed, path, "engine1Speed");
+			CheckRange(step.Engine2Speed, 0, this->limits.MaxSpeed, path, "engine2Speed");
+			CheckRange(step.Engine1Direction, 0, 1, path, "engine1Direction");
+			CheckRange(step.Engine2Direction, 0, 1, path, "engine2Direction");
+			CheckRange(step.DesiredTemperature, 0, this->limits.MaxTemperature, path, "desiredTemperature");
+
+			// Directions are sticky, a set that only changes a speed keeps the last direction
+			if (step.Engine1Speed || step.Engine1Direction)
+			{
+				segment.MovesEngine1 = true;
+				segment.Engine1Speed = step.Engine1Speed.value_or(this->lastEngine1Speed);
+				segment.Engine1Direction = step.Engine1Direction.value_or(this->lastEngine1Direction);
+				this->lastEngine1Speed = segment.Engine1Speed;
+				this->lastEngine1Direction = segment.Engine1Direction;
+			}
+
+			if (step.Engine2Speed || step.Engine2Direction)
+			{
+				segment.MovesEngine2 = true;
+				segment.Engine2Speed = step.Engine2Speed.value_or(this->lastEngine2Speed);
+				segment.Engine2Direction = step.Engine2Direction.value_or(this->lastEngine2Direction);
+				this->lastEngine2Speed = segment.Engine2Speed;
+				this->lastEngine2Direction = segment.Engine2Direction;
+			}
+
+			if (step.DesiredTemperature)
+			{
+				segment.SetsTemperature = true;
+				segment.DesiredTemperature = *step.DesiredTemperature;
+			}
+
+			this->Append(segment, path);
+		}
+
+		void CompileWait(MotionInstruction const& step, std::string const& path)
+		{
+			this->Append(this->Segment(step, path), path);
+		}
+
+		MotionSegment Segment(MotionInstruction const& step, std::string const& path)
+		{
+			if (step.DurationMs < 0)
+			{
+				throw std::invalid_argument(path + ": duration must not be negative");
+			}
+
+			auto ticks = std::chrono::microseconds(std::chrono::milliseconds(step.DurationMs)).count() / std::max<long long>(this->tickInterval.count(), 1);
+
+			auto segment = MotionSegment();
+			// An immediate set still takes one tick
+			segment.Ticks = (int)std::max<long long>(ticks, 1);
+			return segment;
+		}
+
+		void Append(MotionSegment const& segment, std::string const& path)
+		{
+			if (this->program.Segments.size() >= this->limits.MaxSegments)
+			{
+				throw std::invalid_argument(path + ": program exceeds " + std::to_string(this->limits.MaxSegments) + " steps once loops are unrolled");
+			}
+
+			this->program.Segments.push_back(segment);
+			this->program.TotalTicks += segment.Ticks;
+		}
+
+		/// Segments steps unroll to, saturated above MaxSegments
+		size_t CountSegments(std::vector<MotionInstruction> const& steps, std::string const& path, int depth) const
+		{
+			if (depth > MaxLoopDepth)
+			{
+				throw std::invalid_argument(path + ": loops nested deeper than " + std::to_string(MaxLoopDepth));
+			}
+
+			size_t count = 0;
+			for (auto const& step : steps)
+			{
+				if (step.Operation != MotionOperation::Loop)
+				{
+					count++;
+				}
+				else if (step.Count > 0)
+				{
+					auto body = this->CountSegments(step.Body, path, depth + 1);
+					count += body > 0 && (size_t)step.Count > this->limits.MaxSegments / body ? this->limits.MaxSegments + 1 : step.Count * body;
+				}
+
+				if (count > this->limits.MaxSegments)
+				{
+					return this->limits.MaxSegments + 1;
+				}
+			}
+
+			return count;
+		}
+
+		static void CheckRange(std::optional<int> const& value, int minimum, int maximum, std::string const& path, const char* name)
+		{
+			if (value && (*value < minimum || *value > maximum))
+			{
+				throw std::invalid_argument(path + ": " + name + " " + std::to_string(*value) + " outside of " + std::to_string(minimum) + ".." + std::to_string(maximum));
+			}
+		}
+
+		int lastEngine1Speed = 0;
+		int lastEngine2Speed = 0;
+		int lastEngine1Direction = 1;
+		int lastEngine2Direction = 1;
+	};
+}
+
+MotionProgram MotionProgram::Compile(MotionProgramSource const& source, std::chrono::microseconds tickInterval, MotionProgramLimits const& limits)
+{
+	MotionProgram program;
+	program.Name = source.Name;
+	program.TotalTicks = 0;
+
+	Compiler compiler(program, tickInterval, limits);
+	compiler.Compile(source.Steps, source.Name, 0);
+
+	if (program.Segments.empty())
+	{
+		throw std::invalid_argument(source.Name + ": program has no steps");
+	}
+
+	return program;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+enum class MotionOperation { Set, Wait, Loop };
+
+/// One step of an uploaded motion program, before compilation
+class MotionInstruction
+{
+public:
+	MotionOperation Operation;
+	/// Setpoints changed by a Set, fields left empty keep their value
+	std::optional<int> Engine1Speed;
+	std::optional<int> Engine2Speed;
+	std::optional<int> Engine1Direction;
+	std::optional<int> Engine2Direction;
+	std::optional<int> DesiredTemperature;
+	/// Ramp time of a Set or length of a Wait (in ms)
+	int DurationMs;
+	/// Repetitions of a Loop
+	int Count;
+	std::vector<MotionInstruction> Body;
+};
+
+/// Motion program as uploaded by the server
+class MotionProgramSource
+{
+public:
+	std::string Name;
+	std::vector<MotionInstruction> Steps;
+};
+
+/// Linear move of the engine setpoints to their targets over a number of ticks
+class MotionSegment
+{
+public:
+	int Ticks;
+	int Engine1Speed;
+	int Engine2Speed;
+	int Engine1Direction;
+	int Engine2Direction;
+	/// Engines without a target keep the speed they have when the segment starts
+	bool MovesEngine1;
+	bool MovesEngine2;
+	bool SetsTemperature;
+	int DesiredTemperature;
+};
+
+/// Limits a program is validated against
+class MotionProgramLimits
+{
+public:
+	int MaxSpeed;
+	int MaxTemperature;
+	size_t MaxSegments;
+};
+
+/// Validated program compiled into a flat step table, loops unrolled
+class MotionProgram
+{
+public:
+	std::string Name;
+	std::vector<MotionSegment> Segments;
+	long long TotalTicks;
+
+	/// Throws std::invalid_argument describing the first invalid step
+	static MotionProgram Compile(MotionProgramSource const& source, std::chrono::microseconds tickInterval, MotionProgramLimits const& limits);
+};
+
+enum class ProgramState { Empty, Loaded, Running, Paused, Finished, Aborted };
+
+class MotionProgramStatus
+{
+public:
+	std::string Name;
+	ProgramState State;
+	/// Index of the segment being executed
+	size_t Segment;
+	size_t Segments;
+	long long TicksDone;
+	long long TotalTicks;
+};
@@ -0,0 +1,283 @@
+#include "MotionProgramRunner.h"
+
+#include <cmath>
+#include <spdlog/spdlog.h>
+
+MotionProgramRunner::MotionProgramRunner(EnginesController* enginesController, PowerController* powerController, HardwareStateStore* stateStore, PeriodicScheduler* scheduler, std::chrono::microseconds tickInterval, MotionProgramLimits limits)
+	: enginesController(enginesController),
+	powerController(powerController),
+	stateStore(stateStore),
+	scheduler(scheduler),
+	tickInterval(tickInterval),
+	limits(limits),
+	state(ProgramState::Empty),
+	task(0),
+	run(0),
+	stopGeneration(0),
+	segment(0),
+	segmentTick(0),
+	ticksDone(0),
+	engine1Speed(0),
+	engine2Speed(0),
+	engine1From(0),
+	engine2From(0),
+	engine1Direction(1),
+	engine2Direction(1)
+{
+}
+
+MotionProgramRunner::~MotionProgramRunner()
+{
+	PeriodicScheduler::TaskId runningTask;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		runningTask = this->task;
+		this->state = ProgramState::Aborted;
+	}
+
+	if (runningTask != 0)
+	{
+		this->scheduler->Remove(runningTask);
+		this->enginesController->SetProgramActive(false);
+	}
+}
+
+void MotionProgramRunner::Load(MotionProgramSource const& source)
+{
+	auto compiled = MotionProgram::Compile(source, this->tickInterval, this->limits);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (this->state == ProgramState::Running || this->state == ProgramState::Paused)
+	{
+		throw std::invalid_argument("Program " + this->program.Name + " is still running");
+	}
+
+	this->program = compiled;
+	spdlog::info("Motion program :: Loaded {} with {} steps ({} ticks)", this->program.Name, this->program.Segments.size(), this->program.TotalTicks);
+	this->ChangeState(ProgramState::Loaded);
+}
+
+bool MotionProgramRunner::Start()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (this->state != ProgramState::Loaded && this->state != ProgramState::Finished && this->state != ProgramState::Aborted)
+	{
+		spdlog::warn("Motion program :: Nothing to start.");
+		return false;
+	}
+
+	if (!this->enginesController->IsConnected())
+	{
+		spdlog::warn("Motion program :: Attempted to start {} while engines were not connected.", this->program.Name);
+		return false;
+	}
+
+	// Programs take over from the setpoints in the store, which an update still ramping has not reached yet
+	this->enginesController->SetProgramActive(true);
+	if (this->enginesController->IsApplyingUpdate())
+	{
+		this->enginesController->SetProgramActive(false);
+		spdlog::warn("Motion program :: Attempted to start {} while an engine update was being applied.", this->program.Name);
+		return false;
+	}
+
+	auto snapshot = this->stateStore->Current();
+	this->engine1Speed = snapshot->Engine1Speed.Value;
+	this->engine2Speed = snapshot->Engine2Speed.Value;
+	this->engine1Direction = snapshot->Engine1Direction.Value;
+	this->engine2Direction = snapshot->Engine2Direction.Value;
+
+	this->segment = 0;
+	this->segmentTick = 0;
+	this->ticksDone = 0;
+	this->stopGeneration = this->enginesController->StopGeneration();
+
+	auto run = ++this->run;
+	this->task = this->scheduler->Add("motion program", this->tickInterval, [this, run] { return this->Tick(run); });
+
+	spdlog::info("Motion program :: Started {}", this->program.Name);
+	this->ChangeState(ProgramState::Running);
+	return true;
+}
+
+bool MotionProgramRunner::Pause()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (this->state != ProgramState::Running)
+	{
+		return false;
+	}
+
+	this->ChangeState(ProgramState::Paused);
+	return true;
+}
+
+bool MotionProgramRunner::Resume()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (this->state != ProgramState::Paused)
+	{
+		return false;
+	}
+
+	this->ChangeState(ProgramState::Running);
+	return true;
+}
+
+bool MotionProgramRunner::Abort()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		if (this->state != ProgramState::Running && this->state != ProgramState::Paused)
+		{
+			return false;
+		}
+
+		// The next tick sees the state and ends the task
+		this->task = 0;
+		this->enginesController->SetProgramActive(false);
+		spdlog::info("Motion program :: Aborted {} at step {}", this->program.Name, this->segment);
+		this->ChangeState(ProgramState::Aborted);
+	}
+
+	this->enginesController->EmergencyStop(true, std::chrono::steady_clock::now());
+	return true;
+}
+
+MotionProgramStatus MotionProgramRunner::Status() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->StatusLocked();
+}
+
+void MotionProgramRunner::SetListener(Listener listener)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->listener = listener;
+}
+
+bool MotionProgramRunner::Tick(unsigned long run)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (run != this->run || (this->state != ProgramState::Running && this->state != ProgramState::Paused))
+	{
+		return false;
+	}
+
+	if (this->enginesController->StopGeneration() != this->stopGeneration)
+	{
+		spdlog::warn("Motion program :: {} aborted by a stop request at step {}", this->program.Name, this->segment);
+		this->task = 0;
+		this->enginesController->SetProgramActive(false);
+		this->ChangeState(ProgramState::Aborted);
+		return false;
+	}
+
+	if (this->state == ProgramState::Paused)
+	{
+		return true;
+	}
+
+	auto const& current = this->program.Segments[this->segment];
+
+	// A segment starts from the speeds the previous one reached
+	double engine1From = this->segmentTick == 0 ? this->engine1Speed : this->engine1From;
+	double engine2From = this->segmentTick == 0 ? this->engine2Speed : this->engine2From;
+	int engine1Direction = current.MovesEngine1 ? current.Engine1Direction : this->engine1Direction;
+	int engine2Direction = current.MovesEngine2 ? current.Engine2Direction : this->engine2Direction;
+	double engine1Speed = this->engine1Speed;
+	double engine2Speed = this->engine2Speed;
+
+	double fraction = (double)(this->segmentTick + 1) / current.Ticks;
+	if (current.MovesEngine1)
+	{
+		engine1Speed = engine1From + (current.Engine1Speed - engine1From) * fraction;
+	}
+
+	if (current.MovesEngine2)
+	{
+		engine2Speed = engine2From + (current.Engine2Speed - engine2From) * fraction;
+	}
+
+	auto result = this->enginesController->SetVelocities(
+		(int)std::lround(engine1Speed), engine1Direction,
+		(int)std::lround(engine2Speed), engine2Direction,
+		this->stopGeneration);
+
+	// The tick is repeated once the update holding the engines is done
+	if (result == VelocitiesBusy)
+	{
+		return true;
+	}
+
+	if (result == VelocitiesStopped)
+	{
+		spdlog::warn("Motion program :: {} aborted at step {}, the engines refused the setpoints", this->program.Name, this->segment);
+		this->task = 0;
+		this->enginesController->SetProgramActive(false);
+		this->ChangeState(ProgramState::Aborted);
+		return false;
+	}
+
+	if (this->segmentTick == 0 && current.SetsTemperature)
+	{
+		auto update = HardwareState();
+		update.DesiredTemperature = current.DesiredTemperature;
+		update.Fields = HardwareState::DesiredTemperatureField;
+		this->powerController->UpdatePowerState(update);
+	}
+
+	this->engine1From = engine1From;
+	this->engine2From = engine2From;
+	this->engine1Direction = engine1Direction;
+	this->engine2Direction = engine2Direction;
+	this->engine1Speed = engine1Speed;
+	this->engine2Speed = engine2Speed;
+	this->segmentTick++;
+	this->ticksDone++;
+
+	if (this->segmentTick < current.Ticks)
+	{
+		return true;
+	}
+
+	this->segmentTick = 0;
+	if (++this->segment < this->program.Segments.size())
+	{
+		return true;
+	}
+
+	spdlog::info("Motion program :: Finished {}", this->program.Name);
+	this->task = 0;
+	this->enginesController->SetProgramActive(false);
+	this->ChangeState(ProgramState::Finished);
+	return false;
+}
+
+void MotionProgramRunner::ChangeState(ProgramState state)
+{
+	this->state = state;
+
+	if (this->listener)
+	{
+		this->listener(this->StatusLocked());
+	}
+}
+
+MotionProgramStatus MotionProgramRunner::StatusLocked() const
+{
+	MotionProgramStatus status;
+	status.Name = this->program.Name;
+	status.State = this->state;
+	status.Segment = this->segment;
+	status.Segments = this->program.Segments.size();
+	status.TicksDone = this->ticksDone;
+	status.TotalTicks = this->program.TotalTicks;
+	return status;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "EnginesController.h"
+#include "HardwareStateStore.h"
+#include "MotionProgram.h"
+#include "PeriodicScheduler.h"
+#include "PowerController.h"
+
+/// Executes an uploaded motion program one setpoint per scheduler tick. Engine
+/// updates from the server are refused while a program runs, a stop aborts it.
+class MotionProgramRunner
+{
+public:
+	typedef std::function<void(MotionProgramStatus const&)> Listener;
+
+	MotionProgramRunner(EnginesController* enginesController, PowerController* powerController, HardwareStateStore* stateStore, PeriodicScheduler* scheduler, std::chrono::microseconds tickInterval, MotionProgramLimits limits);
+	~MotionProgramRunner();
+
+	/// Validates and compiles source, throws std::invalid_argument if it is rejected
+	void Load(MotionProgramSource const& source);
+	bool Start();
+	bool Pause();
+	bool Resume();
+	bool Abort();
+
+	MotionProgramStatus Status() const;
+	/// Called on every state change, from the thread that caused it
+	void SetListener(Listener listener);
+
+private:
+	EnginesController* enginesController;
+	PowerController* powerController;
+	HardwareStateStore* stateStore;
+	PeriodicScheduler* scheduler;
+	const std::chrono::microseconds tickInterval;
+	const MotionProgramLimits limits;
+
+	/// Guards everything below
+	mutable std::mutex mutex;
+	MotionProgram program;
+	ProgramState state;
+	PeriodicScheduler::TaskId task;
+	/// Incremented by every start, ticks of an earlier run end themselves
+	unsigned long run;
+	/// Stop generation the program was started in, a stop aborts the program
+	unsigned long stopGeneration;
+	size_t segment;
+	int segmentTick;
+	long long ticksDone;
+	/// Commanded setpoints, segments ramp from the values they start with
+	double engine1Speed;
+	double engine2Speed;
+	double engine1From;
+	double engine2From;
+	int engine1Direction;
+	int engine2Direction;
+	Listener listener;
+
+	bool Tick(unsigned long run);
+	void ChangeState(ProgramState state);
+	MotionProgramStatus StatusLocked() const;
+};
@@ -0,0 +1,130 @@
+#include "OutboundQueue.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace
+{
+	const char* const OutboundTypeNames[OutboundTypeCount] = {
+		"reply",
+		"status",
+		"temperature",
+		"telemetry",
+	};
+}
+
+OutboundQueue::OutboundQueue(size_t capacity)
+	: capacity(std::max<size_t>(capacity, 1)),
+	maxDepth(0)
+{
+	std::fill(std::begin(this->queued), std::end(this->queued), 0);
+	std::fill(std::begin(this->dropped), std::end(this->dropped), 0);
+	std::fill(std::begin(this->coalesced), std::end(this->coalesced), 0);
+}
+
+void OutboundQueue::SetListener(Listener listener)
+{
+	std::lock_guard<std::mutex> lock(this->queueMutex);
+	this->listener = listener;
+}
+
+void OutboundQueue::Push(std::string message, OutboundType type, int channel)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->queueMutex);
+
+		// Only the latest status and temperature of each channel matter, the queued one is brought up to date in place
+		if ((type == OutboundType::StatusReply || type == OutboundType::TemperatureReading) && this->queued[type] > 0)
+		{
+			auto entry = std::find_if(this->messages.begin(), this->messages.end(), [type, channel](Entry const& entry) { return entry.Type == type && entry.Channel == channel; });
+			if (entry != this->messages.end())
+			{
+				entry->Message = std::move(message);
+				this->coalesced[type]++;
+				return;
+			}
+		}
+
+		if (this->messages.size() >= this->capacity && this->queued[OutboundType::TelemetryUpdate] > 0)
+		{
+			auto oldest = std::find_if(this->messages.begin(), this->messages.end(), [](Entry const& entry) { return entry.Type == OutboundType::TelemetryUpdate; });
+			this->messages.erase(oldest);
+			this->queued[OutboundType::TelemetryUpdate]--;
+			this->dropped[OutboundType::TelemetryUpdate]++;
+		}
+
+		// Replies are never dropped, they are bounded by the requests the server sends
+		if (this->messages.size() >= this->capacity && type == OutboundType::TelemetryUpdate)
+		{
+			this->dropped[type]++;
+			return;
+		}
+
+		Entry entry;
+		entry.Message = std::move(message);
+		entry.Type = type;
+		entry.Channel = channel;
+		this->messages.push_back(std::move(entry));
+		this->queued[type]++;
+		this->maxDepth = std::max(this->maxDepth, this->messages.size());
+
+		if (this->messages.size() == 1 && this->listener)
+		{
+			this->listener();
+		}
+	}
+
+	this->queueCondition.notify_one();
+}
+
+bool OutboundQueue::PopBatch(std::vector<std::string>& out, size_t maxCount, std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(this->queueMutex);
+
+	if (!this->queueCondition.wait_for(lock, timeout, [this] { return !this->messages.empty(); }))
+	{
+		return false;
+	}
+
+	while (!this->messages.empty() && out.size() < maxCount)
+	{
+		auto& entry = this->messages.front();
+		this->queued[entry.Type]--;
+		out.push_back(std::move(entry.Message));
+		this->messages.pop_front();
+	}
+
+	return true;
+}
+
+size_t OutboundQueue::Depth()
+{
+	std::lock_guard<std::mutex> lock(this->queueMutex);
+	return this->messages.size();
+}
+
+unsigned long long OutboundQueue::Dropped(OutboundType type)
+{
+	std::lock_guard<std::mutex> lock(this->queueMutex);
+	return this->dropped[type];
+}
+
+unsigned long long OutboundQueue::Coalesced(OutboundType type)
+{
+	std::lock_guard<std::mutex> lock(this->queueMutex);
+	return this->coalesced[type];
+}
+
+void OutboundQueue::LogSummary()
+{
+	std::lock_guard<std::mutex> lock(this->queueMutex);
+
+	spdlog::info("Outbound queue :: depth {} (max {}, capacity {})", this->messages.size(), this->maxDepth, this->capacity);
+	for (int type = 0; type < OutboundTypeCount; type++)
+	{
+		if (this->dropped[type] > 0 || this->coalesced[type] > 0)
+		{
+			spdlog::info("Outbound queue :: {} dropped {} coalesced {}", OutboundTypeNames[type], this->dropped[type], this->coalesced[type]);
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Enums.h"
+
+/// Messages waiting to be written to the websocket by the writer thread. Pushing never blocks:
+/// when the server reads slower than the controller produces, messages are dropped by type.
+///  - Reply (acknowledgements, command and update replies) is never dropped
+///  - StatusReply keeps only the latest queued message, TemperatureReading the latest one of each channel
+///  - TelemetryUpdate is dropped oldest first once the queue holds capacity messages
+class OutboundQueue
+{
+public:
+	/// Invoked when a message is pushed into an empty queue
+	typedef std::function<void()> Listener;
+
+	OutboundQueue(size_t capacity = 256);
+
+	/// Replaces the listener, an empty one removes it. No call is made once this returns.
+	void SetListener(Listener listener);
+
+	/// channel tells apart the messages of one type that are coalesced separately (thermocouples)
+	void Push(std::string message, OutboundType type, int channel = 0);
+
+	/// Moves up to maxCount waiting messages into out, waiting at most timeout for the first one.
+	/// Returns false if nothing was waiting.
+	bool PopBatch(std::vector<std::string>& out, size_t maxCount, std::chrono::milliseconds timeout);
+
+	/// Number of messages waiting to be written
+	size_t Depth();
+	/// Messages of type discarded because the queue was full
+	unsigned long long Dropped(OutboundType type);
+	/// Messages of type replaced by a newer one before they were written
+	unsigned long long Coalesced(OutboundType type);
+	void LogSummary();
+
+private:
+	class Entry
+	{
+	public:
+		std::string Message;
+		OutboundType Type;
+		int Channel;
+	};
+
+	const size_t capacity;
+
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::deque<Entry> messages;
+	Listener listener;
+	size_t queued[OutboundTypeCount];
+	unsigned long long dropped[OutboundTypeCount];
+	unsigned long long coalesced[OutboundTypeCount];
+	size_t maxDepth;
+};
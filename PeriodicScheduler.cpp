@@ -0,0 +1,291 @@
+#include "PeriodicScheduler.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+PeriodicScheduler::PeriodicScheduler(int cpu, int priority, int threads)
+	: cpu(cpu),
+	priority(priority),
+	nextTaskId(1),
+	changes(0),
+	stopping(false)
+{
+#ifdef _WIN32
+	// Without this, waits are rounded up to the 15.6 ms system timer tick
+	timeBeginPeriod(1);
+#endif
+
+	if (threads < 1)
+	{
+		threads = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+
+	for (int i = 0; i < threads; i++)
+	{
+		this->threads.push_back(std::thread(&PeriodicScheduler::Run, this, i));
+	}
+}
+
+PeriodicScheduler::~PeriodicScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->condition.notify_all();
+
+	for (auto& thread : this->threads)
+	{
+		thread.join();
+	}
+
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif
+}
+
+PeriodicScheduler::TaskId PeriodicScheduler::Add(std::string name, std::chrono::microseconds period, Tick tick)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	auto task = std::make_shared<Task>();
+	task->Id = this->nextTaskId++;
+	task->Name = name;
+	task->Period = period;
+	task->Function = tick;
+	task->Deadline = std::chrono::steady_clock::now();
+	task->StatisticsIndex = this->StatisticsIndexFor(name, period);
+	task->Claimed = false;
+	task->Running = false;
+
+	this->tasks.push_back(task);
+	this->changes++;
+	this->condition.notify_all();
+
+	return task->Id;
+}
+
+void PeriodicScheduler::Remove(TaskId id)
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	auto task = std::find_if(this->tasks.begin(), this->tasks.end(), [id](std::shared_ptr<Task> const& task) { return task->Id == id; });
+	if (task == this->tasks.end())
+	{
+		return;
+	}
+
+	// Taken off the list first, so no pool thread picks it up again while this waits
+	auto removed = *task;
+	this->tasks.erase(task);
+	this->changes++;
+	this->condition.notify_all();
+
+	// A task removed from its own tick finishes the run it is in
+	if (removed->RunningOn != std::this_thread::get_id())
+	{
+		this->runFinished.wait(lock, [&] { return !removed->Running; });
+	}
+}
+
+std::vector<TaskStatistics> PeriodicScheduler::Statistics() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	std::vector<TaskStatistics> result;
+	for (auto const& entry : this->statistics)
+	{
+		auto const& accumulator = entry.second;
+
+		TaskStatistics statistics;
+		statistics.Name = entry.first;
+		statistics.Period = accumulator.Period;
+		statistics.Runs = accumulator.Runs;
+		statistics.Overruns = accumulator.Overruns;
+		statistics.MeanJitter = std::chrono::microseconds(accumulator.Runs > 0 ? accumulator.JitterSum / (long long)accumulator.Runs : 0);
+		statistics.MaxJitter = std::chrono::microseconds(accumulator.MaxJitter);
+		statistics.MaxDuration = std::chrono::microseconds(accumulator.MaxDuration);
+		result.push_back(statistics);
+	}
+
+	return result;
+}
+
+void PeriodicScheduler::LogStatistics() const
+{
+	for (auto const& statistics : this->Statistics())
+	{
+		spdlog::info("Scheduler :: {} period {} us runs {} overruns {} jitter mean {} us max {} us longest run {} us",
+			statistics.Name, statistics.Period.count(), statistics.Runs, statistics.Overruns,
+			statistics.MeanJitter.count(), statistics.MaxJitter.count(), statistics.MaxDuration.count());
+	}
+}
+
+void PeriodicScheduler::Run(int index)
+{
+	this->ConfigureThread(index);
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	while (!this->stopping)
+	{
+		// The earliest task no other pool thread waits for or runs
+		std::shared_ptr<Task> next;
+		for (auto const& task : this->tasks)
+		{
+			if (!task->Claimed && (!next || task->Deadline < next->Deadline))
+			{
+				next = task;
+			}
+		}
+
+		auto seen = this->changes;
+		if (!next)
+		{
+			this->condition.wait(lock, [&] { return this->stopping || this->changes != seen; });
+			continue;
+		}
+
+		auto deadline = next->Deadline;
+
+		// Claimed while waiting, so the other pool threads wait for other tasks instead of running this one too
+		next->Claimed = true;
+
+		// Waiting for an absolute deadline keeps late wakeups from accumulating as drift
+		if (deadline > std::chrono::steady_clock::now() && this->condition.wait_until(lock, deadline, [&] { return this->stopping || this->changes != seen; }))
+		{
+			// An earlier task may have been added, this one is picked again if it still is the earliest
+			next->Claimed = false;
+			continue;
+		}
+
+		next->Running = true;
+		next->RunningOn = std::this_thread::get_id();
+		lock.unlock();
+
+		auto started = std::chrono::steady_clock::now();
+		bool keep = false;
+		try
+		{
+			keep = next->Function();
+		}
+		catch (std::exception const& e)
+		{
+			spdlog::error("Scheduler :: Task {} failed and was removed: {}", next->Name, e.what());
+		}
+		auto finished = std::chrono::steady_clock::now();
+
+		lock.lock();
+		next->Running = false;
+		next->Claimed = false;
+		next->RunningOn = std::thread::id();
+		this->runFinished.notify_all();
+
+		long long jitter = std::chrono::duration_cast<std::chrono::microseconds>(started - deadline).count();
+		long long duration = std::chrono::duration_cast<std::chrono::microseconds>(finished - started).count();
+
+		auto& accumulator = this->statistics[next->StatisticsIndex].second;
+		accumulator.Runs++;
+		accumulator.JitterSum += jitter;
+		accumulator.MaxJitter = std::max(accumulator.MaxJitter, jitter);
+		accumulator.MaxDuration = std::max(accumulator.MaxDuration, duration);
+
+		auto current = std::find(this->tasks.begin(), this->tasks.end(), next);
+		if (current == this->tasks.end())
+		{
+			continue;
+		}
+
+		if (!keep)
+		{
+			this->tasks.erase(current);
+			continue;
+		}
+
+		// No wakeup needed, this thread looks for the earliest deadline next
+		next->Deadline = deadline + next->Period;
+		if (next->Deadline <= finished && next->Period.count() > 0)
+		{
+			// Missed periods are skipped rather than run back to back
+			accumulator.Overruns++;
+			auto missed = (finished - next->Deadline) / next->Period + 1;
+			next->Deadline += missed * next->Period;
+		}
+	}
+}
+
+void PeriodicScheduler::ConfigureThread(int index)
+{
+	SetTraceThreadName("scheduler");
+
+#ifdef _WIN32
+	if (this->cpu >= 0 && SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << (this->cpu + index)) == 0)
+	{
+		spdlog::warn("Scheduler :: Pinning to cpu {} failed with error {}", this->cpu + index, GetLastError());
+	}
+
+	if (this->priority > 0 && !SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+	{
+		spdlog::warn("Scheduler :: Raising thread priority failed with error {}", GetLastError());
+	}
+#else
+	if (this->cpu >= 0)
+	{
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(this->cpu + index, &cpus);
+
+		int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if (error != 0)
+		{
+			spdlog::warn("Scheduler :: Pinning to cpu {} failed with error {}", this->cpu + index, error);
+		}
+	}
+
+	if (this->priority > 0)
+	{
+		sched_param parameters;
+		parameters.sched_priority = this->priority;
+
+		int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+		if (error != 0)
+		{
+			spdlog::warn("Scheduler :: Switching to SCHED_FIFO priority {} failed with error {}", this->priority, error);
+		}
+	}
+#endif
+
+	spdlog::info("Scheduler :: Started thread {} (cpu {}, priority {})", index, this->cpu >= 0 ? this->cpu + index : this->cpu, this->priority);
+}
+
+size_t PeriodicScheduler::StatisticsIndexFor(std::string const& name, std::chrono::microseconds period)
+{
+	for (size_t i = 0; i < this->statistics.size(); i++)
+	{
+		if (this->statistics[i].first == name)
+		{
+			return i;
+		}
+	}
+
+	Accumulator accumulator;
+	accumulator.Period = period;
+	accumulator.Runs = 0;
+	accumulator.Overruns = 0;
+	accumulator.JitterSum = 0;
+	accumulator.MaxJitter = 0;
+	accumulator.MaxDuration = 0;
+
+	this->statistics.push_back(std::make_pair(name, accumulator));
+	return this->statistics.size() - 1;
+}
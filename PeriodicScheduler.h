@@ -0,0 +1,103 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Timing statistics of one named periodic task
+class TaskStatistics
+{
+public:
+	std::string Name;
+	std::chrono::microseconds Period;
+	unsigned long long Runs;
+	/// Runs which did not finish before their next deadline
+	unsigned long long Overruns;
+	/// How late runs started relative to their deadline
+	std::chrono::microseconds MeanJitter;
+	std::chrono::microseconds MaxJitter;
+	std::chrono::microseconds MaxDuration;
+};
+
+/// Runs periodic control tasks on a pool of threads against absolute deadlines, so that
+/// a late run does not shift the runs after it. A task runs once per period, never on two threads at once.
+class PeriodicScheduler
+{
+public:
+	typedef unsigned long TaskId;
+	/// Invoked once per period, returning false removes the task
+	typedef std::function<bool()> Tick;
+
+	/// cpu pins the scheduler threads to consecutive CPUs starting at cpu (negative to not pin),
+	/// a positive priority runs them with real-time (SCHED_FIFO) priority where permitted.
+	/// threads below 1 sizes the pool to the number of cores.
+	PeriodicScheduler(int cpu = -1, int priority = 0, int threads = 1);
+	~PeriodicScheduler();
+
+	PeriodicScheduler(const PeriodicScheduler&) = delete;
+	PeriodicScheduler& operator=(const PeriodicScheduler&) = delete;
+
+	/// Runs tick immediately and then every period. Statistics are kept per name,
+	/// so repeatedly added tasks of one kind (ramps) are reported together.
+	TaskId Add(std::string name, std::chrono::microseconds period, Tick tick);
+	/// Removes task, waiting for a run in progress to finish unless called from a tick
+	void Remove(TaskId id);
+
+	std::vector<TaskStatistics> Statistics() const;
+	void LogStatistics() const;
+
+private:
+	class Task
+	{
+	public:
+		TaskId Id;
+		std::string Name;
+		std::chrono::microseconds Period;
+		Tick Function;
+		std::chrono::steady_clock::time_point Deadline;
+		/// Index of the statistics entry of the task name
+		size_t StatisticsIndex;
+		/// Set while a pool thread waits for the deadline of the task or executes it
+		bool Claimed;
+		/// Set while a pool thread executes the task
+		bool Running;
+		std::thread::id RunningOn;
+	};
+
+	class Accumulator
+	{
+	public:
+		std::chrono::microseconds Period;
+		unsigned long long Runs;
+		unsigned long long Overruns;
+		long long JitterSum;
+		long long MaxJitter;
+		long long MaxDuration;
+	};
+
+	const int cpu;
+	const int priority;
+
+	/// Guards everything below
+	mutable std::mutex mutex;
+	/// Wakes pool threads waiting for a deadline when tasks were added or removed
+	std::condition_variable condition;
+	/// Wakes Remove calls waiting for a run to finish
+	std::condition_variable runFinished;
+	std::vector<std::shared_ptr<Task>> tasks;
+	std::vector<std::pair<std::string, Accumulator>> statistics;
+	TaskId nextTaskId;
+	/// Incremented whenever tasks are added or removed
+	unsigned long long changes;
+	bool stopping;
+
+	std::vector<std::thread> threads;
+
+	void Run(int index);
+	void ConfigureThread(int index);
+	size_t StatisticsIndexFor(std::string const& name, std::chrono::microseconds period);
+};
@@ -1,11 +1,24 @@
 #include "PowerController.h"
+#include "Tracer.h"
 
-PowerController::PowerController(std::string portName, int baudrate, boost::asio::io_service* io) : baudrate(baudrate), temperature(0), portName(portName), port(*io)
+PowerController::PowerController(std::string portName, int baudrate, boost::asio::io_service* io, HardwareStateStore* stateStore, PeriodicScheduler* scheduler, StateCheckpoint* checkpoint)
+	: port(*io), portName(portName), baudrate(baudrate), stateStore(stateStore), scheduler(scheduler), checkpoint(checkpoint), pendingTemperature(0), appliedTemperature(0), supplySequenceRunning(false), supplyStep(0)
 {  
-	port.open(this->portName);
-	port.set_option(boost::asio::serial_port_base::baud_rate(this->baudrate));
-	port.set_option(boost::asio::serial_port_base::parity(boost::asio::serial_port_base::parity::none));
-	port.set_option(boost::asio::serial_port_base::stop_bits(boost::asio::serial_port_base::stop_bits::one));
+	this->OpenPort();
+
+	auto saved = this->checkpoint != nullptr ? this->checkpoint->Restored() : CheckpointState();
+	if (saved.Valid && saved.SupplyConfigured)
+	{
+		// The supply keeps its output and setpoint while the controller restarts, resending them would only glitch the output
+		spdlog::info("Power Controller :: Resuming at temperature {} from checkpoint, supply is not re-initialized", saved.SupplyTemperature);
+		port.close();
+
+		this->pendingTemperature = saved.SupplyTemperature;
+		this->appliedTemperature = saved.SupplyTemperature;
+		this->stateStore->SetDesiredTemperature(saved.SupplyTemperature, StateSource::PowerSupply);
+		this->stateStore->SetSupplyVoltage(this->CalculateVoltageByTemperature(saved.SupplyTemperature), StateSource::PowerSupply);
+		return;
+	}
 
 	auto data = std::string("SOUT1\r");
 	boost::asio::write(port, boost::asio::buffer(data, 10));
@@ -16,29 +29,46 @@ PowerController::PowerController(std::string portName, int baudrate, boost::asio
 	std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
 	port.close();
+
+	if (this->checkpoint != nullptr)
+	{
+		this->checkpoint->SetSupply(true, 0);
+	}
+}
+
+void PowerController::OpenPort()
+{
+	port.open(this->portName);
+	port.set_option(boost::asio::serial_port_base::baud_rate(this->baudrate));
+	port.set_option(boost::asio::serial_port_base::parity(boost::asio::serial_port_base::parity::none));
+	port.set_option(boost::asio::serial_port_base::stop_bits(boost::asio::serial_port_base::stop_bits::one));
 }
 
 bool PowerController::UpdatePowerState(HardwareState update)
 { 
-	if (update.DesiredTemperature == temperature) 
+	auto temperature = update.DesiredTemperature;
+
+	if (temperature == this->stateStore->Current()->DesiredTemperature.Value) 
 	{
 		return true;
 	}
 
-	this->temperature = update.DesiredTemperature; 
+	this->stateStore->SetDesiredTemperature(temperature, StateSource::Server); 
 
-	try 
-	{    
-		std::thread t([this]{ this->SetCurrentAndVoltage(); });
-		t.detach();
+	std::lock_guard<std::mutex> lock(this->supplyMutex);
+	this->pendingTemperature = temperature;
 
-		return true;
+	// A running sequence picks the new temperature up when it finishes
+	if (!this->supplySequenceRunning)
+	{
+		this->supplySequenceRunning = true;
+		this->supplyStep = 0;
+
+		// The supply needs 100 ms between two commands
+		this->scheduler->Add("power supply", std::chrono::milliseconds(100), [this] { return this->SetCurrentAndVoltageStep(); });
 	}
-	catch (boost::system::system_error e)
-	{ 
-		spdlog::error("Error in power controller {}", e.what());
-		return false;
-	} 
+
+	return true;
 }
 
 double PowerController::CalculateVoltageByTemperature(int temperature)
@@ -46,32 +76,83 @@ double PowerController::CalculateVoltageByTemperature(int temperature)
 	return (double)temperature * 0.025643;
 }
 
-void PowerController::SetCurrentAndVoltage()
+bool PowerController::SetCurrentAndVoltageStep()
 {
-	port.open(this->portName);
-	port.set_option(boost::asio::serial_port_base::baud_rate(this->baudrate));
-	port.set_option(boost::asio::serial_port_base::parity(boost::asio::serial_port_base::parity::none));
-	port.set_option(boost::asio::serial_port_base::stop_bits(boost::asio::serial_port_base::stop_bits::one)); 
+	TraceScope trace("power supply write", "power", this->supplyStep);
 
-	auto data = std::string("SOUT1\r");
-	boost::asio::write(port, boost::asio::buffer(data, sizeof(data)));
-	std::this_thread::sleep_for(std::chrono::milliseconds(100)); 
+	try
+	{
+		switch (this->supplyStep++)
+		{
+			case 0:
+			{
+				// Until the sequence completes the supply setpoint is unknown, a restart in between initializes it again
+				if (this->checkpoint != nullptr)
+				{
+					this->checkpoint->SetSupply(false, this->appliedTemperature);
+				}
 
-	auto voltage = this->CalculateVoltageByTemperature(this->temperature);
-	 
-	char s[10]; 
-	snprintf(s, 10, "%05.2f", voltage); 
-	std::string str(s);
-	boost::erase_all(str, ".");
+				this->OpenPort();
 
-	data = std::string("VOLT 0") + str + std::string("\r"); 
-	auto x = data.c_str();
-	boost::asio::write(port, boost::asio::buffer(data, sizeof(data)));
-	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				auto data = std::string("SOUT1\r");
+				boost::asio::write(port, boost::asio::buffer(data, sizeof(data)));
+				return true;
+			}
+			case 1:
+			{
+				{
+					std::lock_guard<std::mutex> lock(this->supplyMutex);
+					this->appliedTemperature = this->pendingTemperature;
+				}
 
-	data = std::string("CURR 00200") + std::string("\r");
-	boost::asio::write(port, boost::asio::buffer(data, sizeof(data)));
-	std::this_thread::sleep_for(std::chrono::milliseconds(100)); 
+				auto voltage = this->CalculateVoltageByTemperature(this->appliedTemperature);
+				 
+				char s[10]; 
+				snprintf(s, 10, "%05.2f", voltage); 
+				std::string str(s);
+				boost::erase_all(str, ".");
 
-	port.close();
+				auto data = std::string("VOLT 0") + str + std::string("\r"); 
+				boost::asio::write(port, boost::asio::buffer(data, sizeof(data)));
+				this->stateStore->SetSupplyVoltage(voltage, StateSource::PowerSupply);
+				return true;
+			}
+			case 2:
+			{
+				auto data = std::string("CURR 00200") + std::string("\r");
+				boost::asio::write(port, boost::asio::buffer(data, sizeof(data)));
+				return true;
+			}
+		}
+
+		port.close();
+	}
+	catch (boost::system::system_error e)
+	{ 
+		spdlog::error("Error in power controller {}", e.what());
+
+		boost::system::error_code ec;
+		port.close(ec);
+
+		// Retried with the next temperature change rather than every period
+		std::lock_guard<std::mutex> lock(this->supplyMutex);
+		this->supplySequenceRunning = false;
+		return false;
+	} 
+
+	std::lock_guard<std::mutex> lock(this->supplyMutex);
+	if (this->pendingTemperature != this->appliedTemperature)
+	{
+		this->supplyStep = 0;
+		return true;
+	}
+
+	this->supplySequenceRunning = false;
+
+	if (this->checkpoint != nullptr)
+	{
+		this->checkpoint->SetSupply(true, this->appliedTemperature);
+	}
+
+	return false;
 }
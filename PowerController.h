@@ -4,22 +4,43 @@
 #include <boost/asio.hpp>  
 #include <spdlog/spdlog.h>  
 #include <chrono>
+#include <mutex>
 #include <thread>
 
 #include "HardwareState.h"
+#include "HardwareStateStore.h"
+#include "PeriodicScheduler.h"
+#include "StateCheckpoint.h"
 
 class PowerController
 {
 public:
-	PowerController(std::string portName, int baudrate, boost::asio::io_service* io);
+	/// Initializes the supply, unless checkpoint shows it was configured before a restart
+	PowerController(std::string portName, int baudrate, boost::asio::io_service* io, HardwareStateStore* stateStore, PeriodicScheduler* scheduler, StateCheckpoint* checkpoint = nullptr);
 	bool UpdatePowerState(HardwareState update);
-	void SetCurrentAndVoltage();
 private:    
 	boost::asio::serial_port port;
 	//boost::asio::io_service io;
 	std::string portName;
 	int baudrate;
-	int temperature;
+	HardwareStateStore* stateStore;
+	/// Paces the power supply command sequence
+	PeriodicScheduler* scheduler;
+	/// Receives the applied temperature, nullptr if not checkpointing
+	StateCheckpoint* checkpoint;
 
+	/// Guards the command sequence state below
+	std::mutex supplyMutex;
+	/// Temperature the power supply should be set for
+	int pendingTemperature;
+	/// Temperature the running sequence sent the voltage for
+	int appliedTemperature;
+	bool supplySequenceRunning;
+	/// Next step of the running sequence
+	int supplyStep;
+
+	void OpenPort();
 	double CalculateVoltageByTemperature(int temperature); 
+	/// Sends the next command of the voltage and current sequence, returns false once it is done
+	bool SetCurrentAndVoltageStep();
 }; 
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+#include <math.h>
+
+/// Fixed relationship of a follower axis to the master axis it is geared to
+class AxisGearing
+{
+public:
+	AxisGearing() : Enabled(false), Master(1), Ratio(1), Offset(0), Inverted(false)
+	{
+	}
+
+	bool Enabled;
+	/// Engine (1 or 2) the setpoints are given for, the other engine follows it
+	int Master;
+	/// Follower speed per master speed
+	double Ratio;
+	/// Added to the geared speed while the master runs (in pps)
+	int Offset;
+	/// The follower turns opposite to the master
+	bool Inverted;
+
+	/// Follower speed (in pps) for the commanded master speed, the follower stands while the master does
+	int FollowerSpeed(int masterSpeed) const
+	{
+		if (masterSpeed <= 0)
+		{
+			return 0;
+		}
+
+		int speed = (int)lround(masterSpeed * this->Ratio) + this->Offset;
+		return speed > 0 ? speed : 0;
+	}
+
+	int FollowerDirection(int masterDirection) const
+	{
+		return this->Inverted ? 1 - masterDirection : masterDirection;
+	}
+};
+
+/// Velocity profile of one axis, advanced by one step per ramp tick
+class RampAxis
+{
+public:
+	int SlaveNo;
+	int Direction;
+	/// Speed commanded by the previous step (in pps)
+	double Speed;
+	/// Speed change per step (in pps)
+	double Step;
+	/// The first step starts the axis instead of overriding its velocity
+	bool StartsAxis;
+	/// The axis is stopped once all steps were made
+	bool StopsAxis;
+	/// Index of the master axis whose speed this axis is geared to in every step, -1 for an axis with its own profile
+	int FollowsAxis;
+};
+
+/// Speed ramp of one or both engines, executed one step per scheduler tick
+class Ramp
+{
+public:
+	static const int MaxAxes = 2;
+
+	Ramp(int steps) : AxisCount(0), Steps(steps), StepsDone(0)
+	{
+	}
+
+	void AddAxis(int slaveNo, int direction, double speed, double step, bool startsAxis, bool stopsAxis)
+	{
+		RampAxis& axis = this->Axes[this->AxisCount++];
+		axis.SlaveNo = slaveNo;
+		axis.Direction = direction;
+		axis.Speed = speed;
+		axis.Step = step;
+		axis.StartsAxis = startsAxis;
+		axis.StopsAxis = stopsAxis;
+		axis.FollowsAxis = -1;
+	}
+
+	/// Adds an axis following the last added axis through Gearing. Speed is the follower's current speed.
+	void AddFollower(int slaveNo, int direction, double speed, bool stopsAxis)
+	{
+		RampAxis& axis = this->Axes[this->AxisCount];
+		axis.SlaveNo = slaveNo;
+		axis.Direction = direction;
+		axis.Speed = speed;
+		axis.Step = 0;
+		axis.StartsAxis = false;
+		axis.StopsAxis = stopsAxis;
+		axis.FollowsAxis = this->AxisCount - 1;
+		this->AxisCount++;
+	}
+
+	RampAxis Axes[MaxAxes];
+	int AxisCount;
+	/// Derives the speed of following axes from their master
+	AxisGearing Gearing;
+	int Steps;
+	int StepsDone;
+};
@@ -0,0 +1,220 @@
+#include "SensorProtocol.h"
+
+#include <cmath>
+
+namespace
+{
+	void PutUint16(std::vector<unsigned char>& out, unsigned int value)
+	{
+		out.push_back((unsigned char)(value & 0xFF));
+		out.push_back((unsigned char)((value >> 8) & 0xFF));
+	}
+
+	unsigned int GetUint16(const unsigned char* data)
+	{
+		return (unsigned int)data[0] | ((unsigned int)data[1] << 8);
+	}
+}
+
+uint16_t SensorCrc(const unsigned char* data, size_t size)
+{
+	uint16_t crc = 0xFFFF;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		crc ^= (uint16_t)(data[i] << 8);
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+		}
+	}
+
+	return crc;
+}
+
+std::vector<unsigned char> EncodeSensorFrame(unsigned char type, const unsigned char* payload, size_t size)
+{
+	std::vector<unsigned char> raw;
+	raw.reserve(size + 3);
+	raw.push_back(type);
+	raw.insert(raw.end(), payload, payload + size);
+	PutUint16(raw, SensorCrc(raw.data(), raw.size()));
+
+	// COBS: every zero is replaced by the distance to the next one, a code byte leads each run
+	std::vector<unsigned char> encoded;
+	encoded.reserve(raw.size() + raw.size() / 254 + 2);
+
+	size_t codeIndex = encoded.size();
+	encoded.push_back(0);
+	unsigned char code = 1;
+
+	for (auto byte : raw)
+	{
+		if (byte != 0)
+		{
+			encoded.push_back(byte);
+			code++;
+		}
+
+		if (byte == 0 || code == 0xFF)
+		{
+			encoded[codeIndex] = code;
+			codeIndex = encoded.size();
+			encoded.push_back(0);
+			code = 1;
+		}
+	}
+
+	encoded[codeIndex] = code;
+	encoded.push_back(0);
+	return encoded;
+}
+
+std::vector<unsigned char> EncodeSensorReading(SensorReading const& reading)
+{
+	std::vector<unsigned char> payload;
+	payload.push_back((unsigned char)(reading.DeviceTime & 0xFF));
+	payload.push_back((unsigned char)((reading.DeviceTime >> 8) & 0xFF));
+	payload.push_back((unsigned char)((reading.DeviceTime >> 16) & 0xFF));
+	payload.push_back((unsigned char)((reading.DeviceTime >> 24) & 0xFF));
+	payload.push_back(reading.ChannelMask);
+
+	for (int channel = 0; channel < SensorChannelCount; channel++)
+	{
+		if (reading.ChannelMask & (1 << channel))
+		{
+			auto hundredths = (int16_t)std::lround(reading.Temperatures[channel] * 100);
+			PutUint16(payload, (uint16_t)hundredths);
+		}
+	}
+
+	return EncodeSensorFrame(SensorSamples, payload.data(), payload.size());
+}
+
+std::vector<unsigned char> EncodeSetSampleRate(int samplesPerSecond)
+{
+	std::vector<unsigned char> payload;
+	PutUint16(payload, (unsigned int)samplesPerSecond);
+	return EncodeSensorFrame(SensorSetSampleRate, payload.data(), payload.size());
+}
+
+std::vector<unsigned char> EncodeSetChannels(unsigned char channelMask)
+{
+	return EncodeSensorFrame(SensorSetChannels, &channelMask, 1);
+}
+
+bool DecodeSensorReading(SensorFrame const& frame, SensorReading& reading)
+{
+	if (frame.Type != SensorSamples || frame.Size < 5)
+	{
+		return false;
+	}
+
+	reading.DeviceTime = (uint32_t)frame.Payload[0] | ((uint32_t)frame.Payload[1] << 8) | ((uint32_t)frame.Payload[2] << 16) | ((uint32_t)frame.Payload[3] << 24);
+	reading.ChannelMask = frame.Payload[4];
+
+	size_t offset = 5;
+	for (int channel = 0; channel < SensorChannelCount; channel++)
+	{
+		if (!(reading.ChannelMask & (1 << channel)))
+		{
+			continue;
+		}
+
+		if (offset + 2 > frame.Size)
+		{
+			return false;
+		}
+
+		reading.Temperatures[channel] = (int16_t)GetUint16(frame.Payload + offset) / 100.0;
+		offset += 2;
+	}
+
+	return offset == frame.Size;
+}
+
+SensorFrameDecoder::SensorFrameDecoder()
+	: length(0),
+	frames(0),
+	crcErrors(0),
+	framingErrors(0)
+{
+}
+
+unsigned long long SensorFrameDecoder::Frames() const
+{
+	return this->frames;
+}
+
+unsigned long long SensorFrameDecoder::CrcErrors() const
+{
+	return this->crcErrors;
+}
+
+unsigned long long SensorFrameDecoder::FramingErrors() const
+{
+	return this->framingErrors;
+}
+
+bool SensorFrameDecoder::Decode()
+{
+	// Back to back delimiters, e.g. the ones firmware sends to resynchronize after a reset
+	if (this->length == 0)
+	{
+		return false;
+	}
+
+	if (this->length > sizeof(this->encoded))
+	{
+		this->framingErrors++;
+		return false;
+	}
+
+	unsigned char raw[sizeof(this->encoded)];
+	size_t rawLength = 0;
+	size_t i = 0;
+
+	while (i < this->length)
+	{
+		unsigned char code = this->encoded[i++];
+		if (i + code - 1 > this->length)
+		{
+			this->framingErrors++;
+			return false;
+		}
+
+		for (unsigned char j = 1; j < code; j++)
+		{
+			raw[rawLength++] = this->encoded[i++];
+		}
+
+		// The zero implied by the last run is the delimiter itself
+		if (code != 0xFF && i < this->length)
+		{
+			raw[rawLength++] = 0;
+		}
+	}
+
+	// Type and CRC at least
+	if (rawLength < 3 || rawLength - 3 > MaxSensorPayload)
+	{
+		this->framingErrors++;
+		return false;
+	}
+
+	if (SensorCrc(raw, rawLength - 2) != GetUint16(raw + rawLength - 2))
+	{
+		this->crcErrors++;
+		return false;
+	}
+
+	this->frame.Type = raw[0];
+	this->frame.Size = rawLength - 3;
+	for (size_t j = 0; j < this->frame.Size; j++)
+	{
+		this->frame.Payload[j] = raw[j + 1];
+	}
+
+	this->frames++;
+	return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Binary protocol of the Arduino sensor link, used by firmware that supports more than
+// one thermocouple. Older firmware sends one ASCII temperature per line instead.
+//
+// Every frame is COBS encoded and terminated by a zero byte. Decoded, it holds a type byte,
+// the payload and a CRC-16/CCITT-FALSE of type and payload (little endian). Multi-byte
+// fields are little endian.
+//
+// Device to host:
+//   Samples  0x01  u32 device time (us), u8 channel mask, i16 temperature (hundredths of a degree)
+//                  for every channel in the mask, lowest channel first
+//   Ack      0x02  u8 acknowledged command type, u8 status (0 applied, otherwise rejected)
+// Host to device:
+//   SetSampleRate  0x81  u16 samples per second
+//   SetChannels    0x82  u8 channel mask
+
+/// Frame types of the binary sensor protocol
+enum SensorFrameType { SensorSamples = 0x01, SensorAck = 0x02, SensorSetSampleRate = 0x81, SensorSetChannels = 0x82 };
+
+/// Thermocouple channels one samples frame can carry
+const int SensorChannelCount = 8;
+
+/// Largest payload of a frame, a samples frame with all channels fits
+const size_t MaxSensorPayload = 32;
+
+/// Decoded frame, without framing and CRC
+class SensorFrame
+{
+public:
+	unsigned char Type;
+	unsigned char Payload[MaxSensorPayload];
+	size_t Size;
+};
+
+/// Samples of all enabled channels taken at the same moment
+class SensorReading
+{
+public:
+	/// Device clock when the channels were sampled (in us), wraps after about 71 minutes
+	uint32_t DeviceTime;
+	unsigned char ChannelMask;
+	/// Degrees of every channel in ChannelMask
+	double Temperatures[SensorChannelCount];
+};
+
+uint16_t SensorCrc(const unsigned char* data, size_t size);
+
+/// Encodes a frame for the wire, including CRC, COBS and the delimiter
+std::vector<unsigned char> EncodeSensorFrame(unsigned char type, const unsigned char* payload, size_t size);
+std::vector<unsigned char> EncodeSensorReading(SensorReading const& reading);
+std::vector<unsigned char> EncodeSetSampleRate(int samplesPerSecond);
+std::vector<unsigned char> EncodeSetChannels(unsigned char channelMask);
+
+/// Returns false if frame is not a well-formed samples frame
+bool DecodeSensorReading(SensorFrame const& frame, SensorReading& reading);
+
+/// Reassembles frames from the bytes read off the link. Frames that do not decode or fail the
+/// CRC are dropped and counted; the next delimiter resynchronizes the decoder.
+class SensorFrameDecoder
+{
+public:
+	SensorFrameDecoder();
+
+	/// Feeds received bytes and calls onFrame(SensorFrame const&) for every valid frame completed by them
+	template <typename OnFrame>
+	void Feed(const unsigned char* data, size_t size, OnFrame onFrame)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			if (data[i] != 0)
+			{
+				if (this->length < sizeof(this->encoded))
+				{
+					this->encoded[this->length] = data[i];
+				}
+				this->length++;
+				continue;
+			}
+
+			if (this->Decode())
+			{
+				onFrame(this->frame);
+			}
+			this->length = 0;
+		}
+	}
+
+	unsigned long long Frames() const;
+	unsigned long long CrcErrors() const;
+	/// Frames that were too long or not valid COBS
+	unsigned long long FramingErrors() const;
+
+private:
+	/// Largest encoded frame: type, payload, CRC and the COBS overhead
+	unsigned char encoded[MaxSensorPayload + 8];
+	size_t length;
+	SensorFrame frame;
+	unsigned long long frames;
+	unsigned long long crcErrors;
+	unsigned long long framingErrors;
+
+	/// Decodes the bytes collected since the last delimiter into frame
+	bool Decode();
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include <chrono>
+
+#include "SpscRing.h"
+
+/// Single decoded reading received from a device serial link
+class SensorSample
+{
+public:
+	/// Moment the reading was taken off the serial link
+	std::chrono::steady_clock::time_point Timestamp;
+	/// Reading as reported by the device, null terminated
+	char Value[32];
+	/// Thermocouple the reading is from, always 0 for ASCII firmware
+	int Channel;
+	/// Device clock when the reading was taken (in us), -1 for ASCII firmware which sends none
+	long long DeviceTime;
+};
+
+/// Queue between a device reader thread and the websocket writer
+typedef SpscRing<SensorSample, 1024> SensorRing;
@@ -0,0 +1,132 @@
+#include "SharedMemoryInterface.h"
+#include "Tracer.h"
+
+#include <new>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <spdlog/spdlog.h>
+
+namespace ipc = boost::interprocess;
+
+namespace
+{
+	/// How often the serving threads look at the running flag while idle
+	const int IdleWaitMs = 100;
+
+	bool WaitFor(ipc::interprocess_semaphore& semaphore)
+	{
+		return semaphore.timed_wait(boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(IdleWaitMs));
+	}
+}
+
+SharedMemoryInterface::SharedMemoryInterface(std::string name, EnginesController* enginesController, PowerController* powerController, HardwareStateStore* stateStore)
+	: name(name),
+	enginesController(enginesController),
+	stateStore(stateStore),
+	updateHandler(enginesController, powerController, stateStore),
+	block(nullptr),
+	subscriptionId(0),
+	running(true)
+{
+	// A block left behind by a crashed controller may have stale semaphores
+	ipc::shared_memory_object::remove(this->name.c_str());
+
+	this->memory = ipc::shared_memory_object(ipc::create_only, this->name.c_str(), ipc::read_write);
+	this->memory.truncate(sizeof(SharedControlBlock));
+	this->region = ipc::mapped_region(this->memory, ipc::read_write);
+	this->block = new (this->region.get_address()) SharedControlBlock();
+
+	this->Publish(*this->stateStore->Current());
+	this->subscriptionId = this->stateStore->Subscribe([this](HardwareSnapshot const& snapshot) { this->Publish(snapshot); });
+
+	this->commandThread = std::thread(&SharedMemoryInterface::HandleCommands, this);
+	this->stopThread = std::thread(&SharedMemoryInterface::HandleStops, this);
+
+	spdlog::info("Shared memory :: Serving {} ({} bytes, layout version {})", this->name, sizeof(SharedControlBlock), SharedMemoryLayoutVersion);
+}
+
+SharedMemoryInterface::~SharedMemoryInterface()
+{
+	this->running = false;
+	this->commandThread.join();
+	this->stopThread.join();
+
+	this->stateStore->Unsubscribe(this->subscriptionId);
+	this->block->~SharedControlBlock();
+	ipc::shared_memory_object::remove(this->name.c_str());
+}
+
+void SharedMemoryInterface::HandleCommands()
+{
+	SetTraceThreadName("shared memory commands");
+	SharedCommand batch[16];
+
+	while (this->running)
+	{
+		if (!WaitFor(this->block->CommandsPosted))
+		{
+			continue;
+		}
+
+		auto count = this->block->Commands.PopBatch(batch, sizeof(batch) / sizeof(batch[0]));
+		for (size_t i = 0; i < count; i++)
+		{
+			auto const& command = batch[i];
+
+			// The generation is taken first, so a stop requested after the check below still preempts the update
+			auto stopGeneration = this->enginesController->StopGeneration();
+			if (command.StopRequestsSeen != this->block->StopRequests.load(std::memory_order_acquire))
+			{
+				spdlog::warn("Shared memory :: Discarded update queued before a stop request.");
+				continue;
+			}
+
+			auto update = HardwareState();
+			update.Engine1Speed = command.Engine1Speed;
+			update.Engine2Speed = command.Engine2Speed;
+			update.Engine1Direction = command.Engine1Direction;
+			update.Engine2Direction = command.Engine2Direction;
+			update.DesiredTemperature = command.DesiredTemperature;
+			update.Fields = HardwareState::AllFields;
+
+			try
+			{
+				this->updateHandler.Apply(update, stopGeneration);
+			}
+			catch (std::exception const& e)
+			{
+				spdlog::error("Shared memory :: Error while applying update: {}", e.what());
+			}
+		}
+	}
+}
+
+void SharedMemoryInterface::HandleStops()
+{
+	SetTraceThreadName("shared memory stops");
+
+	while (this->running)
+	{
+		if (WaitFor(this->block->StopPosted))
+		{
+			this->enginesController->EmergencyStop(false, std::chrono::steady_clock::now());
+		}
+	}
+}
+
+void SharedMemoryInterface::Publish(HardwareSnapshot const& snapshot)
+{
+	SharedTelemetry telemetry;
+	telemetry.Version = snapshot.Version;
+	telemetry.Engine1Speed = snapshot.Engine1Speed.Value;
+	telemetry.Engine2Speed = snapshot.Engine2Speed.Value;
+	telemetry.Engine1Direction = snapshot.Engine1Direction.Value;
+	telemetry.Engine2Direction = snapshot.Engine2Direction.Value;
+	telemetry.Engine1ActualSpeed = snapshot.Engine1ActualSpeed.Value;
+	telemetry.Engine2ActualSpeed = snapshot.Engine2ActualSpeed.Value;
+	telemetry.Alarms = snapshot.Alarms.Value;
+	telemetry.DesiredTemperature = snapshot.DesiredTemperature.Value;
+	telemetry.CurrentTemperature = snapshot.CurrentTemperature.Value;
+	telemetry.SupplyVoltage = snapshot.SupplyVoltage.Value;
+
+	this->block->PublishTelemetry(telemetry);
+}
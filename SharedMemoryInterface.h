@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include "EnginesController.h"
+#include "HardwareStateStore.h"
+#include "PowerController.h"
+#include "SharedMemoryLayout.h"
+#include "UpdateHandler.h"
+
+/// Serves the shared-memory command ring and publishes the hardware state to the
+/// shared telemetry block, for clients running on the same machine
+class SharedMemoryInterface
+{
+public:
+	SharedMemoryInterface(std::string name, EnginesController* enginesController, PowerController* powerController, HardwareStateStore* stateStore);
+	~SharedMemoryInterface();
+
+	SharedMemoryInterface(const SharedMemoryInterface&) = delete;
+	SharedMemoryInterface& operator=(const SharedMemoryInterface&) = delete;
+
+private:
+	std::string name;
+	EnginesController* enginesController;
+	HardwareStateStore* stateStore;
+	UpdateHandler updateHandler;
+
+	boost::interprocess::shared_memory_object memory;
+	boost::interprocess::mapped_region region;
+	SharedControlBlock* block;
+
+	int subscriptionId;
+	std::atomic<bool> running;
+	std::thread commandThread;
+	std::thread stopThread;
+
+	void HandleCommands();
+	void HandleStops();
+	void Publish(HardwareSnapshot const& snapshot);
+};
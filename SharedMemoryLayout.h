@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <boost/interprocess/sync/interprocess_semaphore.hpp>
+
+#include "HardwareState.h"
+#include "SpscRing.h"
+
+// Layout of the shared-memory block through which co-located processes command
+// the controller and read its state. Clients include this header, open the
+// shared memory object named in config.txt and use the client methods below.
+// Both sides must be built for the same architecture.
+
+/// Incremented on every incompatible change of the layout
+const uint32_t SharedMemoryLayoutVersion = 1;
+
+/// Update placed in the command ring by a client
+class SharedCommand
+{
+public:
+	/// Value of StopRequests when the command was pushed, commands older than a stop are discarded
+	uint32_t StopRequestsSeen;
+	int32_t Engine1Speed;
+	int32_t Engine2Speed;
+	int32_t Engine1Direction;
+	int32_t Engine2Direction;
+	int32_t DesiredTemperature;
+};
+
+/// Hardware state published by the controller on every change
+class SharedTelemetry
+{
+public:
+	uint64_t Version;
+	int32_t Engine1Speed;
+	int32_t Engine2Speed;
+	int32_t Engine1Direction;
+	int32_t Engine2Direction;
+	int32_t Engine1ActualSpeed;
+	int32_t Engine2ActualSpeed;
+	int32_t Alarms;
+	int32_t DesiredTemperature;
+	double CurrentTemperature;
+	double SupplyVoltage;
+};
+
+class SharedControlBlock
+{
+public:
+	SharedControlBlock() : LayoutVersion(SharedMemoryLayoutVersion), CommandsPosted(0), StopPosted(0), StopRequests(0), TelemetrySequence(0), Telemetry()
+	{
+	}
+
+	/// Client side: queues an update, returns false if the ring is full
+	bool PushUpdate(HardwareState const& update)
+	{
+		SharedCommand command;
+		command.StopRequestsSeen = this->StopRequests.load(std::memory_order_acquire);
+		command.Engine1Speed = update.Engine1Speed;
+		command.Engine2Speed = update.Engine2Speed;
+		command.Engine1Direction = update.Engine1Direction;
+		command.Engine2Direction = update.Engine2Direction;
+		command.DesiredTemperature = update.DesiredTemperature;
+
+		if (!this->Commands.Push(command))
+		{
+			return false;
+		}
+
+		this->CommandsPosted.post();
+		return true;
+	}
+
+	/// Client side: stops the engines and discards every update queued so far
+	void RequestStop()
+	{
+		this->StopRequests.fetch_add(1, std::memory_order_acq_rel);
+		this->StopPosted.post();
+	}
+
+	/// Client side: consistent copy of the latest published state
+	SharedTelemetry ReadTelemetry() const
+	{
+		SharedTelemetry telemetry;
+		uint32_t before;
+		uint32_t after;
+
+		do
+		{
+			before = this->TelemetrySequence.load(std::memory_order_acquire);
+			telemetry = this->Telemetry;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = this->TelemetrySequence.load(std::memory_order_relaxed);
+		} while ((before & 1) != 0 || before != after);
+
+		return telemetry;
+	}
+
+	/// Controller side: single writer of the telemetry block
+	void PublishTelemetry(SharedTelemetry const& telemetry)
+	{
+		auto sequence = this->TelemetrySequence.load(std::memory_order_relaxed);
+
+		// An odd sequence tells readers a write is in progress
+		this->TelemetrySequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		this->Telemetry = telemetry;
+		this->TelemetrySequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	const uint32_t LayoutVersion;
+	boost::interprocess::interprocess_semaphore CommandsPosted;
+	boost::interprocess::interprocess_semaphore StopPosted;
+	std::atomic<uint32_t> StopRequests;
+	SpscRing<SharedCommand, 64> Commands;
+	std::atomic<uint32_t> TelemetrySequence;
+	SharedTelemetry Telemetry;
+};
@@ -0,0 +1,173 @@
+#ifdef WDS_SIMULATED_HARDWARE
+
+#include "SimulatedDriver.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace
+{
+	const int MaxSlaves = 16;
+
+	/// State of a single simulated axis
+	class SimulatedAxis
+	{
+	public:
+		bool Enabled;
+		bool Moving;
+		long Velocity;
+		int Direction;
+	};
+
+	std::mutex driverMutex;
+	bool portOpen = false;
+	SimulatedAxis axes[MaxSlaves];
+	std::atomic<long long> latencyUs(0);
+	std::atomic<unsigned long long> callCount(0);
+
+	/// Accounts for the call and holds the caller for the configured bus latency
+	void BusRoundTrip()
+	{
+		callCount.fetch_add(1, std::memory_order_relaxed);
+
+		auto latency = std::chrono::microseconds(latencyUs.load(std::memory_order_relaxed));
+		if (latency.count() == 0)
+		{
+			return;
+		}
+
+		// Busy wait, sleeping would round up to the scheduler tick
+		auto until = std::chrono::steady_clock::now() + latency;
+		while (std::chrono::steady_clock::now() < until)
+		{
+		}
+	}
+
+	int CheckSlave(BYTE iSlaveNo)
+	{
+		if (!portOpen)
+		{
+			return FMM_NOT_OPEN;
+		}
+
+		return iSlaveNo < MaxSlaves ? FMM_OK : FMM_INVALID_SLAVE_NUM;
+	}
+}
+
+BOOL FAS_Connect(BYTE nPortNo, DWORD dwBaud)
+{
+	BusRoundTrip();
+	std::lock_guard<std::mutex> lock(driverMutex);
+	portOpen = true;
+	return TRUE;
+}
+
+void FAS_Close(BYTE nPortNo)
+{
+	BusRoundTrip();
+	std::lock_guard<std::mutex> lock(driverMutex);
+	portOpen = false;
+}
+
+BOOL FAS_IsSlaveExist(BYTE nPortNo, BYTE iSlaveNo)
+{
+	BusRoundTrip();
+	std::lock_guard<std::mutex> lock(driverMutex);
+	return CheckSlave(iSlaveNo) == FMM_OK;
+}
+
+int FAS_ServoEnable(BYTE nPortNo, BYTE iSlaveNo, BOOL bOnOff)
+{
+	BusRoundTrip();
+	std::lock_guard<std::mutex> lock(driverMutex);
+
+	auto result = CheckSlave(iSlaveNo);
+	if (result == FMM_OK)
+	{
+		axes[iSlaveNo].Enabled = bOnOff != FALSE;
+	}
+
+	return result;
+}
+
+int FAS_MoveStop(BYTE nPortNo, BYTE iSlaveNo)
+{
+	BusRoundTrip();
+	std::lock_guard<std::mutex> lock(driverMutex);
+
+	auto result = CheckSlave(iSlaveNo);
+	if (result == FMM_OK)
+	{
+		axes[iSlaveNo].Moving = false;
+		axes[iSlaveNo].Velocity = 0;
+	}
+
+	return result;
+}
+
+int FAS_EmergencyStop(BYTE nPortNo, BYTE iSlaveNo)
+{
+	return FAS_MoveStop(nPortNo, iSlaveNo);
+}
+
+int FAS_MoveVelocity(BYTE nPortNo, BYTE iSlaveNo, DWORD lVelocity, int iVelDir)
+{
+	BusRoundTrip();
+	std::lock_guard<std::mutex> lock(driverMutex);
+
+	auto result = CheckSlave(iSlaveNo);
+	if (result == FMM_OK && axes[iSlaveNo].Enabled)
+	{
+		axes[iSlaveNo].Moving = true;
+		axes[iSlaveNo].Velocity = (long)lVelocity;
+		axes[iSlaveNo].Direction = iVelDir;
+	}
+
+	return result;
+}
+
+int FAS_VelocityOverride(BYTE nPortNo, BYTE iSlaveNo, DWORD lVelocity)
+{
+	BusRoundTrip();
+	std::lock_guard<std::mutex> lock(driverMutex);
+
+	auto result = CheckSlave(iSlaveNo);
+	if (result == FMM_OK && axes[iSlaveNo].Moving)
+	{
+		axes[iSlaveNo].Velocity = (long)lVelocity;
+	}
+
+	return result;
+}
+
+int FAS_GetActualVel(BYTE nPortNo, BYTE iSlaveNo, long* lActVel)
+{
+	BusRoundTrip();
+	std::lock_guard<std::mutex> lock(driverMutex);
+
+	auto result = CheckSlave(iSlaveNo);
+	*lActVel = result == FMM_OK ? axes[iSlaveNo].Velocity : 0;
+	return result;
+}
+
+int FAS_GetAxisStatus(BYTE nPortNo, BYTE iSlaveNo, DWORD* dwAxisStatus)
+{
+	BusRoundTrip();
+	std::lock_guard<std::mutex> lock(driverMutex);
+
+	// Simulated drives never raise alarms
+	*dwAxisStatus = 0;
+	return CheckSlave(iSlaveNo);
+}
+
+void SimulatedDriverSetLatency(std::chrono::microseconds latency)
+{
+	latencyUs.store(latency.count());
+}
+
+unsigned long long SimulatedDriverCallCount()
+{
+	return callCount.load();
+}
+
+#endif
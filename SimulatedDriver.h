@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+
+// In-process stand-in for the Fastech Ezi-SERVO Plus-R library, used when the
+// controller is built with WDS_SIMULATED_HARDWARE (benchmarks, soak tests).
+// Only the functions used by EnginesController are provided.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned long DWORD;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+#endif
+
+#define FMM_OK 0
+#define FMM_NOT_OPEN 1
+#define FMM_INVALID_SLAVE_NUM 3
+
+BOOL FAS_Connect(BYTE nPortNo, DWORD dwBaud);
+void FAS_Close(BYTE nPortNo);
+BOOL FAS_IsSlaveExist(BYTE nPortNo, BYTE iSlaveNo);
+int FAS_ServoEnable(BYTE nPortNo, BYTE iSlaveNo, BOOL bOnOff);
+int FAS_MoveStop(BYTE nPortNo, BYTE iSlaveNo);
+int FAS_EmergencyStop(BYTE nPortNo, BYTE iSlaveNo);
+int FAS_MoveVelocity(BYTE nPortNo, BYTE iSlaveNo, DWORD lVelocity, int iVelDir);
+int FAS_VelocityOverride(BYTE nPortNo, BYTE iSlaveNo, DWORD lVelocity);
+int FAS_GetActualVel(BYTE nPortNo, BYTE iSlaveNo, long* lActVel);
+int FAS_GetAxisStatus(BYTE nPortNo, BYTE iSlaveNo, DWORD* dwAxisStatus);
+
+/// Time every simulated driver call takes, mimicking the serial bus round trip
+void SimulatedDriverSetLatency(std::chrono::microseconds latency);
+/// Number of driver calls made since start
+unsigned long long SimulatedDriverCallCount();
@@ -0,0 +1,721 @@
+#include "SoakHarness.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include "ClockSync.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <dirent.h>
+#endif
+
+namespace beast = boost::beast;
+namespace net = boost::asio;
+namespace websocket = beast::websocket;
+using tcp = net::ip::tcp;
+
+ProcessMetrics ProcessMetrics::Sample()
+{
+	ProcessMetrics metrics;
+	metrics.ResidentBytes = 0;
+	metrics.Threads = 0;
+	metrics.Handles = 0;
+
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS memory;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+	{
+		metrics.ResidentBytes = memory.WorkingSetSize;
+	}
+
+	DWORD handles = 0;
+	if (GetProcessHandleCount(GetCurrentProcess(), &handles))
+	{
+		metrics.Handles = (int)handles;
+	}
+
+	HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+	if (snapshot != INVALID_HANDLE_VALUE)
+	{
+		THREADENTRY32 thread;
+		thread.dwSize = sizeof(thread);
+		for (BOOL found = Thread32First(snapshot, &thread); found; found = Thread32Next(snapshot, &thread))
+		{
+			if (thread.th32OwnerProcessID == GetCurrentProcessId())
+			{
+				metrics.Threads++;
+			}
+		}
+		CloseHandle(snapshot);
+	}
+#else
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, 6, "VmRSS:") == 0)
+		{
+			metrics.ResidentBytes = std::stoul(line.substr(6)) * 1024;
+		}
+		else if (line.compare(0, 8, "Threads:") == 0)
+		{
+			metrics.Threads = std::stoi(line.substr(8));
+		}
+	}
+
+	if (DIR* descriptors = opendir("/proc/self/fd"))
+	{
+		while (dirent* entry = readdir(descriptors))
+		{
+			if (entry->d_name[0] != '.')
+			{
+				metrics.Handles++;
+			}
+		}
+		closedir(descriptors);
+
+		// The directory stream itself was one of them
+		metrics.Handles--;
+	}
+#endif
+
+	return metrics;
+}
+
+namespace
+{
+	/// Share of requests of each kind, out of TrafficCycle messages
+	const unsigned long TrafficCycle = 50;
+	const unsigned long UpdatesPerCycle = 15;
+	const unsigned long StopsPerCycle = 1;
+	const unsigned long HistoryQueriesPerCycle = 1;
+
+	const int Speeds[] = { 0, 2000, 5000, 12500 };
+	const int Temperatures[] = { 0, 40, 80, 120 };
+
+	struct Percentiles
+	{
+		size_t Count;
+		long long P50;
+		long long P99;
+	};
+
+	Percentiles ComputePercentiles(std::vector<long long> samples)
+	{
+		Percentiles result = { samples.size(), 0, 0 };
+		if (samples.empty())
+		{
+			return result;
+		}
+
+		std::sort(samples.begin(), samples.end());
+		result.P50 = samples[samples.size() / 2];
+		result.P99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+		return result;
+	}
+
+	/// Adds an X509v3 extension given in its configuration syntax, e.g. "IP:127.0.0.1"
+	void AddExtension(X509* certificate, int nid, const char* value)
+	{
+		X509V3_CTX context;
+		X509V3_set_ctx_nodb(&context);
+		X509V3_set_ctx(&context, certificate, certificate, nullptr, nullptr, 0);
+
+		X509_EXTENSION* extension = X509V3_EXT_conf_nid(nullptr, &context, nid, value);
+		if (extension == nullptr || X509_add_ext(certificate, extension, -1) != 1)
+		{
+			X509_EXTENSION_free(extension);
+			throw std::runtime_error(std::string("Stand-in certificate extension ") + value + " could not be added");
+		}
+		X509_EXTENSION_free(extension);
+	}
+
+	/// Creates a self-signed P-256 certificate for 127.0.0.1 and localhost, installs it with its key
+	/// on context and writes the certificate to certificateFile
+	void CreateCertificate(SSL_CTX* context, std::string const& certificateFile)
+	{
+		std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> keyContext(EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), &EVP_PKEY_CTX_free);
+		EVP_PKEY* generated = nullptr;
+		if (!keyContext || EVP_PKEY_keygen_init(keyContext.get()) != 1 ||
+			EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyContext.get(), NID_X9_62_prime256v1) != 1 ||
+			EVP_PKEY_keygen(keyContext.get(), &generated) != 1)
+		{
+			throw std::runtime_error("Stand-in key could not be generated");
+		}
+		std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(generated, &EVP_PKEY_free);
+
+		std::unique_ptr<X509, decltype(&X509_free)> certificate(X509_new(), &X509_free);
+		X509_set_version(certificate.get(), 2);
+		ASN1_INTEGER_set(X509_get_serialNumber(certificate.get()), 1);
+		X509_gmtime_adj(X509_getm_notBefore(certificate.get()), -3600);
+		X509_gmtime_adj(X509_getm_notAfter(certificate.get()), 30L * 24 * 3600);
+		X509_set_pubkey(certificate.get(), key.get());
+
+		auto name = X509_get_subject_name(certificate.get());
+		X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+		X509_set_issuer_name(certificate.get(), name);
+
+		// The rigs verify the host they connect to, and trust the certificate itself as their CA
+		AddExtension(certificate.get(), NID_subject_alt_name, "IP:127.0.0.1,DNS:localhost");
+		AddExtension(certificate.get(), NID_basic_constraints, "critical,CA:TRUE");
+
+		if (X509_sign(certificate.get(), key.get(), EVP_sha256()) == 0 ||
+			SSL_CTX_use_certificate(context, certificate.get()) != 1 ||
+			SSL_CTX_use_PrivateKey(context, key.get()) != 1)
+		{
+			throw std::runtime_error("Stand-in certificate could not be created");
+		}
+
+		std::unique_ptr<BIO, decltype(&BIO_free)> file(BIO_new_file(certificateFile.c_str(), "w"), &BIO_free);
+		if (!file || PEM_write_bio_X509(file.get(), certificate.get()) != 1)
+		{
+			throw std::runtime_error("Stand-in certificate could not be written to " + certificateFile);
+		}
+	}
+}
+
+/// One connection of a rig to the stand-in. Runs entirely on the stand-in's I/O thread.
+class SoakHarness::Session : public std::enable_shared_from_this<SoakHarness::Session>
+{
+public:
+	/// Serves the session over TLS if sslContext is set
+	Session(tcp::socket socket, net::ssl::context* sslContext, SoakHarness* harness, SoakSettings const& settings, bool dropAbruptly)
+		: trafficTimer(socket.get_executor()),
+		reconnectTimer(socket.get_executor()),
+		harness(harness),
+		messageInterval(settings.MessageInterval),
+		reconnectInterval(settings.ReconnectInterval),
+		dropAbruptly(dropAbruptly),
+		messagesSent(0),
+		writing(false),
+		closing(false)
+	{
+		if (sslContext != nullptr)
+		{
+			this->secure.reset(new SecureStream(std::move(socket), *sslContext));
+		}
+		else
+		{
+			this->plain.reset(new PlainStream(std::move(socket)));
+		}
+	}
+
+	void Start()
+	{
+		if (!this->secure)
+		{
+			this->Accept();
+			return;
+		}
+
+		auto self = this->shared_from_this();
+		this->secure->next_layer().async_handshake(net::ssl::stream_base::server, [self](beast::error_code ec)
+		{
+			if (ec)
+			{
+				spdlog::warn("Soak :: TLS handshake failed: {}", ec.message());
+				return;
+			}
+
+			self->harness->RecordTlsHandshake(SSL_session_reused(self->secure->next_layer().native_handle()) == 1);
+			self->Accept();
+		});
+	}
+
+	/// Ends the session, safe to call from any thread
+	void Close()
+	{
+		auto self = this->shared_from_this();
+		net::post(this->trafficTimer.get_executor(), [self] { self->Drop(false); });
+	}
+
+private:
+	typedef websocket::stream<tcp::socket> PlainStream;
+	typedef websocket::stream<beast::ssl_stream<tcp::socket>> SecureStream;
+
+	/// One of them is set, depending on whether the stand-in serves TLS
+	std::unique_ptr<PlainStream> plain;
+	std::unique_ptr<SecureStream> secure;
+	net::steady_timer trafficTimer;
+	net::steady_timer reconnectTimer;
+	SoakHarness* harness;
+	std::chrono::milliseconds messageInterval;
+	std::chrono::seconds reconnectInterval;
+	/// Half of the forced reconnects close the websocket properly, the others just drop the connection
+	bool dropAbruptly;
+
+	beast::flat_buffer buffer;
+	std::deque<std::string> outbound;
+	unsigned long messagesSent;
+	bool writing;
+	bool closing;
+	/// Send time of requests still waiting for their final status
+	std::unordered_map<unsigned long long, std::chrono::steady_clock::time_point> pending;
+
+	/// Calls operation with the websocket stream of the session
+	template <class Operation>
+	void WithStream(Operation&& operation)
+	{
+		if (this->secure)
+		{
+			operation(*this->secure);
+		}
+		else
+		{
+			operation(*this->plain);
+		}
+	}
+
+	void Accept()
+	{
+		auto self = this->shared_from_this();
+		this->WithStream([self](auto& ws)
+		{
+			// Lets the controller batch its replies, like the production server does
+			ws.set_option(websocket::stream_base::decorator([](websocket::response_type& response)
+			{
+				response.set("X-Wds-Batching", "1");
+			}));
+
+			ws.async_accept([self](beast::error_code ec)
+			{
+				if (ec)
+				{
+					spdlog::warn("Soak :: Websocket handshake failed: {}", ec.message());
+					return;
+				}
+	
+				self->Send(self->Request(R"({"type":"command","command":"connect")"));
+				self->Send(R"({"type":"subscribe","keyframeInterval":1000,"fields":{"engine1ActualSpeed":100,"engine2ActualSpeed":100,"currentTemperature":250}})");
+				self->ScheduleTraffic();
+				self->ScheduleReconnect();
+				self->Read();
+			});
+		});
+	}
+
+	std::string Request(std::string const& message)
+	{
+		auto id = this->harness->NextRequestId();
+		this->pending[id] = std::chrono::steady_clock::now();
+
+		// Inserts the id before the closing brace
+		return message + ",\"id\":" + std::to_string(id) + "}";
+	}
+
+	std::string NextMessage()
+	{
+		auto slot = this->messagesSent++ % TrafficCycle;
+
+		if (slot < StopsPerCycle)
+		{
+			return this->Request(R"({"type":"command","command":"stop")");
+		}
+
+		if (slot < StopsPerCycle + UpdatesPerCycle)
+		{
+			auto speed1 = Speeds[this->messagesSent % 4];
+			auto speed2 = Speeds[(this->messagesSent / 4) % 4];
+			auto temperature = Temperatures[(this->messagesSent / 16) % 4];
+
+			return this->Request("{\"type\":\"update\",\"desiredTemperature\":\"" + std::to_string(temperature) +
+				"\",\"engine1Direction\":\"1\",\"engine1Speed\":\"" + std::to_string(speed1) +
+				"\",\"engine2Direction\":\"0\",\"engine2Speed\":\"" + std::to_string(speed2) + "\"");
+		}
+
+		// Backfills the last minute like a reconnecting dashboard
+		if (slot < StopsPerCycle + UpdatesPerCycle + HistoryQueriesPerCycle)
+		{
+			return this->Request("{\"type\":\"history\",\"fields\":[\"currentTemperature\",\"engine1ActualSpeed\"],\"decimation\":2,\"from\":" + std::to_string(MonotonicMicroseconds() - 60000000));
+		}
+
+		return this->Request(R"({"type":"status")");
+	}
+
+	void ScheduleTraffic()
+	{
+		auto self = this->shared_from_this();
+		this->trafficTimer.expires_after(this->messageInterval);
+		this->trafficTimer.async_wait([self](beast::error_code ec)
+		{
+			if (ec || self->closing)
+			{
+				return;
+			}
+
+			self->Send(self->NextMessage());
+			self->ScheduleTraffic();
+		});
+	}
+
+	void ScheduleReconnect()
+	{
+		auto self = this->shared_from_this();
+		this->reconnectTimer.expires_after(this->reconnectInterval);
+		this->reconnectTimer.async_wait([self](beast::error_code ec)
+		{
+			if (!ec)
+			{
+				self->Drop(self->dropAbruptly);
+			}
+		});
+	}
+
+	void Send(std::string message)
+	{
+		this->outbound.push_back(std::move(message));
+		this->WriteNext();
+	}
+
+	void WriteNext()
+	{
+		if (this->writing || this->closing || this->outbound.empty())
+		{
+			return;
+		}
+
+		this->writing = true;
+		auto self = this->shared_from_this();
+		this->WithStream([self](auto& ws)
+		{
+			ws.async_write(net::buffer(self->outbound.front()), [self](beast::error_code ec, std::size_t)
+			{
+				self->writing = false;
+				self->outbound.pop_front();
+
+				if (!ec)
+				{
+					self->WriteNext();
+				}
+			});
+		});
+	}
+
+	void Read()
+	{
+		auto self = this->shared_from_this();
+		this->WithStream([self](auto& ws)
+		{
+			ws.async_read(self->buffer, [self](beast::error_code ec, std::size_t)
+			{
+				if (ec)
+				{
+					self->closing = true;
+					self->trafficTimer.cancel();
+					self->reconnectTimer.cancel();
+					return;
+				}
+
+				self->OnMessage(beast::buffers_to_string(self->buffer.data()));
+				self->buffer.consume(self->buffer.size());
+				self->Read();
+			});
+		});
+	}
+
+	void OnMessage(std::string const& message)
+	{
+		auto now = std::chrono::steady_clock::now();
+		auto json = nlohmann::json::parse(message, nullptr, false);
+		if (json.is_discarded())
+		{
+			spdlog::warn("Soak :: Controller sent malformed message {}", message);
+			return;
+		}
+
+		// Batched replies arrive as arrays
+		auto replies = json.is_array() ? json : nlohmann::json::array({ json });
+		for (auto const& reply : replies)
+		{
+			if (reply.is_object() && reply.value("type", "") == "time" && !reply.contains("t1"))
+			{
+				// Answered like a server would, the writer's sentAt is the request time
+				auto receivedAt = MonotonicMicroseconds(now);
+				this->Send("{\"type\":\"time\",\"t0\":" + std::to_string(reply.value("sentAt", 0ll)) + ",\"t1\":" + std::to_string(receivedAt) + ",\"t2\":" + std::to_string(MonotonicMicroseconds()) + "}");
+				continue;
+			}
+
+			// The stand-in shares the controller's clock, an offset beyond the round trip means the estimate is off
+			if (reply.is_object() && reply.value("type", "") == "clock" && std::abs(reply.value("offsetUs", 0ll)) > std::max(reply.value("delayUs", 0ll), 1000ll))
+			{
+				spdlog::warn("Soak :: Controller estimates a clock offset of {} us with a round trip of {} us", reply.value("offsetUs", 0ll), reply.value("delayUs", 0ll));
+			}
+
+			if (!reply.is_object() || reply.value("type", "") != "request" || !reply.contains("id") || !reply["id"].is_number_unsigned())
+			{
+				continue;
+			}
+
+			if (reply.value("status", "") == "accepted")
+			{
+				continue;
+			}
+
+			auto request = this->pending.find(reply["id"].get<unsigned long long>());
+			if (request != this->pending.end())
+			{
+				this->harness->RecordLatency(std::chrono::duration_cast<std::chrono::microseconds>(now - request->second));
+				this->pending.erase(request);
+			}
+		}
+	}
+
+	void Drop(bool abruptly)
+	{
+		if (this->closing)
+		{
+			return;
+		}
+
+		this->closing = true;
+		this->trafficTimer.cancel();
+		this->reconnectTimer.cancel();
+
+		auto self = this->shared_from_this();
+		this->WithStream([self, abruptly](auto& ws)
+		{
+			if (abruptly)
+			{
+				beast::error_code ec;
+				beast::get_lowest_layer(ws).close(ec);
+				return;
+			}
+
+			ws.async_close(websocket::close_code::going_away, [self](beast::error_code) {});
+		});
+	}
+};
+
+SoakHarness::SoakHarness(SoakSettings const& settings)
+	: settings(settings),
+	acceptor(ioc),
+	requestId(0),
+	sessionsServed(0),
+	tlsHandshakes(0),
+	tlsResumptions(0)
+{
+}
+
+SoakHarness::~SoakHarness()
+{
+	this->Close();
+}
+
+void SoakHarness::Start()
+{
+	if (this->settings.Tls)
+	{
+		this->sslContext.reset(new net::ssl::context(net::ssl::context::tls_server));
+		SSL_CTX_set_min_proto_version(this->sslContext->native_handle(), TLS1_2_VERSION);
+		CreateCertificate(this->sslContext->native_handle(), this->settings.CertificateFile);
+	}
+
+	tcp::endpoint endpoint(net::ip::make_address("127.0.0.1"), (unsigned short)this->settings.Port);
+	this->acceptor.open(endpoint.protocol());
+	this->acceptor.set_option(net::socket_base::reuse_address(true));
+	this->acceptor.bind(endpoint);
+	this->acceptor.listen();
+
+	this->Accept();
+	this->ioThread = std::thread([this] { this->ioc.run(); });
+
+	spdlog::info("Soak :: Websocket stand-in listening on 127.0.0.1:{}{}, sessions are dropped every {} s", this->settings.Port, this->sslContext ? " over TLS" : "", this->settings.ReconnectInterval.count());
+}
+
+void SoakHarness::Accept()
+{
+	this->acceptor.async_accept([this](beast::error_code ec, tcp::socket socket)
+	{
+		if (ec)
+		{
+			return;
+		}
+
+		auto session = std::make_shared<Session>(std::move(socket), this->sslContext.get(), this, this->settings, this->sessionsServed++ % 2 == 1);
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->sessions.erase(std::remove_if(this->sessions.begin(), this->sessions.end(), [](std::weak_ptr<Session> const& existing) { return existing.expired(); }), this->sessions.end());
+			this->sessions.push_back(session);
+		}
+
+		session->Start();
+		this->Accept();
+	});
+}
+
+bool SoakHarness::Run()
+{
+	std::ofstream samples;
+	if (!this->settings.SamplesPath.empty())
+	{
+		samples.open(this->settings.SamplesPath, std::ios::out | std::ios::trunc);
+		samples << "elapsed_s,resident_bytes,threads,handles,sessions,requests,p50_us,p99_us\n";
+	}
+
+	auto started = std::chrono::steady_clock::now();
+	auto nextSample = started + this->settings.SampleInterval;
+	bool hasBaseline = false;
+	bool hasLatencyBaseline = false;
+	ProcessMetrics baseline = ProcessMetrics();
+	long long baselineP99 = 0;
+	bool passed = true;
+
+	spdlog::info("Soak :: Running for {} s, baseline after {} s, sampling every {} s", this->settings.Duration.count(), this->settings.Warmup.count(), this->settings.SampleInterval.count());
+
+	while (passed && std::chrono::steady_clock::now() - started < this->settings.Duration)
+	{
+		std::this_thread::sleep_until(nextSample);
+		nextSample += this->settings.SampleInterval;
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - started);
+		auto metrics = ProcessMetrics::Sample();
+
+		std::vector<long long> window;
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			window.swap(this->latencies);
+		}
+		auto latency = ComputePercentiles(window);
+
+		spdlog::info("Soak :: {} s rss {} KB threads {} handles {} sessions {} requests {} p50 {} us p99 {} us",
+			elapsed.count(), metrics.ResidentBytes / 1024, metrics.Threads, metrics.Handles, this->sessionsServed.load(), latency.Count, latency.P50, latency.P99);
+
+		if (samples.is_open())
+		{
+			samples << elapsed.count() << "," << metrics.ResidentBytes << "," << metrics.Threads << "," << metrics.Handles << ","
+				<< this->sessionsServed.load() << "," << latency.Count << "," << latency.P50 << "," << latency.P99 << std::endl;
+		}
+
+		if (elapsed < this->settings.Warmup)
+		{
+			continue;
+		}
+
+		if (!hasBaseline)
+		{
+			baseline = metrics;
+			hasBaseline = true;
+			continue;
+		}
+
+		// The first full window after the warmup sets the latency every later window is held to
+		if (!hasLatencyBaseline)
+		{
+			baselineP99 = latency.P99;
+			hasLatencyBaseline = latency.Count > 0;
+			continue;
+		}
+
+		if (metrics.ResidentBytes > baseline.ResidentBytes + this->settings.MaxResidentGrowth)
+		{
+			spdlog::error("Soak :: Resident memory grew from {} KB to {} KB", baseline.ResidentBytes / 1024, metrics.ResidentBytes / 1024);
+			passed = false;
+		}
+
+		if (metrics.Threads > baseline.Threads + this->settings.MaxThreadGrowth)
+		{
+			spdlog::error("Soak :: Thread count grew from {} to {}", baseline.Threads, metrics.Threads);
+			passed = false;
+		}
+
+		if (metrics.Handles > baseline.Handles + this->settings.MaxHandleGrowth)
+		{
+			spdlog::error("Soak :: Handle count grew from {} to {}", baseline.Handles, metrics.Handles);
+			passed = false;
+		}
+
+		if (latency.Count == 0)
+		{
+			spdlog::error("Soak :: No request was completed within the last {} s", this->settings.SampleInterval.count());
+			passed = false;
+		}
+		else if (latency.P99 > baselineP99 * this->settings.MaxLatencyGrowth)
+		{
+			spdlog::error("Soak :: p99 reply latency grew from {} us to {} us", baselineP99, latency.P99);
+			passed = false;
+		}
+	}
+
+	this->Close();
+
+	// Every reconnect after the first handshake should offer the ticket of the previous session
+	if (this->sslContext)
+	{
+		spdlog::info("Soak :: {} of {} TLS handshakes resumed", this->tlsResumptions.load(), this->tlsHandshakes.load());
+
+		if (this->tlsHandshakes > 1 && this->tlsResumptions == 0)
+		{
+			spdlog::error("Soak :: No TLS session was resumed");
+			passed = false;
+		}
+	}
+
+	if (passed)
+	{
+		spdlog::info("Soak :: Passed, {} sessions served", this->sessionsServed.load());
+	}
+
+	return passed;
+}
+
+void SoakHarness::RecordLatency(std::chrono::microseconds latency)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->latencies.push_back(latency.count());
+}
+
+unsigned long long SoakHarness::NextRequestId()
+{
+	return ++this->requestId;
+}
+
+void SoakHarness::RecordTlsHandshake(bool resumed)
+{
+	this->tlsHandshakes++;
+	if (resumed)
+	{
+		this->tlsResumptions++;
+	}
+}
+
+void SoakHarness::Close()
+{
+	if (!this->ioThread.joinable())
+	{
+		return;
+	}
+
+	net::post(this->ioc, [this]
+	{
+		beast::error_code ec;
+		this->acceptor.close(ec);
+	});
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		for (auto const& session : this->sessions)
+		{
+			if (auto open = session.lock())
+			{
+				open->Close();
+			}
+		}
+	}
+
+	this->ioThread.join();
+}
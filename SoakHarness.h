@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
+
+/// Resources held by the process
+class ProcessMetrics
+{
+public:
+	/// Resident set (working set on Windows)
+	size_t ResidentBytes;
+	int Threads;
+	/// Open handles on Windows, open file descriptors elsewhere
+	int Handles;
+
+	static ProcessMetrics Sample();
+};
+
+class SoakSettings
+{
+public:
+	/// Port of the websocket stand-in, the rigs must be configured to connect to it
+	int Port;
+	std::chrono::seconds Duration;
+	/// Time before the baseline is taken, covers startup allocations and the first sessions
+	std::chrono::seconds Warmup;
+	std::chrono::seconds SampleInterval;
+	/// The stand-in drops every session after this long
+	std::chrono::seconds ReconnectInterval;
+	/// Time between two messages sent to a session
+	std::chrono::milliseconds MessageInterval;
+	size_t MaxResidentGrowth;
+	int MaxThreadGrowth;
+	int MaxHandleGrowth;
+	/// Largest tolerated ratio of a window's p99 reply latency to the baseline p99
+	double MaxLatencyGrowth;
+	/// Samples are appended here as CSV, empty to skip
+	std::string SamplesPath;
+	/// Serves wss:// with a self-signed certificate for 127.0.0.1, so reconnects resume TLS sessions
+	bool Tls;
+	/// The certificate is written here, the rigs trust it as their caFile
+	std::string CertificateFile;
+};
+
+/// Soaks the controller: serves the rigs from a local websocket stand-in with mixed traffic and
+/// forced reconnects, and samples process resources and reply latency until the soak duration
+/// elapsed or one of them drifted past its threshold.
+class SoakHarness
+{
+public:
+	SoakHarness(SoakSettings const& settings);
+	~SoakHarness();
+
+	SoakHarness(const SoakHarness&) = delete;
+	SoakHarness& operator=(const SoakHarness&) = delete;
+
+	/// Starts the stand-in, throws if the port cannot be bound
+	void Start();
+	/// Samples until the soak is over, then closes the stand-in. Returns false if a metric drifted.
+	bool Run();
+
+	class Session;
+
+	/// Called by sessions with the time from sending a request to its final status
+	void RecordLatency(std::chrono::microseconds latency);
+	unsigned long long NextRequestId();
+	/// Called by TLS sessions once their handshake completed
+	void RecordTlsHandshake(bool resumed);
+
+private:
+	SoakSettings settings;
+	boost::asio::io_context ioc;
+	boost::asio::ip::tcp::acceptor acceptor;
+	/// Server context, only set with Tls
+	std::unique_ptr<boost::asio::ssl::context> sslContext;
+	std::thread ioThread;
+
+	/// Guards sessions and latencies, both are touched by the I/O and the sampling thread
+	std::mutex mutex;
+	std::vector<std::weak_ptr<Session>> sessions;
+	std::vector<long long> latencies;
+	std::atomic<unsigned long long> requestId;
+	std::atomic<unsigned long long> sessionsServed;
+	std::atomic<unsigned long long> tlsHandshakes;
+	std::atomic<unsigned long long> tlsResumptions;
+
+	void Accept();
+	void Close();
+};
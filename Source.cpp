@@ -2,21 +2,54 @@
 #include "MessageParser.h"  
 #include "PowerController.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <string>
 #include <thread>  
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <vector>
 #include <spdlog/spdlog.h> 
 #include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
 #include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
 #include <boost/asio/connect.hpp>
 #include <boost/asio/ip/tcp.hpp> 
 #include <boost/asio/serial_port.hpp> 
 #include <boost/asio.hpp> 
 #include <sstream>
+#include <fstream>
+#include <limits>
 
 #include "ConfigFile.h"    
+#include "SensorSample.h"
+#include "SensorProtocol.h"
+#include "HardwareStateStore.h"
+#include "LinkMonitor.h"
+#include "OutboundQueue.h"
+#include "UpdateHandler.h"
+#include "MessageArena.h"
+#include "AllocationCounter.h"
+#include "PeriodicScheduler.h"
+#include "TelemetryStream.h"
+#include "SharedMemoryInterface.h"
+#include "MotionProgramRunner.h"
+#include "Tracer.h"
+#include "TlsSessionCache.h"
+#include "StateCheckpoint.h"
+#include "SoakHarness.h"
+#include "TelemetryHistory.h"
+#include "HistoryStream.h"
+#include "TelemetryArchive.h"
+#include "ClockSync.h"
+
+#ifndef _WIN32
+#include <termios.h>
+#endif
 
 namespace beast = boost::beast;         // from <boost/beast.hpp>
 namespace http = beast::http;           // from <boost/beast/http.hpp>
@@ -24,84 +57,451 @@ namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
 namespace net = boost::asio;            // from <boost/asio.hpp>
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
 
-std::mutex websocket_mutex; 
+/// Maximum number of samples taken off a device ring in one drain
+const size_t TelemetryBatchSize = 64;
+
+/// Handshake header used to agree on batched (JSON array) frames
+const char* BatchingHeader = "X-Wds-Batching";
+
+/// Message waiting in the normal command lane
+class PendingMessage {
+public:
+	std::string Message;
+	MessageType Type;
+	/// Stop generation at the time the message was received
+	unsigned long StopGeneration;
+	/// Correlation id chosen by the server, empty if the message carried none
+	std::string Id;
+	/// HardwareState field bits an update carries, 0 for other messages
+	unsigned int Fields;
+	std::chrono::steady_clock::time_point ReceivedAt;
+};
 
+template <typename WebsocketStream>
 class MessageHandler { 
 
-	websocket::stream<tcp::socket>* websocket;  
+	WebsocketStream* websocket;  
+	net::io_context* ioContext;
+	OutboundQueue* outbound;
 	MessageParser messageParser;
+	UpdateHandler updateHandler;
 	EnginesController* enginesController;
-	PowerController* powerController;
+	HardwareStateStore* stateStore;
+	LinkMonitor* linkMonitor;
+	TelemetryStream* telemetryStream;
+	HistoryStream* historyStream;
+	ClockSync* clockSync;
+	MotionProgramRunner* programRunner;
+	std::atomic<bool>* running;
+	std::string tracePath;
 
 public:
-	MessageHandler(websocket::stream<tcp::socket>* ws,  EnginesController* enginesController, PowerController* powerController)
+	MessageHandler(WebsocketStream* ws, net::io_context* ioContext, OutboundQueue* outbound, EnginesController* enginesController, PowerController* powerController, HardwareStateStore* stateStore, LinkMonitor* linkMonitor, TelemetryStream* telemetryStream, HistoryStream* historyStream, ClockSync* clockSync, MotionProgramRunner* programRunner, std::atomic<bool>* running, std::string tracePath)
+		: updateHandler(enginesController, powerController, stateStore)
 	{
 		spdlog::info("Constructing message handler");
 		this->websocket = ws;  
+		this->ioContext = ioContext;
+		this->outbound = outbound;
 		this->enginesController = enginesController;
-		this->powerController = powerController;
+		this->stateStore = stateStore;
+		this->linkMonitor = linkMonitor;
+		this->telemetryStream = telemetryStream;
+		this->historyStream = historyStream;
+		this->clockSync = clockSync;
+		this->programRunner = programRunner;
+		this->running = running;
+		this->tracePath = tracePath;
 	} 
 
 	void handleMessages()
 	{
-		try 
+		// Normal lane, served by the worker thread so that the reader stays free for stop requests
+		std::mutex queueMutex;
+		std::condition_variable queueCondition;
+		std::deque<PendingMessage> queue;
+		bool readerDone = false;
+
+		std::thread worker([&]
 		{
-			beast::flat_buffer buffer;
+			SetTraceThreadName("message worker");
+			MessageArena arena;
+
 			for (;;)
 			{
-				// Read a message into our buffer
-				this->websocket->read(buffer);
+				PendingMessage pending;
+				{
+					std::unique_lock<std::mutex> lock(queueMutex);
+					queueCondition.wait(lock, [&] { return readerDone || !queue.empty(); });
+
+					if (readerDone)
+					{
+						return;
+					}
 
-				std::stringstream messagestream;
-				messagestream << beast::make_printable(buffer.data());
-				auto messageString = messagestream.str();
+					pending = queue.front();
+					queue.pop_front();
+
+					// A pipelining server only cares about the latest value of each field it has in flight,
+					// an update is dropped once later ones set all of its fields
+					if (pending.Type == MessageType::Update && !pending.Id.empty() && pending.Fields != 0)
+					{
+						unsigned int laterFields = 0;
+						for (auto const& queued : queue)
+						{
+							if (queued.Type == MessageType::Update)
+							{
+								laterFields |= queued.Fields;
+							}
+						}
+
+						if ((pending.Fields & ~laterFields) == 0)
+						{
+							lock.unlock();
+							this->reportStatus(pending, RequestStatus::Superseded);
+							continue;
+						}
+					}
+				}
 
-				spdlog::info("Handling incoming message: {}", messageString);
+				std::string error;
+				TraceScope trace("process message", "websocket", pending.Type);
+				auto status = this->processMessage(pending, arena, error);
+				this->reportStatus(pending, status, error);
+			}
+		});
 
-				auto messageType = this->messageParser.GetMessageType(messageString);
+		try 
+		{
+			SetTraceThreadName("websocket io");
+			beast::flat_buffer buffer;
 
-				switch (messageType)
+			// Every read, write and ping of the session runs on this thread, a TLS stream must not be used from two
+			std::function<void()> readNext;
+			readNext = [&]
+			{
+				this->websocket->async_read(buffer, [&](beast::error_code ec, std::size_t)
 				{
-					case MessageType::Update:
-					{ 
-						auto stateUpdate = this->messageParser.ParseToHardwareState(messageString);
-						auto returnedState = this->enginesController->UpdateHardwareState(stateUpdate);
-						this->powerController->UpdatePowerState(stateUpdate);
-						this->websocket->write(net::buffer(messageParser.ParseToUpdate(returnedState)));
-						break;
+					if (ec)
+					{
+						spdlog::error("Error in message handler: {}", ec.message());
+						return;
 					}
-					case MessageType::Command: 
+
+					auto receivedAt = std::chrono::steady_clock::now();
+					TraceScope trace("websocket decode", "websocket");
+					this->linkMonitor->OnFrameReceived();
+
+					std::string messageString(static_cast<const char*>(buffer.data().data()), buffer.size());
+					buffer.clear();
+
+					spdlog::info("Handling incoming message: {}", messageString);
+
+					PendingMessage pending;
+					pending.Message = messageString;
+					pending.Type = this->messageParser.GetMessageType(messageString);
+					pending.StopGeneration = this->enginesController->StopGeneration();
+					pending.ReceivedAt = receivedAt;
+					pending.Id = this->messageParser.GetMessageId(messageString);
+					pending.Fields = pending.Type == MessageType::Update ? this->messageParser.GetUpdateFields(messageString) : 0;
+
+					// Answered right here, waiting in the normal lane would skew the exchange
+					if (pending.Type == MessageType::Time)
 					{
-						auto commandType = this->messageParser.GetCommandType(messageString);
-						auto connectionState = this->enginesController->ToogleConnection(commandType); 
-						this->websocket->write(net::buffer(messageParser.ParseToEngineConnectionState(connectionState)));
-						break;
+						this->handleTime(messageString, receivedAt);
+						readNext();
+						return;
 					}
-				} 
-				
-				buffer.clear();
-			}
+
+					// Safety-critical commands bypass the normal lane and preempt running ramps
+					auto commandType = pending.Type == MessageType::Command ? this->messageParser.GetCommandType(messageString) : CommandType::Other;
+					if (commandType == CommandType::Stop || commandType == CommandType::Disconnect)
+					{
+						this->handleStop(commandType, receivedAt);
+						this->reportStatus(pending, RequestStatus::Accepted);
+						this->reportStatus(pending, RequestStatus::Completed);
+					}
+					else
+					{
+						this->reportStatus(pending, RequestStatus::Accepted);
+
+						{
+							std::lock_guard<std::mutex> lock(queueMutex);
+							queue.push_back(pending);
+						}
+						queueCondition.notify_one();
+					}
+
+					readNext();
+				});
+			};
+
+			readNext();
+			this->ioContext->run();
 		}
 		catch (std::exception const& e)
 		{
 			spdlog::error("Error in message handler: {}", e.what()); 
 		}
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			readerDone = true;
+		}
+		queueCondition.notify_one();
+		worker.join();
+
+		this->running->store(false);
 	} 
+
+private:
+	void handleStop(CommandType commandType, std::chrono::steady_clock::time_point receivedAt)
+	{
+		if (commandType == CommandType::Stop)
+		{
+			auto latency = this->enginesController->EmergencyStop(false, receivedAt);
+			this->write(messageParser.ParseToStopState(MonotonicMicroseconds(receivedAt), latency, this->enginesController->MaxStopLatency()));
+			return;
+		}
+
+		this->enginesController->EmergencyStop(true, receivedAt);
+		auto connectionState = this->enginesController->ToogleConnection(commandType);
+		this->write(messageParser.ParseToEngineConnectionState(connectionState));
+	}
+
+	/// Sends the acknowledgement or outcome of a request the server tagged with an id
+	void reportStatus(PendingMessage const& pending, RequestStatus status, std::string const& error = std::string())
+	{
+		if (pending.Id.empty())
+		{
+			return;
+		}
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pending.ReceivedAt);
+		this->write(messageParser.ParseToRequestStatus(pending.Id, status, MonotonicMicroseconds(pending.ReceivedAt), elapsed, error));
+	}
+
+	/// Answers a time request of the server, or feeds the answer to one of ours into the clock estimate
+	void handleTime(std::string const& message, std::chrono::steady_clock::time_point receivedAt)
+	{
+		try
+		{
+			auto exchange = this->messageParser.ParseToClockExchange(message);
+
+			if (!exchange.IsAnswer)
+			{
+				this->write(messageParser.ParseToTimeAnswer(exchange.T0, MonotonicMicroseconds(receivedAt)));
+				return;
+			}
+
+			// The server learns the estimate whenever it changes, it needs it to place controller timestamps
+			if (this->clockSync->OnExchange(exchange.T0, exchange.T1, exchange.T2, MonotonicMicroseconds(receivedAt)))
+			{
+				this->write(messageParser.ParseToClockState(this->clockSync->Offset(), this->clockSync->Delay()));
+			}
+		}
+		catch (std::exception const& e)
+		{
+			spdlog::error("Error while handling time message: {}", e.what());
+		}
+	}
+
+	RequestStatus handleProgramCommand(CommandType commandType, bool stale, std::string& error)
+	{
+		// A program command sent before a stop must not restart motion after it
+		if (stale)
+		{
+			this->write(messageParser.ParseToProgramStatus(this->programRunner->Status()));
+			return RequestStatus::Superseded;
+		}
+
+		bool accepted = false;
+		switch (commandType)
+		{
+			case CommandType::StartProgram:
+				accepted = this->programRunner->Start();
+				break;
+			case CommandType::PauseProgram:
+				accepted = this->programRunner->Pause();
+				break;
+			case CommandType::ResumeProgram:
+				accepted = this->programRunner->Resume();
+				break;
+			case CommandType::AbortProgram:
+				accepted = this->programRunner->Abort();
+				break;
+			default:
+				spdlog::warn("Program :: Ignored command {}, it is not a program command", (int)commandType);
+				break;
+		}
+
+		if (!accepted)
+		{
+			// The state change itself is reported by the program listener
+			this->write(messageParser.ParseToProgramStatus(this->programRunner->Status()));
+			error = "Program command not applicable in the current program state";
+			return RequestStatus::Failed;
+		}
+
+		return RequestStatus::Completed;
+	}
+
+	void handleTraceCommand(CommandType commandType)
+	{
+		if (commandType == CommandType::DumpTrace)
+		{
+			auto events = WriteTrace(this->tracePath);
+			this->write(messageParser.ParseToTraceState(TracingEnabled(), this->tracePath, events));
+			return;
+		}
+
+		SetTracingEnabled(commandType == CommandType::StartTrace);
+		this->write(messageParser.ParseToTraceState(TracingEnabled(), std::string(), 0));
+	}
+
+	RequestStatus processMessage(PendingMessage const& pending, MessageArena& arena, std::string& error)
+	{
+		try
+		{
+			// Everything decoded and encoded for this message is released at once when it is done
+			MessageArenaScope arenaScope(arena);
+
+			// Messages received before a stop are answered with the current state but not applied
+			bool stale = pending.StopGeneration != this->enginesController->StopGeneration();
+
+			switch (pending.Type)
+			{
+				case MessageType::Update:
+				{ 
+					if (stale)
+					{
+						this->write(messageParser.ParseToUpdate(this->stateStore->Current()->ToHardwareState()));
+						return RequestStatus::Superseded;
+					}
+
+					this->write(this->updateHandler.Process(pending.Message, pending.StopGeneration));
+
+					// A stop during the ramp left the update partially applied
+					if (pending.StopGeneration != this->enginesController->StopGeneration())
+					{
+						return RequestStatus::Superseded;
+					}
+					break;
+				}
+				case MessageType::Command: 
+				{
+					auto commandType = this->messageParser.GetCommandType(pending.Message);
+					if (commandType == CommandType::StartProgram || commandType == CommandType::PauseProgram ||
+						commandType == CommandType::ResumeProgram || commandType == CommandType::AbortProgram)
+					{
+						return this->handleProgramCommand(commandType, stale, error);
+					}
+
+					if (commandType == CommandType::StartTrace || commandType == CommandType::StopTrace || commandType == CommandType::DumpTrace)
+					{
+						this->handleTraceCommand(commandType);
+						break;
+					}
+
+					auto connectionState = this->enginesController->IsConnected();
+					if (!stale)
+					{
+						connectionState = this->enginesController->ToogleConnection(commandType); 
+					}
+
+					this->write(messageParser.ParseToEngineConnectionState(connectionState));
+
+					if (stale)
+					{
+						return RequestStatus::Superseded;
+					}
+					break;
+				}
+				case MessageType::Status:
+				{
+					auto snapshot = this->stateStore->Current();
+					this->write(messageParser.ParseToStatus(*snapshot, this->enginesController->IsConnected(), MonotonicMicroseconds()), OutboundType::StatusReply);
+					break;
+				}
+				case MessageType::Subscribe:
+				{
+					this->telemetryStream->Subscribe(messageParser.ParseToSubscription(pending.Message));
+					break;
+				}
+				case MessageType::History:
+				{
+					// Completed once queued, the chunks follow with the last one marked
+					this->historyStream->Enqueue(messageParser.ParseToHistoryQuery(pending.Message), pending.Id);
+					break;
+				}
+				case MessageType::Program:
+				{
+					this->programRunner->Load(messageParser.ParseToMotionProgram(pending.Message));
+					this->write(messageParser.ParseToProgramStatus(this->programRunner->Status()));
+					break;
+				}
+				case MessageType::Time:
+				{
+					// Handled by the reader, never queued
+					break;
+				}
+				case MessageType::Unknown:
+				{
+					error = "Unknown message type";
+					return RequestStatus::Failed;
+				}
+			} 
+		}
+		catch (std::exception const& e)
+		{
+			spdlog::error("Error while processing message: {}", e.what());
+			error = e.what();
+			return RequestStatus::Failed;
+		}
+
+		return RequestStatus::Completed;
+	}
+
+	void write(std::string message, OutboundType type = OutboundType::Reply)
+	{
+		this->outbound->Push(std::move(message), type);
+	}
+
+	void write(MessageString const& message)
+	{
+		this->outbound->Push(std::string(message.data(), message.size()), OutboundType::Reply);
+	}
 }; 
 
 class ArduinoHandler {
 
-	websocket::stream<tcp::socket>* websocket;
-	MessageParser messageParser; 
+	SensorRing* samples;
+	HardwareStateStore* stateStore;
+	/// Every sample of every channel is recorded here, null without history
+	TelemetryHistory* history;
+	/// Every reading is archived here, null without archive
+	TelemetryArchive* archive;
+	std::atomic<bool>* running;
 	std::string portName;
 	int baudrate;
+	/// Framed multi-channel protocol instead of ASCII lines
+	bool binaryProtocol;
+	int sampleRate;
+	unsigned char channelMask;
 
 public:
-	ArduinoHandler(websocket::stream<tcp::socket>* ws, std::string portName, int arduinoPortBaudrate)
+	ArduinoHandler(SensorRing* samples, HardwareStateStore* stateStore, TelemetryHistory* history, TelemetryArchive* archive, std::atomic<bool>* running, std::string portName, int arduinoPortBaudrate, bool binaryProtocol, int sampleRate, unsigned char channelMask)
 	{
-		this->websocket = ws;
+		this->samples = samples;
+		this->stateStore = stateStore;
+		this->history = history;
+		this->archive = archive;
+		this->running = running;
 		this->portName = portName;
 		this->baudrate = arduinoPortBaudrate;
+		this->binaryProtocol = binaryProtocol;
+		this->sampleRate = sampleRate;
+		this->channelMask = channelMask;
 	}
 
 	void handleSerial()
@@ -113,26 +513,24 @@ public:
 		{  
 			port.open(this->portName); 
 			port.set_option(net::serial_port_base::baud_rate(this->baudrate)); 
+#ifdef _WIN32
 			PurgeComm(port.lowest_layer().native_handle(), PURGE_RXABORT | PURGE_TXABORT | PURGE_RXCLEAR | PURGE_TXCLEAR);
+#else
+			tcflush(port.lowest_layer().native_handle(), TCIOFLUSH);
+#endif
 
-			for (;;)
-			{
-				char c;
-				std::string result;
-				for (;;)
-				{
-					boost::asio::read(port, boost::asio::buffer(&c, 1));
+			SetTraceThreadName("arduino");
 
-					if (c == '\r' || c== '\n') 
-					{
-						break;
-					}
+			if (this->binaryProtocol)
+			{
+				this->readFrames(port);
+			}
+			else
+			{
+				this->readLines(port);
+			}
 
-					result += c; 
-				} 
-				spdlog::info("arduino: {}", result); 
-				websocket->write(net::buffer(messageParser.ParseToTemperatureState(result)));
-			}  
+			port.close();
 		}
 		catch (boost::system::system_error e)
 		{
@@ -140,91 +538,1313 @@ public:
 			spdlog::error("Error in arduino handler: {}", e.what());
 		}
 	}
+
+private:
+	void record(int thermocouple, double temperature, std::chrono::steady_clock::time_point sampledAt)
+	{
+		if (this->history != nullptr)
+		{
+			this->history->Record(ThermocoupleChannel(thermocouple), temperature, MonotonicMicroseconds(sampledAt));
+		}
+	}
+
+	/// The archive outlives restarts, it takes the wall clock time sampledAt corresponds to
+	void archiveReading(SensorReading const& reading, std::chrono::steady_clock::time_point sampledAt)
+	{
+		if (this->archive != nullptr)
+		{
+			auto sampled = std::chrono::system_clock::now() - (std::chrono::steady_clock::now() - sampledAt);
+			this->archive->Append(reading, std::chrono::duration_cast<std::chrono::microseconds>(sampled.time_since_epoch()).count());
+		}
+	}
+
+	/// Firmware sending one ASCII temperature per line
+	void readLines(net::serial_port& port)
+	{
+		while (this->running->load())
+		{
+			char c;
+			std::string result;
+			std::chrono::steady_clock::time_point lineStarted;
+			for (;;)
+			{
+				boost::asio::read(port, boost::asio::buffer(&c, 1));
+
+				if (c == '\r' || c== '\n') 
+				{
+					break;
+				}
+
+				if (result.empty())
+				{
+					lineStarted = std::chrono::steady_clock::now();
+				}
+
+				result += c; 
+			} 
+			if (TracingEnabled())
+			{
+				// From the first to the last character, shows how long the line was on the wire
+				RecordTraceEvent("arduino line", "arduino", (long long)result.size(), lineStarted, std::chrono::steady_clock::now());
+			}
+
+			TraceScope trace("arduino sample", "arduino");
+			spdlog::info("arduino: {}", result); 
+
+			SensorSample sample;
+			sample.Timestamp = std::chrono::steady_clock::now();
+			snprintf(sample.Value, sizeof(sample.Value), "%s", result.c_str());
+			sample.Channel = 0;
+			sample.DeviceTime = -1;
+			this->samples->Push(sample);
+
+			char* end;
+			double temperature = std::strtod(sample.Value, &end);
+			if (end != sample.Value)
+			{
+				SensorReading reading;
+				reading.DeviceTime = 0;
+				reading.ChannelMask = 1;
+				reading.Temperatures[0] = temperature;
+				this->archiveReading(reading, sample.Timestamp);
+
+				this->record(0, temperature, sample.Timestamp);
+				this->stateStore->SetCurrentTemperature(temperature, StateSource::Arduino);
+			}
+		}  
+	}
+
+	/// Firmware speaking the framed protocol of SensorProtocol.h
+	void readFrames(net::serial_port& port)
+	{
+		SensorFrameDecoder decoder;
+		unsigned char buffer[256];
+		bool rateAcknowledged = false;
+		bool channelsAcknowledged = false;
+		std::chrono::steady_clock::time_point configurationSent;
+		unsigned long long reportedErrors = 0;
+
+		auto sendConfiguration = [&]
+		{
+			boost::asio::write(port, boost::asio::buffer(EncodeSetSampleRate(this->sampleRate)));
+			boost::asio::write(port, boost::asio::buffer(EncodeSetChannels(this->channelMask)));
+			configurationSent = std::chrono::steady_clock::now();
+		};
+
+		sendConfiguration();
+
+		while (this->running->load())
+		{
+			auto received = port.read_some(boost::asio::buffer(buffer));
+			auto receivedAt = std::chrono::steady_clock::now();
+
+			decoder.Feed(buffer, received, [&](SensorFrame const& frame)
+			{
+				if (frame.Type == SensorAck && frame.Size == 2)
+				{
+					if (frame.Payload[1] != 0)
+					{
+						spdlog::error("Arduino :: Firmware rejected command {:#x} with status {}", frame.Payload[0], frame.Payload[1]);
+					}
+
+					rateAcknowledged = rateAcknowledged || frame.Payload[0] == SensorSetSampleRate;
+					channelsAcknowledged = channelsAcknowledged || frame.Payload[0] == SensorSetChannels;
+					return;
+				}
+
+				SensorReading reading;
+				if (!DecodeSensorReading(frame, reading))
+				{
+					spdlog::warn("Arduino :: Ignored frame of type {:#x} ({} bytes)", frame.Type, frame.Size);
+					return;
+				}
+
+				TraceScope trace("arduino sample", "arduino", reading.ChannelMask);
+
+				for (int channel = 0; channel < SensorChannelCount; channel++)
+				{
+					if (!(reading.ChannelMask & (1 << channel)))
+					{
+						continue;
+					}
+
+					SensorSample sample;
+					sample.Timestamp = receivedAt;
+					snprintf(sample.Value, sizeof(sample.Value), "%.2f", reading.Temperatures[channel]);
+					sample.Channel = channel;
+					sample.DeviceTime = reading.DeviceTime;
+					this->samples->Push(sample);
+					this->record(channel, reading.Temperatures[channel], receivedAt);
+
+					if (channel == 0)
+					{
+						this->stateStore->SetCurrentTemperature(reading.Temperatures[channel], StateSource::Arduino);
+					}
+				}
+
+				this->archiveReading(reading, receivedAt);
+			});
+
+			// Commands sent while the board was still resetting after the port was opened are lost
+			if ((!rateAcknowledged || !channelsAcknowledged) && receivedAt - configurationSent > std::chrono::seconds(1))
+			{
+				spdlog::warn("Arduino :: Configuration not acknowledged, sending it again");
+				sendConfiguration();
+			}
+
+			auto errors = decoder.CrcErrors() + decoder.FramingErrors();
+			if (errors != reportedErrors)
+			{
+				spdlog::warn("Arduino :: Dropped {} corrupted frames ({} CRC, {} framing errors of {} frames)", errors - reportedErrors, decoder.CrcErrors(), decoder.FramingErrors(), decoder.Frames() + errors);
+				reportedErrors = errors;
+			}
+		}
+	}
 }; 
 
-// Sends a WebSocket message and prints the response
-int main(int argc, char** argv)
-{
-	try {  
-		ConfigFile cf("config.txt"); 
-
-		std::string host = cf.Value("connection", "host");
-		std::string port = cf.Value("connection", "port");
-		std::string enginesPortNo = cf.Value("serial ports", "enginesPortNo");
-		std::string enginesPortBaudrate = cf.Value("serial ports", "enginesPortBaudrate");
-		std::string arduinoPortName = cf.Value("serial ports", "arduinoPortName");
-		std::string arduinoPortBaudrate = cf.Value("serial ports", "arduinoPortBaudrate");
-		std::string powerSupplyPortName = cf.Value("serial ports", "powerSupplyPortName");
-		std::string powerSupplyPortBaudrate = cf.Value("serial ports", "powerSupplyPortBaudrate");
-
-		std::string engine1SlaveNo = cf.Value("engines", "engine1SlaveNo");
-		std::string engine2SlaveNo = cf.Value("engines", "engine2SlaveNo"); 
-		std::string engine1EasyStart = cf.Value("engines", "engine1EasyStart");
-		std::string engine2EasyStart = cf.Value("engines", "engine2EasyStart");
-		std::string engine1EasyStop = cf.Value("engines", "engine1EasyStop");
-		std::string engine2EasyStop = cf.Value("engines", "engine2EasyStop");
-		std::string engine1EasyChange = cf.Value("engines", "engine1EasyChange");
-		std::string engine2EasyChange = cf.Value("engines", "engine2EasyChange"); 
-
-		EnginesController enginesController(
-			std::stoi(enginesPortNo),
-			std::stoi(enginesPortBaudrate),
-			std::stoi(engine1SlaveNo),
-			std::stoi(engine2SlaveNo),
-			std::stoi(engine1EasyStart),
-			std::stoi(engine2EasyStart),
-			std::stoi(engine1EasyStop),
-			std::stoi(engine2EasyStop),
-			std::stoi(engine1EasyChange),
-			std::stoi(engine2EasyChange)
-		);  
+class TelemetryHandler {
 
-		net::io_service io;
-		PowerController powerController(powerSupplyPortName, std::stoi(powerSupplyPortBaudrate), &io);
+	OutboundQueue* outbound;
+	MessageParser messageParser;
+	SensorRing* samples;
+	LinkMonitor* linkMonitor;
+	TelemetryStream* telemetryStream;
+	std::atomic<bool>* running;
+	SensorSample batch[TelemetryBatchSize];
+	unsigned long long reportedOverflows;
+	unsigned long long throttledSamples;
+	std::chrono::steady_clock::time_point lastSent;
 
-		for (;;)
-		{ 
-			try
-			{ 
-				// The io_context is required for all I/O
-				net::io_context ioc;
+public:
+	TelemetryHandler(OutboundQueue* outbound, SensorRing* samples, LinkMonitor* linkMonitor, TelemetryStream* telemetryStream, std::atomic<bool>* running)
+	{
+		this->outbound = outbound;
+		this->samples = samples;
+		this->linkMonitor = linkMonitor;
+		this->telemetryStream = telemetryStream;
+		this->running = running;
+		this->reportedOverflows = samples->Overflows();
+		this->throttledSamples = 0;
+	}
+
+	/// Drains the arduino samples once, run periodically by the scheduler
+	bool handleTelemetry()
+	{
+		if (!this->running->load())
+		{
+			return false;
+		}
+
+		try
+		{
+			auto overflows = this->samples->Overflows();
+			if (overflows != this->reportedOverflows)
+			{
+				spdlog::warn("Telemetry :: Dropped {} arduino samples ({} in total)", overflows - this->reportedOverflows, overflows);
+				this->reportedOverflows = overflows;
+			}
 
-				// These objects perform our I/O
-				tcp::resolver resolver{ ioc };
-				websocket::stream<tcp::socket> ws{ ioc }; 
-				
-				// Look up the domain name
-				auto const results = resolver.resolve(host, port);   
+			this->linkMonitor->OnQueueDepth(this->samples->Size() + this->outbound->Depth());
+
+			auto count = this->samples->PopBatch(this->batch, TelemetryBatchSize);
+			if (count == 0)
+			{
+				return true;
+			}
 
-				spdlog::info("Attempting to connect websocket server {} on port {}", host, port);
-				// Make the connection on the IP address we get from a lookup
-				net::connect(ws.next_layer(), results.begin(), results.end());
+			// Subscribed servers get the temperature (channel 0) through the telemetry stream instead
+			if (this->telemetryStream->IsActive())
+			{
+				count = (size_t)(std::remove_if(this->batch, this->batch + count, [](SensorSample const& sample) { return sample.Channel == 0; }) - this->batch);
+				if (count == 0)
+				{
+					return true;
+				}
+			}
 
-				// Set a decorator to change the User-Agent of the handshake
-				ws.set_option(websocket::stream_base::decorator([](websocket::request_type& req)
+			// While the link is degraded only the latest sample of each channel is sent once per interval
+			bool latestOnly = false;
+			auto interval = this->linkMonitor->TelemetryInterval();
+			if (interval.count() > 0)
+			{
+				auto now = std::chrono::steady_clock::now();
+				if (now - this->lastSent < interval)
 				{
-					req.set(http::field::user_agent,
-						std::string(BOOST_BEAST_VERSION_STRING) +
-						" websocket-client-coro" + " wds-hardware-controller");
-				}));
+					this->throttledSamples += count;
+					return true;
+				}
+
+				latestOnly = true;
+				this->lastSent = now;
+			}
 
-				// Perform the websocket handshake
-				ws.handshake(host, "/"); 
-				
-				spdlog::info("Successfully connected to websocket server {} on port {}", host, port);  
+			for (size_t i = 0; i < count; i++)
+			{
+				auto const& sample = this->batch[i];
+				if (latestOnly && std::any_of(this->batch + i + 1, this->batch + count, [&sample](SensorSample const& later) { return later.Channel == sample.Channel; }))
+				{
+					this->throttledSamples++;
+					continue;
+				}
 
-				std::thread t(&MessageHandler::handleMessages, MessageHandler(&ws, &enginesController, &powerController));  
-				std::thread t2(&ArduinoHandler::handleSerial, ArduinoHandler(&ws, arduinoPortName, std::stoi(arduinoPortBaudrate)));
+				this->outbound->Push(messageParser.ParseToTemperatureState(sample.Value, MonotonicMicroseconds(sample.Timestamp), sample.Channel, sample.DeviceTime), OutboundType::TemperatureReading, sample.Channel);
+			}
 
-				t.join(); 
-				t2.join();
+			if (this->throttledSamples > 0 && interval.count() == 0)
+			{
+				spdlog::info("Telemetry :: Skipped {} arduino samples while the link was throttled", this->throttledSamples);
+				this->throttledSamples = 0;
 			}
-			catch (std::exception const& e)
-			{		
-				spdlog::error("Error: {} ", e.what()); 
-			} 
 
-			Sleep(1000);
+			return true;
+		}
+		catch (std::exception const& e)
+		{
+			spdlog::error("Error in telemetry handler: {}", e.what());
+		}
+
+		this->running->store(false);
+		return false;
+	}
+}; 
+
+/// Writes whatever the outbound queue receives, on the session I/O thread
+template <typename WebsocketStream>
+class WebsocketWriter {
+
+	WebsocketStream* websocket;
+	net::io_context* ioContext;
+	OutboundQueue* outbound;
+	std::atomic<bool>* running;
+	bool batching;
+	size_t maxBatchSize;
+	std::vector<std::string> pending;
+	std::vector<net::const_buffer> buffers;
+	bool writing;
+	std::chrono::steady_clock::time_point writeStarted;
+
+public:
+	WebsocketWriter(WebsocketStream* ws, net::io_context* ioContext, OutboundQueue* outbound, std::atomic<bool>* running, bool batching, size_t maxBatchSize)
+	{
+		this->websocket = ws;
+		this->ioContext = ioContext;
+		this->outbound = outbound;
+		this->running = running;
+		this->batching = batching;
+		// An empty batch would go out as a bare closing bracket and never drain the queue
+		this->maxBatchSize = std::max<size_t>(maxBatchSize, 1);
+		this->writing = false;
+	}
+
+	void start()
+	{
+		this->outbound->SetListener([this]
+		{
+			net::post(*this->ioContext, [this] { this->writeNext(); });
+		});
+
+		// Picks up what was queued before the session started
+		net::post(*this->ioContext, [this] { this->writeNext(); });
+	}
+
+	/// Must be called before the writer or the I/O context go away
+	void stop()
+	{
+		this->outbound->SetListener(OutboundQueue::Listener());
+	}
+
+private:
+	void writeNext()
+	{
+		static const char opening = '[';
+		static const char separator = ',';
+		static const char closing = ']';
+
+		if (this->writing || !this->running->load())
+		{
+			return;
+		}
+
+		this->pending.clear();
+		if (!this->outbound->PopBatch(this->pending, this->batching ? this->maxBatchSize : 1, std::chrono::milliseconds(0)))
+		{
+			return;
+		}
+
+		this->writing = true;
+		this->writeStarted = std::chrono::steady_clock::now();
+
+		// Stamped as late as possible, it is t0 of time requests and t2 of time answers
+		auto sentAt = "\"sentAt\":" + std::to_string(MonotonicMicroseconds(this->writeStarted)) + ",";
+		for (auto& message : this->pending)
+		{
+			stampSentAt(message, sentAt);
+		}
+
+		auto onWritten = [this](beast::error_code ec, std::size_t) { this->onWritten(ec); };
+
+		if (this->pending.size() == 1)
+		{
+			this->websocket->async_write(net::buffer(this->pending.front()), onWritten);
+			return;
+		}
+
+		// Everything that piled up goes out as one JSON array frame, gathered without copying
+		this->buffers.clear();
+		for (size_t i = 0; i < this->pending.size(); i++)
+		{
+			this->buffers.push_back(net::buffer(i == 0 ? &opening : &separator, 1));
+			this->buffers.push_back(net::buffer(this->pending[i]));
+		}
+		this->buffers.push_back(net::buffer(&closing, 1));
+
+		this->websocket->async_write(this->buffers, onWritten);
+	}
+
+	/// Inserts field as the first member of a JSON object message
+	static void stampSentAt(std::string& message, std::string const& field)
+	{
+		if (message.size() < 2 || message[0] != '{')
+		{
+			return;
+		}
+
+		message.insert(1, field, 0, message[1] == '}' ? field.size() - 1 : field.size());
+	}
+
+	void onWritten(beast::error_code ec)
+	{
+		this->writing = false;
+
+		if (TracingEnabled())
+		{
+			RecordTraceEvent("websocket write", "websocket", (long long)this->pending.size(), this->writeStarted, std::chrono::steady_clock::now());
+		}
+
+		if (ec)
+		{
+			spdlog::error("Error in websocket writer: {}", ec.message());
+			this->running->store(false);
+
+			// Unblocks the pending read, which ends the session
+			beast::error_code ignored;
+			beast::get_lowest_layer(*this->websocket).shutdown(tcp::socket::shutdown_both, ignored);
+			return;
+		}
+
+		this->writeNext();
+	}
+};
+
+template <typename WebsocketStream>
+class PingHandler {
+
+	WebsocketStream* websocket;
+	net::io_context* ioContext;
+	LinkMonitor* linkMonitor;
+	std::atomic<bool>* running;
+	int pingInterval;
+	int pingsSent;
+	std::chrono::steady_clock::time_point nextPing;
+	/// Set from posting a ping until it was written
+	std::atomic<bool> pingPending;
+
+public:
+	PingHandler(WebsocketStream* ws, net::io_context* ioContext, LinkMonitor* linkMonitor, std::atomic<bool>* running, int pingInterval)
+		: pingPending(false)
+	{
+		this->websocket = ws;
+		this->ioContext = ioContext;
+		this->linkMonitor = linkMonitor;
+		this->running = running;
+		this->pingInterval = pingInterval;
+		this->pingsSent = 0;
+		this->nextPing = std::chrono::steady_clock::now();
+	}
+
+	/// Checks the link once, run periodically by the scheduler
+	bool handlePing()
+	{
+		const int summaryEvery = 60;
+
+		try
+		{
+			if (!this->running->load())
+			{
+				return this->stop();
+			}
+
+			if (this->linkMonitor->IsIdle())
+			{
+				spdlog::error("Ping handler :: Nothing received within idle timeout, dropping connection");
+				return this->stop();
+			}
+
+			// A ping still waiting behind a large write goes out before the next one is sent
+			if (std::chrono::steady_clock::now() < this->nextPing || this->pingPending.load())
+			{
+				return true;
+			}
+
+			this->nextPing += std::chrono::milliseconds(this->pingInterval);
+			this->pingPending = true;
+
+			// The ping is written by the session I/O thread, the scheduler pool never waits for the socket
+			auto payload = this->linkMonitor->NextPingPayload();
+			net::post(*this->ioContext, [this, payload]
+			{
+				this->websocket->async_ping(websocket::ping_data(payload.c_str()), [this](beast::error_code ec)
+				{
+					this->pingPending = false;
+
+					if (ec)
+					{
+						spdlog::error("Error in ping handler: {}", ec.message());
+					}
+				});
+			});
+
+			if (++this->pingsSent % summaryEvery == 0)
+			{
+				this->linkMonitor->LogSummary();
+			}
+
+			return true;
+		}
+		catch (std::exception const& e)
+		{
+			spdlog::error("Error in ping handler: {}", e.what());
+		}
+
+		return this->stop();
+	}
+
+private:
+	bool stop()
+	{
+		this->running->store(false);
+
+		// Unblocks the pending read, which otherwise waits for the next frame indefinitely
+		auto ws = this->websocket;
+		net::post(*this->ioContext, [ws]
+		{
+			beast::error_code ec;
+			beast::get_lowest_layer(*ws).shutdown(tcp::socket::shutdown_both, ec);
+		});
+		return false;
+	}
+};
+
+#ifdef WDS_SIMULATED_HARDWARE
+/// Runs a corpus of update messages through the decode, apply and encode path and
+/// reports how many global allocations each message needed once warmed up. It connects and
+/// ramps the engines, so it only exists against the simulated driver.
+int runAllocationBenchmark(EnginesController* enginesController, PowerController* powerController, HardwareStateStore* stateStore, int iterations)
+{
+	const char* corpus[] = {
+		R"({"type":"update","desiredTemperature":"0","engine1Direction":"1","engine1Speed":"0","engine2Direction":"1","engine2Speed":"0"})",
+		R"({"type":"update","desiredTemperature":"40","engine1Direction":"1","engine1Speed":"2000","engine2Direction":"0","engine2Speed":"1500"})",
+		R"({"type":"update","desiredTemperature":"40","engine1Direction":"1","engine1Speed":"2500","engine2Direction":"0","engine2Speed":"1500"})",
+	};
+
+	enginesController->Connect();
+
+	UpdateHandler updateHandler(enginesController, powerController, stateStore);
+	MessageArena arena;
+
+	for (auto message : corpus)
+	{
+		std::string messageString(message);
+		unsigned long long steadyAllocations = 0;
+
+		for (int i = 0; i <= iterations; i++)
+		{
+			auto before = AllocationCount();
+			{
+				MessageArenaScope arenaScope(arena);
+				auto reply = updateHandler.Process(messageString, enginesController->StopGeneration());
+			}
+			auto allocations = AllocationCount() - before;
+
+			// The first pass changes the hardware state and warms up the arena
+			if (i == 0)
+			{
+				spdlog::info("Allocation benchmark :: first pass {} allocations for {}", allocations, messageString);
+				continue;
+			}
+
+			steadyAllocations += allocations;
+		}
+
+		spdlog::info("Allocation benchmark :: {:.2f} allocations per message in steady state over {} messages",
+			(double)steadyAllocations / iterations, iterations);
+	}
+
+	enginesController->Disconnect();
+	return EXIT_SUCCESS;
+}
+#endif
+
+/// Looks entries up in the "section:rig" section first and falls back to the shared "section"
+class RigSettings {
+
+	ConfigFile* cf;
+	std::string rig;
+
+public:
+	RigSettings(ConfigFile* cf, std::string rig)
+	{
+		this->cf = cf;
+		this->rig = rig;
+	}
+
+	/// Indicates that the rig has its own value for entry
+	bool Overrides(std::string const& section, std::string const& entry) const
+	{
+		if (this->rig.empty())
+		{
+			return false;
+		}
+
+		try
+		{
+			this->cf->Value(section + ":" + this->rig, entry);
+			return true;
+		}
+		catch (const char*)
+		{
+			return false;
+		}
+	}
+
+	std::string Value(std::string const& section, std::string const& entry)
+	{
+		return this->Overrides(section, entry) ? this->cf->Value(section + ":" + this->rig, entry) : this->cf->Value(section, entry);
+	}
+
+	std::string Value(std::string const& section, std::string const& entry, double value)
+	{
+		return this->Overrides(section, entry) ? this->cf->Value(section + ":" + this->rig, entry) : this->cf->Value(section, entry, value);
+	}
+
+	std::string Value(std::string const& section, std::string const& entry, std::string const& value)
+	{
+		return this->Overrides(section, entry) ? this->cf->Value(section + ":" + this->rig, entry) : this->cf->Value(section, entry, value);
+	}
+};
+
+/// Writes the archived rows between from and to (us since the epoch) as CSV
+int exportArchive(std::string const& path, std::string const& csvPath, long long from, long long to)
+{
+	TelemetryArchiveReader reader(path);
+	if (reader.Segments().empty())
+	{
+		spdlog::error("Archive :: No segments found for {}", path);
+		return EXIT_FAILURE;
+	}
+
+	std::ofstream csv(csvPath);
+	csv << "timeUs";
+	for (int channel = 0; channel < TelemetryChannelCount; channel++)
+	{
+		csv << "," << TelemetryChannelName(channel);
+	}
+	csv << "\n";
+
+	auto started = std::chrono::steady_clock::now();
+	auto rows = reader.Scan(from, to, [&csv](ArchiveRow const& row)
+	{
+		csv << row.Time;
+		for (auto value : row.Values)
+		{
+			csv << "," << value;
+		}
+		csv << "\n";
+	});
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+
+	spdlog::info("Archive :: Exported {} rows from {} segments ({} blocks decoded) to {} in {} ms", rows, reader.Segments().size(), reader.BlocksDecoded(), csvPath, elapsed.count());
+	return csv ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Rigs are named by the suffixes of "section:rig" sections, a config without any describes one unnamed rig
+std::vector<std::string> getRigNames(ConfigFile const& cf)
+{
+	std::vector<std::string> names;
+	for (auto const& section : cf.Sections())
+	{
+		auto separator = section.find(':');
+		if (separator == std::string::npos)
+		{
+			continue;
+		}
+
+		auto name = section.substr(separator + 1);
+		if (std::find(names.begin(), names.end(), name) == names.end())
+		{
+			names.push_back(name);
+		}
+	}
+
+	if (names.empty())
+	{
+		names.push_back(std::string());
+	}
+
+	return names;
+}
+
+/// One rig with its own devices and upstream session. Rigs only share the scheduler pool,
+/// a failing device or dropped connection of one rig does not affect the others.
+class Rig {
+
+	std::string name;
+	PeriodicScheduler* scheduler;
+	std::string tracePath;
+
+	std::string host;
+	std::string port;
+	std::string arduinoPortName;
+	std::string arduinoPortBaudrate;
+	std::string arduinoProtocol;
+	std::string arduinoSampleRate;
+	std::string arduinoChannels;
+	std::string pingInterval;
+	std::string idleTimeout;
+	std::string rttThreshold;
+	std::string queueDepthThreshold;
+	std::string minTelemetryInterval;
+	std::string maxTelemetryInterval;
+	std::string batching;
+	std::string maxBatchSize;
+	std::string outboundCapacity;
+	std::string clockSyncInterval;
+	std::string telemetryInterval;
+	std::string telemetryStreamInterval;
+	std::string historyChunkSize;
+	std::string historyQueueDepth;
+
+	/// Set if the rig connects with wss, the cache keeps the session ticket across reconnects
+	std::unique_ptr<net::ssl::context> sslContext;
+	std::unique_ptr<TlsSessionCache> sessionCache;
+	bool verifyPeer;
+	unsigned long tlsHandshakes;
+	unsigned long tlsResumptions;
+
+	HardwareStateStore stateStore;
+	net::io_service io;
+	std::unique_ptr<StateCheckpoint> checkpoint;
+	std::unique_ptr<EnginesController> enginesController;
+	std::unique_ptr<PowerController> powerController;
+	std::unique_ptr<MotionProgramRunner> programRunner;
+	std::unique_ptr<SharedMemoryInterface> sharedMemory;
+	/// Recorded across sessions so a reconnected server can backfill, null if disabled
+	std::unique_ptr<TelemetryHistory> history;
+	int historySubscription;
+	/// Every published state is appended, null if disabled
+	std::unique_ptr<TelemetryArchive> archive;
+	int archiveSubscription;
+
+	std::atomic<bool> stopRequested;
+
+public:
+	/// Reads the rig configuration and opens its devices, throws if a device cannot be opened
+	Rig(ConfigFile* cf, std::string name, PeriodicScheduler* scheduler, std::string tracePath)
+	{
+		RigSettings settings(cf, name);
+
+		this->name = name.empty() ? std::string("default") : name;
+		this->scheduler = scheduler;
+		this->tracePath = tracePath;
+		this->stopRequested = false;
+
+		this->host = settings.Value("connection", "host");
+		this->port = settings.Value("connection", "port");
+		std::string enginesPortNo = settings.Value("serial ports", "enginesPortNo");
+		std::string enginesPortBaudrate = settings.Value("serial ports", "enginesPortBaudrate");
+		this->arduinoPortName = settings.Value("serial ports", "arduinoPortName");
+		this->arduinoPortBaudrate = settings.Value("serial ports", "arduinoPortBaudrate");
+		this->arduinoProtocol = settings.Value("arduino", "protocol", "ascii");
+		this->arduinoSampleRate = settings.Value("arduino", "sampleRate", 10);
+		this->arduinoChannels = settings.Value("arduino", "channels", 1);
+		std::string powerSupplyPortName = settings.Value("serial ports", "powerSupplyPortName");
+		std::string powerSupplyPortBaudrate = settings.Value("serial ports", "powerSupplyPortBaudrate");
+		this->pingInterval = settings.Value("connection", "pingInterval", 1000);
+		this->idleTimeout = settings.Value("connection", "idleTimeout", 5000);
+		this->rttThreshold = settings.Value("connection", "rttThreshold", 200);
+		this->queueDepthThreshold = settings.Value("connection", "queueDepthThreshold", 64);
+		this->minTelemetryInterval = settings.Value("connection", "minTelemetryInterval", 0);
+		this->maxTelemetryInterval = settings.Value("connection", "maxTelemetryInterval", 2000);
+		this->batching = settings.Value("connection", "batching", 1);
+		this->maxBatchSize = settings.Value("connection", "maxBatchSize", 32);
+		this->outboundCapacity = settings.Value("connection", "outboundCapacity", 256);
+		this->clockSyncInterval = settings.Value("connection", "clockSyncInterval", 5000);
+		std::string tls = settings.Value("connection", "tls", 0);
+		std::string caFile = settings.Value("connection", "caFile", "");
+		std::string verifyPeer = settings.Value("connection", "verifyPeer", 1);
+
+		std::string engine1SlaveNo = settings.Value("engines", "engine1SlaveNo");
+		std::string engine2SlaveNo = settings.Value("engines", "engine2SlaveNo"); 
+		std::string engine1EasyStart = settings.Value("engines", "engine1EasyStart");
+		std::string engine2EasyStart = settings.Value("engines", "engine2EasyStart");
+		std::string engine1EasyStop = settings.Value("engines", "engine1EasyStop");
+		std::string engine2EasyStop = settings.Value("engines", "engine2EasyStop");
+		std::string engine1EasyChange = settings.Value("engines", "engine1EasyChange");
+		std::string engine2EasyChange = settings.Value("engines", "engine2EasyChange"); 
+
+		std::string gearingEnabled = settings.Value("gearing", "enabled", 0);
+		std::string gearingMaster = settings.Value("gearing", "master", 1);
+		std::string gearingRatio = settings.Value("gearing", "ratio", 1);
+		std::string gearingOffset = settings.Value("gearing", "offset", 0);
+		std::string gearingInverted = settings.Value("gearing", "invert", 0);
+
+		std::string rampTickInterval = settings.Value("scheduler", "rampTickInterval", 10000);
+		std::string velocityPollInterval = settings.Value("scheduler", "velocityPollInterval", 100);
+		this->telemetryInterval = settings.Value("scheduler", "telemetryInterval", 5);
+		this->telemetryStreamInterval = settings.Value("scheduler", "telemetryStreamInterval", 10);
+
+		std::string historySamples = settings.Value("history", "samples", 36000);
+		this->historyChunkSize = settings.Value("history", "chunkSize", 500);
+		this->historyQueueDepth = settings.Value("history", "maxQueueDepth", 16);
+
+		std::string archiveEnabled = settings.Value("archive", "enabled", 0);
+		std::string archivePath = settings.Value("archive", "path", "archive/telemetry");
+		std::string archiveSegmentSize = settings.Value("archive", "segmentSize", 64);
+		std::string archiveMaxSegments = settings.Value("archive", "maxSegments", 0);
+		std::string archiveFlushInterval = settings.Value("archive", "flushInterval", 5000);
+
+		if (!name.empty() && !settings.Overrides("archive", "path"))
+		{
+			archivePath += "_" + name;
+		}
+
+		std::string programMaxSpeed = settings.Value("programs", "maxSpeed", 20000);
+		std::string programMaxTemperature = settings.Value("programs", "maxTemperature", 150);
+		std::string programMaxSteps = settings.Value("programs", "maxSteps", 10000);
+
+		std::string sharedMemoryEnabled = settings.Value("shared memory", "enabled", 0);
+		std::string sharedMemoryName = settings.Value("shared memory", "name", "wds_controller");
+
+		// Rigs sharing the default block name would attach to each other's block
+		if (!name.empty() && !settings.Overrides("shared memory", "name"))
+		{
+			sharedMemoryName += "_" + name;
+		}
+
+		std::string checkpointEnabled = settings.Value("checkpoint", "enabled", 0);
+		std::string checkpointPath = settings.Value("checkpoint", "path", "checkpoint.bin");
+		std::string velocityTolerance = settings.Value("checkpoint", "velocityTolerance", 0);
+
+		if (!name.empty() && !settings.Overrides("checkpoint", "path"))
+		{
+			auto extension = checkpointPath.find_last_of('.');
+			checkpointPath.insert(extension == std::string::npos ? checkpointPath.size() : extension, "_" + name);
+		}
+
+		if (std::stoi(checkpointEnabled) != 0)
+		{
+			this->checkpoint.reset(new StateCheckpoint(checkpointPath));
+		}
+
+		this->verifyPeer = std::stoi(verifyPeer) != 0;
+		this->tlsHandshakes = 0;
+		this->tlsResumptions = 0;
+
+		if (std::stoi(tls) != 0)
+		{
+			this->sslContext.reset(new net::ssl::context(net::ssl::context::tls_client));
+			SSL_CTX_set_min_proto_version(this->sslContext->native_handle(), TLS1_2_VERSION);
+
+			if (this->verifyPeer)
+			{
+				this->sslContext->set_verify_mode(net::ssl::verify_peer);
+
+				// A self-signed stand-in server is trusted by pointing caFile at its certificate
+				if (caFile.empty())
+				{
+					this->sslContext->set_default_verify_paths();
+				}
+				else
+				{
+					this->sslContext->load_verify_file(caFile);
+				}
+			}
+			else
+			{
+				spdlog::warn("Rig {} :: TLS peer verification is disabled", this->name);
+				this->sslContext->set_verify_mode(net::ssl::verify_none);
+			}
+
+			this->sessionCache.reset(new TlsSessionCache(this->sslContext.get()));
+		}
+
+		auto rigName = this->name;
+		this->stateStore.Subscribe([rigName](HardwareSnapshot const& snapshot)
+		{
+			spdlog::debug("Hardware state :: {} version {} e1s: {} e2s: {} dt: {} ct: {}", rigName, snapshot.Version, snapshot.Engine1Speed.Value, snapshot.Engine2Speed.Value, snapshot.DesiredTemperature.Value, snapshot.CurrentTemperature.Value);
+		});
+
+		this->enginesController.reset(new EnginesController(
+			std::stoi(enginesPortNo),
+			std::stoi(enginesPortBaudrate),
+			std::stoi(engine1SlaveNo),
+			std::stoi(engine2SlaveNo),
+			std::stoi(engine1EasyStart),
+			std::stoi(engine2EasyStart),
+			std::stoi(engine1EasyStop),
+			std::stoi(engine2EasyStop),
+			std::stoi(engine1EasyChange),
+			std::stoi(engine2EasyChange),
+			&this->stateStore,
+			scheduler,
+			this->checkpoint.get()
+		));
+		this->enginesController->SetRampTickInterval(std::chrono::microseconds(std::stoi(rampTickInterval)));
+		this->enginesController->SetVelocityPollInterval(std::chrono::milliseconds(std::stoi(velocityPollInterval)));
+		this->enginesController->SetVelocityTolerance(std::stoi(velocityTolerance));
+
+		AxisGearing gearing;
+		gearing.Enabled = std::stoi(gearingEnabled) != 0;
+		gearing.Master = std::stoi(gearingMaster);
+		gearing.Ratio = std::stod(gearingRatio);
+		gearing.Offset = std::stoi(gearingOffset);
+		gearing.Inverted = std::stoi(gearingInverted) != 0;
+		this->enginesController->SetGearing(gearing);
+
+		this->powerController.reset(new PowerController(powerSupplyPortName, std::stoi(powerSupplyPortBaudrate), &this->io, &this->stateStore, scheduler, this->checkpoint.get()));
+
+		MotionProgramLimits programLimits;
+		programLimits.MaxSpeed = std::stoi(programMaxSpeed);
+		programLimits.MaxTemperature = std::stoi(programMaxTemperature);
+		programLimits.MaxSegments = std::stoi(programMaxSteps);
+		this->programRunner.reset(new MotionProgramRunner(this->enginesController.get(), this->powerController.get(), &this->stateStore, scheduler, std::chrono::microseconds(std::stoi(rampTickInterval)), programLimits));
+
+		// Outlives the websocket sessions, local clients keep working while the server is unreachable
+		if (std::stoi(sharedMemoryEnabled) != 0)
+		{
+			this->sharedMemory.reset(new SharedMemoryInterface(sharedMemoryName, this->enginesController.get(), this->powerController.get(), &this->stateStore));
+		}
+
+		// Drives that kept running through a restart are taken over without ramping them again
+		this->enginesController->ResumeFromCheckpoint();
+
+		if (std::stoi(historySamples) > 0)
+		{
+			// Thermocouples are recorded by the arduino handler, every other field when it changes
+			this->history.reset(new TelemetryHistory(std::stoul(historySamples)));
+			auto history = this->history.get();
+			history->Record(*this->stateStore.Current());
+			this->historySubscription = this->stateStore.Subscribe([history](HardwareSnapshot const& snapshot)
+			{
+				history->Record(snapshot);
+			});
+		}
+
+		if (std::stoi(archiveEnabled) != 0)
+		{
+			this->archive.reset(new TelemetryArchive(archivePath, std::stoul(archiveSegmentSize) * 1024 * 1024, std::stoi(archiveMaxSegments), std::chrono::milliseconds(std::stoi(archiveFlushInterval))));
+			auto archive = this->archive.get();
+			// Unlike the websocket timestamps on wall clock time, an archive spans restarts of the controller.
+			// Thermocouples are archived by the arduino handler, every other field when it changes.
+			auto archiveSnapshot = [archive](HardwareSnapshot const& snapshot)
+			{
+				auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch());
+				archive->Append(snapshot, now.count());
+			};
+			archiveSnapshot(*this->stateStore.Current());
+			this->archiveSubscription = this->stateStore.Subscribe(archiveSnapshot);
+		}
+	}
+
+	~Rig()
+	{
+		if (this->history)
+		{
+			this->stateStore.Unsubscribe(this->historySubscription);
+		}
+
+		if (this->archive)
+		{
+			this->stateStore.Unsubscribe(this->archiveSubscription);
+		}
+	}
+
+	Rig(const Rig&) = delete;
+	Rig& operator=(const Rig&) = delete;
+
+	std::string const& Name() const
+	{
+		return this->name;
+	}
+
+#ifdef WDS_SIMULATED_HARDWARE
+	int RunAllocationBenchmark(int iterations)
+	{
+		return runAllocationBenchmark(this->enginesController.get(), this->powerController.get(), &this->stateStore, iterations);
+	}
+#endif
+
+	/// Keeps the upstream session of the rig connected until Stop is called
+	void Run()
+	{
+		while (!this->stopRequested)
+		{ 
+			try
+			{ 
+				this->RunSession();
+			}
+			catch (std::exception const& e)
+			{		
+				spdlog::error("Rig {} :: Error: {} ", this->name, e.what()); 
+			} 
+
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+		}
+	}
+
+	/// Makes Run return once the current session ended
+	void Stop()
+	{
+		this->stopRequested = true;
+	}
+
+private:
+	void RunSession()
+	{
+		// The io_context is required for all I/O
+		net::io_context ioc;
+
+		if (this->sslContext)
+		{
+			websocket::stream<beast::ssl_stream<tcp::socket>> ws{ ioc, *this->sslContext };
+			this->RunSession(ioc, ws);
+		}
+		else
+		{
+			websocket::stream<tcp::socket> ws{ ioc };
+			this->RunSession(ioc, ws);
+		}
+	}
+
+	bool HandshakeTls(websocket::stream<tcp::socket>&)
+	{
+		return false;
+	}
+
+	/// Returns whether the cached session was resumed
+	bool HandshakeTls(websocket::stream<beast::ssl_stream<tcp::socket>>& ws)
+	{
+		auto connection = ws.next_layer().native_handle();
+
+		// Servers hosting several names pick the certificate from the SNI
+		if (!SSL_set_tlsext_host_name(connection, this->host.c_str()))
+		{
+			throw beast::system_error(beast::error_code(static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()));
+		}
+
+		if (this->verifyPeer)
+		{
+			ws.next_layer().set_verify_callback(net::ssl::host_name_verification(this->host));
+		}
+
+		this->sessionCache->Prepare(connection);
+
+		try
+		{
+			ws.next_layer().handshake(net::ssl::stream_base::client);
+		}
+		catch (std::exception const&)
+		{
+			// A rejected ticket is not offered again
+			this->sessionCache->Clear();
+			throw;
+		}
+
+		bool resumed = SSL_session_reused(connection) == 1;
+		this->tlsHandshakes++;
+		if (resumed)
+		{
+			this->tlsResumptions++;
+		}
+
+		return resumed;
+	}
+
+	template <typename WebsocketStream>
+	void RunSession(net::io_context& ioc, WebsocketStream& ws)
+	{
+		// These objects perform our I/O
+		tcp::resolver resolver{ ioc };
+		
+		// Look up the domain name
+		auto const results = resolver.resolve(this->host, this->port);   
+
+		spdlog::info("Rig {} :: Attempting to connect websocket server {} on port {}{}", this->name, this->host, this->port, this->sslContext ? " over TLS" : "");
+		// Make the connection on the IP address we get from a lookup
+		auto connectStarted = std::chrono::steady_clock::now();
+		net::connect(beast::get_lowest_layer(ws), results.begin(), results.end());
+		auto connected = std::chrono::steady_clock::now();
+
+		bool resumed = this->HandshakeTls(ws);
+		auto secured = std::chrono::steady_clock::now();
+
+		bool offerBatching = std::stoi(this->batching) != 0;
+
+		// Set a decorator to change the User-Agent of the handshake
+		ws.set_option(websocket::stream_base::decorator([offerBatching](websocket::request_type& req)
+		{
+			req.set(http::field::user_agent,
+				std::string(BOOST_BEAST_VERSION_STRING) +
+				" websocket-client-coro" + " wds-hardware-controller");
+
+			if (offerBatching)
+			{
+				req.set(BatchingHeader, "1");
+			}
+		}));
+
+		// Perform the websocket handshake
+		websocket::response_type handshakeResponse;
+		ws.handshake(handshakeResponse, this->host, "/"); 
+		auto upgraded = std::chrono::steady_clock::now();
+
+		// Batches are only sent if the server echoed the batching header back
+		bool batchingAccepted = offerBatching && handshakeResponse[BatchingHeader] == "1";
+
+		auto tcpTime = std::chrono::duration_cast<std::chrono::microseconds>(connected - connectStarted);
+		auto tlsTime = std::chrono::duration_cast<std::chrono::microseconds>(secured - connected);
+		auto websocketTime = std::chrono::duration_cast<std::chrono::microseconds>(upgraded - secured);
+		
+		spdlog::info("Rig {} :: Successfully connected to websocket server {} on port {} (batching {})", this->name, this->host, this->port, batchingAccepted ? "on" : "off");  
+		if (this->sslContext)
+		{
+			spdlog::info("Rig {} :: Connected in {} us (tcp {} us, tls {} us {}, websocket {} us), {} of {} TLS handshakes resumed",
+				this->name, (tcpTime + tlsTime + websocketTime).count(), tcpTime.count(), tlsTime.count(), resumed ? "resumed" : "full", websocketTime.count(), this->tlsResumptions, this->tlsHandshakes);
+		}
+
+		LinkMonitor linkMonitor(
+			std::stoi(this->idleTimeout),
+			std::stoi(this->rttThreshold),
+			std::stoi(this->queueDepthThreshold),
+			std::stoi(this->minTelemetryInterval),
+			std::stoi(this->maxTelemetryInterval)
+		);
+		linkMonitor.OnConnected(tcpTime, tlsTime, websocketTime, resumed);
+
+		ws.control_callback([&linkMonitor](websocket::frame_type kind, beast::string_view payload)
+		{
+			if (kind == websocket::frame_type::pong)
+			{
+				linkMonitor.OnPong(std::string(payload.data(), payload.size()));
+			}
+			else
+			{
+				linkMonitor.OnFrameReceived();
+			}
+		});
+
+		std::atomic<bool> running(true);
+		SensorRing arduinoSamples;
+		OutboundQueue outbound(std::stoul(this->outboundCapacity));
+		TelemetryStream telemetryStream(&this->stateStore, &linkMonitor, &outbound);
+		HistoryStream historyStream(this->history.get(), &outbound, std::stoul(this->historyChunkSize), std::stoul(this->historyQueueDepth));
+		ClockSync clockSync;
+
+		this->programRunner->SetListener([&outbound](MotionProgramStatus const& status)
+		{
+			MessageParser messageParser;
+			outbound.Push(messageParser.ParseToProgramStatus(status), OutboundType::Reply);
+		});
+
+		// Websocket I/O runs on the message handler thread and serial I/O on its own, periodic work runs on the shared pool
+		WebsocketWriter<WebsocketStream> writer(&ws, &ioc, &outbound, &running, batchingAccepted, std::stoul(this->maxBatchSize));
+		writer.start();
+		std::thread t(&MessageHandler<WebsocketStream>::handleMessages, MessageHandler<WebsocketStream>(&ws, &ioc, &outbound, this->enginesController.get(), this->powerController.get(), &this->stateStore, &linkMonitor, &telemetryStream, &historyStream, &clockSync, this->programRunner.get(), &running, this->tracePath));  
+		std::thread t2(&ArduinoHandler::handleSerial, ArduinoHandler(&arduinoSamples, &this->stateStore, this->history.get(), this->archive.get(), &running, this->arduinoPortName, std::stoi(this->arduinoPortBaudrate), this->arduinoProtocol == "binary", std::stoi(this->arduinoSampleRate), (unsigned char)std::stoi(this->arduinoChannels)));
+		TelemetryHandler telemetryHandler(&outbound, &arduinoSamples, &linkMonitor, &telemetryStream, &running);
+		auto telemetryTask = this->scheduler->Add("telemetry", std::chrono::milliseconds(std::stoi(this->telemetryInterval)), [&telemetryHandler]
+		{
+			return telemetryHandler.handleTelemetry();
+		});
+		auto telemetryStreamTask = this->scheduler->Add("telemetry stream", std::chrono::milliseconds(std::stoi(this->telemetryStreamInterval)), [&telemetryStream]
+		{
+			return telemetryStream.Tick();
+		});
+		auto historyStreamTask = this->scheduler->Add("history stream", std::chrono::milliseconds(std::stoi(this->telemetryStreamInterval)), [&historyStream]
+		{
+			return historyStream.Tick();
+		});
+		// Runs right away, so controller timestamps can be placed on the server clock early in the session
+		PeriodicScheduler::TaskId clockSyncTask = 0;
+		bool clockSyncEnabled = std::stoi(this->clockSyncInterval) > 0;
+		if (clockSyncEnabled)
+		{
+			clockSyncTask = this->scheduler->Add("clock sync", std::chrono::milliseconds(std::stoi(this->clockSyncInterval)), [&outbound]
+			{
+				MessageParser messageParser;
+				outbound.Push(messageParser.ParseToTimeRequest(), OutboundType::Reply);
+				return true;
+			});
+		}
+		PingHandler<WebsocketStream> pingHandler(&ws, &ioc, &linkMonitor, &running, std::stoi(this->pingInterval));
+		auto pingTask = this->scheduler->Add("ping", std::chrono::milliseconds(50), [&pingHandler]
+		{
+			return pingHandler.handlePing();
+		});
+
+		t.join(); 
+		t2.join();
+		this->scheduler->Remove(telemetryTask);
+		this->scheduler->Remove(telemetryStreamTask);
+		this->scheduler->Remove(historyStreamTask);
+		if (clockSyncEnabled)
+		{
+			this->scheduler->Remove(clockSyncTask);
+		}
+		this->scheduler->Remove(pingTask);
+		writer.stop();
+		this->programRunner->SetListener(MotionProgramRunner::Listener());
+		linkMonitor.LogSummary();
+		clockSync.LogSummary();
+		outbound.LogSummary();
+	}
+};
+
+// Sends a WebSocket message and prints the response
+int main(int argc, char** argv)
+{
+	try {  
+		// Reads an archive without starting any rig
+		if (argc > 3 && std::string(argv[1]) == "--export-archive")
+		{
+			long long from = argc > 4 ? std::stoll(argv[4]) : 0;
+			long long to = argc > 5 ? std::stoll(argv[5]) : std::numeric_limits<long long>::max();
+			return exportArchive(argv[2], argv[3], from, to);
+		}
+
+#ifndef WDS_SIMULATED_HARDWARE
+		// The benchmark ramps the engines and sets the supply, it must never reach real hardware
+		if (argc > 1 && std::string(argv[1]) == "--alloc-bench")
+		{
+			spdlog::error("--alloc-bench is only available with the simulated hardware driver (soak_controller)");
+			return EXIT_FAILURE;
+		}
+#endif
+
+		// Soak runs read their own configuration, which points the rigs at the local stand-in
+		bool soak = argc > 1 && std::string(argv[1]) == "--soak";
+		ConfigFile cf(soak && argc > 2 ? argv[2] : "config.txt"); 
+
+		std::string schedulerCpu = cf.Value("scheduler", "cpu", -1);
+		std::string schedulerPriority = cf.Value("scheduler", "priority", 0);
+		std::string schedulerThreads = cf.Value("scheduler", "threads", 0);
+		std::string statisticsInterval = cf.Value("scheduler", "statisticsInterval", 60);
+
+		std::string tracingEnabled = cf.Value("tracing", "enabled", 0);
+		std::string traceEventsPerThread = cf.Value("tracing", "eventsPerThread", 16384);
+		std::string tracePath = cf.Value("tracing", "path", "trace.json");
+
+		SetTraceBufferSize(std::stoul(traceEventsPerThread));
+		SetTracingEnabled(std::stoi(tracingEnabled) != 0);
+
+		// Ramps, polling, telemetry and pings of all rigs share one pool
+		PeriodicScheduler scheduler(std::stoi(schedulerCpu), std::stoi(schedulerPriority), std::stoi(schedulerThreads));
+		scheduler.Add("statistics", std::chrono::seconds(std::stoi(statisticsInterval)), [&scheduler]
+		{
+			scheduler.LogStatistics();
+			return true;
+		});
+
+		// The stand-in listens before the rigs start connecting to it
+		std::unique_ptr<SoakHarness> soakHarness;
+		if (soak)
+		{
+			std::string soakPort = cf.Value("soak", "port", 8080);
+			std::string soakDuration = cf.Value("soak", "duration", 14400);
+			std::string soakWarmup = cf.Value("soak", "warmup", 300);
+			std::string soakSampleInterval = cf.Value("soak", "sampleInterval", 60);
+			std::string soakReconnectInterval = cf.Value("soak", "reconnectInterval", 30);
+			std::string soakMessageInterval = cf.Value("soak", "messageInterval", 20);
+			std::string soakMaxResidentGrowth = cf.Value("soak", "maxResidentGrowth", 32);
+			std::string soakMaxThreadGrowth = cf.Value("soak", "maxThreadGrowth", 4);
+			std::string soakMaxHandleGrowth = cf.Value("soak", "maxHandleGrowth", 32);
+			std::string soakMaxLatencyGrowth = cf.Value("soak", "maxLatencyGrowth", 2);
+			std::string soakSamplesPath = cf.Value("soak", "samplesPath", "soak.csv");
+			std::string soakTls = cf.Value("soak", "tls", 0);
+			std::string soakCertificateFile = cf.Value("soak", "certificateFile", "soak-cert.pem");
+
+			SoakSettings soakSettings;
+			soakSettings.Port = std::stoi(soakPort);
+			soakSettings.Duration = std::chrono::seconds(std::stoi(soakDuration));
+			soakSettings.Warmup = std::chrono::seconds(std::stoi(soakWarmup));
+			soakSettings.SampleInterval = std::chrono::seconds(std::stoi(soakSampleInterval));
+			soakSettings.ReconnectInterval = std::chrono::seconds(std::stoi(soakReconnectInterval));
+			soakSettings.MessageInterval = std::chrono::milliseconds(std::stoi(soakMessageInterval));
+			soakSettings.MaxResidentGrowth = std::stoul(soakMaxResidentGrowth) * 1024 * 1024;
+			soakSettings.MaxThreadGrowth = std::stoi(soakMaxThreadGrowth);
+			soakSettings.MaxHandleGrowth = std::stoi(soakMaxHandleGrowth);
+			soakSettings.MaxLatencyGrowth = std::stod(soakMaxLatencyGrowth);
+			soakSettings.SamplesPath = soakSamplesPath;
+			soakSettings.Tls = std::stoi(soakTls) != 0;
+			soakSettings.CertificateFile = soakCertificateFile;
+
+			soakHarness.reset(new SoakHarness(soakSettings));
+			soakHarness->Start();
+		}
+
+		std::vector<std::unique_ptr<Rig>> rigs;
+		for (auto const& name : getRigNames(cf))
+		{
+			try
+			{
+				rigs.emplace_back(new Rig(&cf, name, &scheduler, tracePath));
+			}
+			catch (std::exception const& e)
+			{
+				spdlog::error("Rig {} :: Not started: {}", name.empty() ? "default" : name, e.what());
+			}
+		}
+
+		if (rigs.empty())
+		{
+			spdlog::error("No rig could be started");
+			return EXIT_FAILURE;
+		}
+
+#ifdef WDS_SIMULATED_HARDWARE
+		if (argc > 1 && std::string(argv[1]) == "--alloc-bench")
+		{
+			return rigs.front()->RunAllocationBenchmark(argc > 2 ? std::stoi(argv[2]) : 1000);
+		}
+#endif
+
+		std::vector<std::thread> sessions;
+		for (auto& rig : rigs)
+		{
+			spdlog::info("Rig {} :: Started", rig->Name());
+			sessions.push_back(std::thread(&Rig::Run, rig.get()));
+		}
+
+		if (soakHarness)
+		{
+			bool passed = soakHarness->Run();
+
+			// Closing the stand-in ended the sessions, the rigs must not reconnect
+			for (auto& rig : rigs)
+			{
+				rig->Stop();
+			}
+			for (auto& session : sessions)
+			{
+				session.join();
+			}
+
+			return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		for (auto& session : sessions)
+		{
+			session.join();
 		}
 	}
 	catch (std::exception const& e)
@@ -234,4 +1854,4 @@ int main(int argc, char** argv)
 	} 
 
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+/// Lock-free single-producer/single-consumer ring buffer of fixed-size records.
+/// The producer never blocks: when the ring is full the record is dropped and counted.
+template <typename T, size_t Capacity>
+class SpscRing
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+	SpscRing() : head(0), tail(0), overflows(0)
+	{
+	}
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	/// Called by the producer only. Returns false if the record was dropped.
+	bool Push(T const& record)
+	{
+		size_t currentTail = this->tail.load(std::memory_order_relaxed);
+
+		if (currentTail - this->head.load(std::memory_order_acquire) == Capacity)
+		{
+			this->overflows.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		this->records[currentTail & (Capacity - 1)] = record;
+		this->tail.store(currentTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Called by the consumer only. Copies up to maxCount records and returns how many were taken.
+	size_t PopBatch(T* out, size_t maxCount)
+	{
+		size_t currentHead = this->head.load(std::memory_order_relaxed);
+		size_t available = this->tail.load(std::memory_order_acquire) - currentHead;
+		size_t count = available < maxCount ? available : maxCount;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i] = this->records[(currentHead + i) & (Capacity - 1)];
+		}
+
+		this->head.store(currentHead + count, std::memory_order_release);
+		return count;
+	}
+
+	/// Number of records waiting to be consumed
+	size_t Size() const
+	{
+		return this->tail.load(std::memory_order_acquire) - this->head.load(std::memory_order_acquire);
+	}
+
+	/// Total number of records dropped because the ring was full
+	unsigned long long Overflows() const
+	{
+		return this->overflows.load(std::memory_order_relaxed);
+	}
+
+private:
+	/// Index of the next record to consume, written by the consumer
+	alignas(64) std::atomic<size_t> head;
+	/// Index of the next free slot, written by the producer
+	alignas(64) std::atomic<size_t> tail;
+	/// Records dropped on a full ring
+	alignas(64) std::atomic<unsigned long long> overflows;
+
+	T records[Capacity];
+};
@@ -0,0 +1,153 @@
+#include "StateCheckpoint.h"
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+namespace ipc = boost::interprocess;
+
+namespace
+{
+	const uint32_t CheckpointMagic = 0x57445343;
+}
+
+StateCheckpoint::StateCheckpoint(std::string path)
+	: path(path),
+	layout(nullptr),
+	sequence(0)
+{
+	// The mapping needs the file to exist with its final size
+	{
+		std::fstream stream(this->path, std::ios::in | std::ios::out | std::ios::binary);
+		if (!stream)
+		{
+			stream.open(this->path, std::ios::out | std::ios::binary | std::ios::trunc);
+		}
+
+		stream.seekp(0, std::ios::end);
+		auto size = (size_t)stream.tellp();
+		if (size < sizeof(Layout))
+		{
+			std::string padding(sizeof(Layout) - size, '\0');
+			stream.write(padding.data(), padding.size());
+		}
+	}
+
+	this->file = ipc::file_mapping(this->path.c_str(), ipc::read_write);
+	this->region = ipc::mapped_region(this->file, ipc::read_write, 0, sizeof(Layout));
+	this->layout = static_cast<Layout*>(this->region.get_address());
+
+	if (this->layout->Magic != CheckpointMagic || this->layout->LayoutVersion != LayoutVersion)
+	{
+		spdlog::info("State checkpoint :: No checkpoint in {}, starting cold", this->path);
+		*this->layout = Layout();
+		this->layout->Magic = CheckpointMagic;
+		this->layout->LayoutVersion = LayoutVersion;
+		return;
+	}
+
+	// The newest slot with a matching checksum wins
+	Slot const* newest = nullptr;
+	for (auto const& slot : this->layout->Slots)
+	{
+		if (slot.Sequence != 0 && slot.Checksum == Checksum(slot) && (newest == nullptr || slot.Sequence > newest->Sequence))
+		{
+			newest = &slot;
+		}
+	}
+
+	if (newest == nullptr)
+	{
+		spdlog::warn("State checkpoint :: Checkpoint in {} is damaged, starting cold", this->path);
+		return;
+	}
+
+	this->sequence = newest->Sequence;
+	this->restored.Valid = true;
+	this->restored.EnginesConnected = newest->EnginesConnected != 0;
+	this->restored.Engine1Speed = newest->Engine1Speed;
+	this->restored.Engine1Direction = newest->Engine1Direction;
+	this->restored.Engine2Speed = newest->Engine2Speed;
+	this->restored.Engine2Direction = newest->Engine2Direction;
+	this->restored.SupplyConfigured = newest->SupplyConfigured != 0;
+	this->restored.SupplyTemperature = newest->SupplyTemperature;
+	this->current = this->restored;
+
+	spdlog::info("State checkpoint :: Restored checkpoint {} from {} (engines {} e1s: {} e2s: {} supply {} at {})",
+		this->sequence, this->path, this->restored.EnginesConnected ? "connected" : "disconnected", this->restored.Engine1Speed, this->restored.Engine2Speed,
+		this->restored.SupplyConfigured ? "configured" : "unconfigured", this->restored.SupplyTemperature);
+}
+
+CheckpointState StateCheckpoint::Restored() const
+{
+	return this->restored;
+}
+
+void StateCheckpoint::SetEngines(bool connected, int engine1Speed, int engine1Direction, int engine2Speed, int engine2Direction)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->current.EnginesConnected = connected;
+	this->current.Engine1Speed = engine1Speed;
+	this->current.Engine1Direction = engine1Direction;
+	this->current.Engine2Speed = engine2Speed;
+	this->current.Engine2Direction = engine2Direction;
+	this->Write();
+}
+
+void StateCheckpoint::SetSupply(bool configured, int temperature)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->current.SupplyConfigured = configured;
+	this->current.SupplyTemperature = temperature;
+	this->Write();
+}
+
+StateCheckpoint::~StateCheckpoint()
+{
+	if (!this->region.flush(0, 0, true))
+	{
+		spdlog::error("State checkpoint :: Flushing {} to disk failed", this->path);
+	}
+}
+
+void StateCheckpoint::Write()
+{
+	Slot slot;
+	slot.Sequence = this->sequence + 1;
+	slot.EnginesConnected = this->current.EnginesConnected ? 1 : 0;
+	slot.Engine1Speed = this->current.Engine1Speed;
+	slot.Engine1Direction = this->current.Engine1Direction;
+	slot.Engine2Speed = this->current.Engine2Speed;
+	slot.Engine2Direction = this->current.Engine2Direction;
+	slot.SupplyConfigured = this->current.SupplyConfigured ? 1 : 0;
+	slot.SupplyTemperature = this->current.SupplyTemperature;
+
+	// Motion programs command the engines on every tick, mostly with unchanged values
+	auto const& newest = this->layout->Slots[this->sequence % 2];
+	if (this->sequence != 0 && std::memcmp(&slot.EnginesConnected, &newest.EnginesConnected, offsetof(Slot, Checksum) - offsetof(Slot, EnginesConnected)) == 0)
+	{
+		return;
+	}
+
+	slot.Checksum = Checksum(slot);
+	this->layout->Slots[slot.Sequence % 2] = slot;
+	this->sequence = slot.Sequence;
+
+	// Pages reach the file even if the process crashes. Against losing the machine the write-back is only
+	// started: a ramp changes the setpoints every tick, which must not wait for the disk.
+	this->region.flush(0, 0, false);
+}
+
+uint32_t StateCheckpoint::Checksum(Slot const& slot)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	auto bytes = reinterpret_cast<const unsigned char*>(&slot);
+	for (size_t i = 0; i < offsetof(Slot, Checksum); i++)
+	{
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+
+	return hash;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+/// Commanded hardware state as last checkpointed
+class CheckpointState
+{
+public:
+	CheckpointState()
+		: Valid(false), EnginesConnected(false), Engine1Speed(0), Engine1Direction(1), Engine2Speed(0), Engine2Direction(1), SupplyConfigured(false), SupplyTemperature(0)
+	{
+	}
+
+	/// False if no checkpoint was found or it could not be read
+	bool Valid;
+	bool EnginesConnected;
+	int Engine1Speed;
+	int Engine1Direction;
+	int Engine2Speed;
+	int Engine2Direction;
+	/// Set once the power supply was initialized and every started voltage sequence completed
+	bool SupplyConfigured;
+	/// Temperature the supply voltage was last set for
+	int SupplyTemperature;
+};
+
+/// Keeps the commanded engine and power supply state in a small memory-mapped file, so that
+/// a restarted controller resumes from it instead of cold-starting hardware that kept running.
+/// Writes alternate between two checksummed slots, a write torn by a crash leaves the previous one intact.
+class StateCheckpoint
+{
+public:
+	/// Opens or creates the checkpoint file, throws if it cannot be mapped
+	StateCheckpoint(std::string path);
+	/// Waits for the last checkpoint to reach the disk
+	~StateCheckpoint();
+
+	StateCheckpoint(const StateCheckpoint&) = delete;
+	StateCheckpoint& operator=(const StateCheckpoint&) = delete;
+
+	/// State found in the file when it was opened
+	CheckpointState Restored() const;
+
+	void SetEngines(bool connected, int engine1Speed, int engine1Direction, int engine2Speed, int engine2Direction);
+	void SetSupply(bool configured, int temperature);
+
+private:
+	/// Incremented on every incompatible change of the file layout
+	static const uint32_t LayoutVersion = 1;
+
+	class Slot
+	{
+	public:
+		uint64_t Sequence;
+		int32_t EnginesConnected;
+		int32_t Engine1Speed;
+		int32_t Engine1Direction;
+		int32_t Engine2Speed;
+		int32_t Engine2Direction;
+		int32_t SupplyConfigured;
+		int32_t SupplyTemperature;
+		/// Covers all fields above
+		uint32_t Checksum;
+	};
+
+	class Layout
+	{
+	public:
+		uint32_t Magic;
+		uint32_t LayoutVersion;
+		Slot Slots[2];
+	};
+
+	std::string path;
+	boost::interprocess::file_mapping file;
+	boost::interprocess::mapped_region region;
+	Layout* layout;
+
+	/// Serializes writes from the engines and power supply controllers
+	std::mutex mutex;
+	CheckpointState restored;
+	CheckpointState current;
+	uint64_t sequence;
+
+	/// Writes current to the older slot, unless it equals the newest one
+	void Write();
+	static uint32_t Checksum(Slot const& slot);
+};
@@ -0,0 +1,848 @@
+#include "TelemetryArchive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+
+#include "TelemetryStream.h"
+#include "Tracer.h"
+
+namespace ipc = boost::interprocess;
+namespace fs = std::filesystem;
+
+namespace
+{
+	const uint32_t ArchiveMagic = 0x57544152;
+	/// Incremented on every incompatible change of the segment layout
+	const uint32_t LayoutVersion = 2;
+	/// Blocks a segment can index, the segment is rotated once they are used up
+	const uint32_t MaxBlocks = 8192;
+
+	class BlockIndexEntry
+	{
+	public:
+		int64_t FirstTime;
+		int64_t LastTime;
+		uint64_t Offset;
+		uint32_t Size;
+		uint32_t Rows;
+	};
+
+	class SegmentHeader
+	{
+	public:
+		uint32_t Magic;
+		uint32_t LayoutVersion;
+		uint32_t Channels;
+		/// Blocks whose data and index entry are complete
+		uint32_t Blocks;
+		/// Offset of the first byte after the last block
+		uint64_t DataEnd;
+		int64_t FirstTime;
+		int64_t LastTime;
+		BlockIndexEntry Index[MaxBlocks];
+	};
+
+	/// Temperatures and supply voltage are fractional, every other field holds integers
+	bool IsFractionalChannel(TelemetryChannel channel)
+	{
+		return channel == TelemetryField::CurrentTemperature || channel == TelemetryField::SupplyVoltage || channel >= TelemetryFieldCount;
+	}
+
+	uint64_t ZigZag(int64_t value)
+	{
+		return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+	}
+
+	int64_t UnZigZag(uint64_t value)
+	{
+		return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	}
+
+	void PutVarint(std::vector<unsigned char>& out, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back((unsigned char)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((unsigned char)value);
+	}
+
+	uint64_t GetVarint(const unsigned char*& data, const unsigned char* end)
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (data == end)
+			{
+				throw std::runtime_error("Truncated varint");
+			}
+
+			auto byte = *data++;
+			value |= (uint64_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return value;
+			}
+		}
+
+		throw std::runtime_error("Malformed varint");
+	}
+
+	void PutUint32(std::vector<unsigned char>& out, size_t offset, uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			out[offset + i] = (unsigned char)(value >> (8 * i));
+		}
+	}
+
+	uint32_t GetUint32(const unsigned char* data)
+	{
+		return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+	}
+
+	int LeadingZeros(uint64_t value)
+	{
+		int count = 0;
+		for (uint64_t bit = 1ull << 63; bit != 0 && (value & bit) == 0; bit >>= 1)
+		{
+			count++;
+		}
+		return count;
+	}
+
+	int TrailingZeros(uint64_t value)
+	{
+		int count = 0;
+		for (uint64_t bit = 1; bit != 0 && (value & bit) == 0; bit <<= 1)
+		{
+			count++;
+		}
+		return count;
+	}
+
+	/// Appends bits most significant first
+	class BitWriter
+	{
+	public:
+		BitWriter(std::vector<unsigned char>& out) : out(out), used(8)
+		{
+		}
+
+		void Write(uint64_t value, int bits)
+		{
+			for (int i = bits - 1; i >= 0; i--)
+			{
+				if (this->used == 8)
+				{
+					this->out.push_back(0);
+					this->used = 0;
+				}
+
+				if ((value >> i) & 1)
+				{
+					this->out.back() |= (unsigned char)(0x80 >> this->used);
+				}
+				this->used++;
+			}
+		}
+
+	private:
+		std::vector<unsigned char>& out;
+		int used;
+	};
+
+	class BitReader
+	{
+	public:
+		BitReader(const unsigned char* data, const unsigned char* end) : data(data), end(end), used(0)
+		{
+		}
+
+		uint64_t Read(int bits)
+		{
+			uint64_t value = 0;
+			for (int i = 0; i < bits; i++)
+			{
+				if (this->data == this->end)
+				{
+					throw std::runtime_error("Truncated XOR column");
+				}
+
+				value = (value << 1) | ((*this->data >> (7 - this->used)) & 1);
+				if (++this->used == 8)
+				{
+					this->data++;
+					this->used = 0;
+				}
+			}
+			return value;
+		}
+
+	private:
+		const unsigned char* data;
+		const unsigned char* end;
+		int used;
+	};
+
+	uint64_t DoubleBits(double value)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	double BitsDouble(uint64_t bits)
+	{
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	// Each value is XORed with the previous one: an unchanged value costs one bit, a changed one
+	// only its meaningful bits, framed by the window of the previous change if they fit into it
+	void EncodeXorColumn(const double* values, size_t rows, std::vector<unsigned char>& out)
+	{
+		BitWriter writer(out);
+		uint64_t previous = DoubleBits(values[0]);
+		writer.Write(previous, 64);
+
+		int leading = -1;
+		int trailing = 0;
+		for (size_t i = 1; i < rows; i++)
+		{
+			auto bits = DoubleBits(values[i]);
+			auto xored = bits ^ previous;
+			previous = bits;
+
+			if (xored == 0)
+			{
+				writer.Write(0, 1);
+				continue;
+			}
+
+			auto currentLeading = std::min(LeadingZeros(xored), 31);
+			auto currentTrailing = TrailingZeros(xored);
+
+			if (leading >= 0 && currentLeading >= leading && currentTrailing >= trailing)
+			{
+				writer.Write(2, 2);
+				writer.Write(xored >> trailing, 64 - leading - trailing);
+				continue;
+			}
+
+			leading = currentLeading;
+			trailing = currentTrailing;
+			writer.Write(3, 2);
+			writer.Write((uint64_t)leading, 5);
+			writer.Write((uint64_t)(64 - leading - trailing - 1), 6);
+			writer.Write(xored >> trailing, 64 - leading - trailing);
+		}
+	}
+
+	void DecodeXorColumn(const unsigned char* data, const unsigned char* end, std::vector<ArchiveRow>& rows, TelemetryChannel channel)
+	{
+		BitReader reader(data, end);
+		uint64_t previous = reader.Read(64);
+		rows[0].Values[channel] = BitsDouble(previous);
+
+		int leading = 0;
+		int trailing = 0;
+		for (size_t i = 1; i < rows.size(); i++)
+		{
+			if (reader.Read(1) != 0)
+			{
+				if (reader.Read(1) != 0)
+				{
+					leading = (int)reader.Read(5);
+					trailing = 64 - leading - ((int)reader.Read(6) + 1);
+				}
+				previous ^= reader.Read(64 - leading - trailing) << trailing;
+			}
+			rows[i].Values[channel] = BitsDouble(previous);
+		}
+	}
+
+	void EncodeTimeColumn(const long long* times, size_t rows, std::vector<unsigned char>& out)
+	{
+		long long previous = 0;
+		long long previousDelta = 0;
+		for (size_t i = 0; i < rows; i++)
+		{
+			auto delta = times[i] - previous;
+			PutVarint(out, ZigZag(delta - previousDelta));
+			previous = times[i];
+			previousDelta = delta;
+		}
+	}
+
+	void DecodeTimeColumn(const unsigned char* data, const unsigned char* end, std::vector<ArchiveRow>& rows)
+	{
+		long long previous = 0;
+		long long previousDelta = 0;
+		for (auto& row : rows)
+		{
+			previousDelta += UnZigZag(GetVarint(data, end));
+			previous += previousDelta;
+			row.Time = previous;
+		}
+	}
+
+	void EncodeDeltaColumn(const double* values, size_t rows, std::vector<unsigned char>& out)
+	{
+		long long previous = 0;
+		for (size_t i = 0; i < rows; i++)
+		{
+			auto value = (long long)values[i];
+			PutVarint(out, ZigZag(value - previous));
+			previous = value;
+		}
+	}
+
+	void DecodeDeltaColumn(const unsigned char* data, const unsigned char* end, std::vector<ArchiveRow>& rows, TelemetryChannel channel)
+	{
+		long long previous = 0;
+		for (auto& row : rows)
+		{
+			previous += UnZigZag(GetVarint(data, end));
+			row.Values[channel] = (double)previous;
+		}
+	}
+
+	const int BlockColumns = 1 + TelemetryChannelCount;
+
+	/// Decodes the block at data into rows, throws if it is malformed. expectedRows is the row count of
+	/// its index entry, a damaged count is caught before anything is allocated for it.
+	void DecodeBlock(const unsigned char* data, size_t size, uint32_t expectedRows, std::vector<ArchiveRow>& rows)
+	{
+		if (size < 4 + 4 * BlockColumns)
+		{
+			throw std::runtime_error("Truncated block");
+		}
+
+		auto rowCount = GetUint32(data);
+		if (rowCount == 0 || rowCount > ArchiveBlockRows || rowCount != expectedRows)
+		{
+			throw std::runtime_error("Block claims " + std::to_string(rowCount) + " rows, its index entry " + std::to_string(expectedRows));
+		}
+
+		rows.resize(rowCount);
+		auto column = data + 4 + 4 * BlockColumns;
+		auto end = data + size;
+
+		for (int i = 0; i < BlockColumns; i++)
+		{
+			auto columnSize = GetUint32(data + 4 + 4 * i);
+			if (columnSize > (size_t)(end - column))
+			{
+				throw std::runtime_error("Truncated column");
+			}
+
+			if (i == 0)
+			{
+				DecodeTimeColumn(column, column + columnSize, rows);
+			}
+			else if (IsFractionalChannel(i - 1))
+			{
+				DecodeXorColumn(column, column + columnSize, rows, i - 1);
+			}
+			else
+			{
+				DecodeDeltaColumn(column, column + columnSize, rows, i - 1);
+			}
+
+			column += columnSize;
+		}
+	}
+
+	std::string SegmentPath(std::string const& path, int number)
+	{
+		// At least six digits, so names sort like their numbers until segment 1000000
+		auto digits = std::to_string(number);
+		if (digits.size() < 6)
+		{
+			digits.insert(0, 6 - digits.size(), '0');
+		}
+		return path + "-" + digits + ".seg";
+	}
+
+	/// Segments of the archive at path with their numbers, oldest first
+	std::vector<std::pair<int, std::string>> ListSegments(std::string const& path)
+	{
+		std::vector<std::pair<int, std::string>> segments;
+
+		auto directory = fs::path(path).parent_path();
+		auto prefix = fs::path(path).filename().string() + "-";
+		if (!fs::is_directory(directory.empty() ? fs::path(".") : directory))
+		{
+			return segments;
+		}
+
+		for (auto const& entry : fs::directory_iterator(directory.empty() ? fs::path(".") : directory))
+		{
+			// prefix, six or more digits, .seg; more than nine digits would overflow the segment number
+			auto name = entry.path().filename().string();
+			if (name.size() < prefix.size() + 10 || name.size() > prefix.size() + 13 || name.compare(0, prefix.size(), prefix) != 0 || entry.path().extension() != ".seg")
+			{
+				continue;
+			}
+
+			auto digits = name.substr(prefix.size(), name.size() - prefix.size() - 4);
+			if (std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; }))
+			{
+				segments.push_back(std::make_pair(std::stoi(digits), entry.path().string()));
+			}
+		}
+
+		std::sort(segments.begin(), segments.end());
+		return segments;
+	}
+}
+
+TelemetryArchive::TelemetryArchive(std::string path, size_t segmentSize, int maxSegments, std::chrono::milliseconds flushInterval)
+	: path(path),
+	segmentSize(std::max(segmentSize, sizeof(SegmentHeader) + (1 << 20))),
+	maxSegments(maxSegments),
+	flushInterval(flushInterval),
+	filling(0),
+	hasSnapshot(false),
+	failed(false),
+	stopping(false),
+	rowsDropped(0),
+	segmentNumber(0),
+	rowsWritten(0),
+	bytesWritten(0)
+{
+	this->blocks[0].Rows = 0;
+	this->blocks[1].Rows = 0;
+	// Fields are set by the first snapshot, thermocouples stay NaN until they are sampled
+	for (int channel = 0; channel < TelemetryChannelCount; channel++)
+	{
+		auto thermocouple = channel == TelemetryField::CurrentTemperature || channel >= TelemetryFieldCount;
+		this->current[channel] = thermocouple ? std::numeric_limits<double>::quiet_NaN() : 0;
+	}
+
+	auto directory = fs::path(this->path).parent_path();
+	if (!directory.empty())
+	{
+		fs::create_directories(directory);
+	}
+
+	// A segment left by the previous run stays as it is, this run starts the next one
+	auto segments = ListSegments(this->path);
+	if (!segments.empty())
+	{
+		this->segmentNumber = segments.back().first;
+	}
+
+	this->compressed.reserve(ArchiveBlockRows * BlockColumns * 4);
+	this->OpenSegment();
+	this->RemoveOldSegments();
+
+	this->writer = std::thread(&TelemetryArchive::Write, this);
+}
+
+TelemetryArchive::~TelemetryArchive()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->blockFull.notify_one();
+	this->writer.join();
+
+	try
+	{
+		this->CloseSegment();
+	}
+	catch (std::exception const& e)
+	{
+		spdlog::error("Archive :: Error while closing {}: {}", this->segmentPath, e.what());
+	}
+
+	spdlog::info("Archive :: {} rows in {} KB written, {} rows dropped", this->rowsWritten.load(), this->bytesWritten.load() / 1024, this->rowsDropped);
+}
+
+void TelemetryArchive::Append(HardwareSnapshot const& snapshot, long long time)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	auto anyChanged = false;
+	for (int field = 0; field < TelemetryFieldCount; field++)
+	{
+		// The arduino handler adds the row of a temperature before it publishes it
+		if (field == TelemetryField::CurrentTemperature)
+		{
+			continue;
+		}
+
+		auto changed = TelemetryStream::FieldChanged(snapshot, (TelemetryField)field);
+		if (this->hasSnapshot && changed <= this->changed[field])
+		{
+			continue;
+		}
+
+		this->changed[field] = changed;
+		this->current[field] = TelemetryStream::FieldValue(snapshot, (TelemetryField)field);
+		anyChanged = true;
+	}
+
+	this->hasSnapshot = true;
+	if (anyChanged)
+	{
+		this->AddRow(time);
+	}
+}
+
+void TelemetryArchive::Append(SensorReading const& reading, long long time)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	for (int thermocouple = 0; thermocouple < SensorChannelCount; thermocouple++)
+	{
+		if (reading.ChannelMask & (1 << thermocouple))
+		{
+			this->current[ThermocoupleChannel(thermocouple)] = reading.Temperatures[thermocouple];
+		}
+	}
+
+	this->AddRow(time);
+}
+
+unsigned long long TelemetryArchive::RowsWritten() const
+{
+	return this->rowsWritten;
+}
+
+unsigned long long TelemetryArchive::BytesWritten() const
+{
+	return this->bytesWritten;
+}
+
+unsigned long long TelemetryArchive::RowsDropped() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->rowsDropped;
+}
+
+void TelemetryArchive::AddRow(long long time)
+{
+	if (this->failed)
+	{
+		return;
+	}
+
+	auto& block = this->blocks[this->filling];
+	if (block.Rows == ArchiveBlockRows)
+	{
+		// The writer is still busy with the other block
+		this->rowsDropped++;
+		return;
+	}
+
+	block.Times[block.Rows] = time;
+	for (int channel = 0; channel < TelemetryChannelCount; channel++)
+	{
+		block.Values[channel][block.Rows] = this->current[channel];
+	}
+
+	if (++block.Rows == ArchiveBlockRows)
+	{
+		// Handed over right away if the writer is done with the other block, else it takes it once it is
+		if (this->blocks[1 - this->filling].Rows == 0)
+		{
+			this->filling = 1 - this->filling;
+		}
+		this->blockFull.notify_one();
+	}
+}
+
+void TelemetryArchive::Write()
+{
+	SetTraceThreadName("archive");
+
+	auto flushed = std::chrono::steady_clock::now();
+	auto reportedDrops = 0ull;
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	while (!this->failed)
+	{
+		this->blockFull.wait_until(lock, flushed + this->flushInterval, [this]
+		{
+			return this->stopping || this->blocks[1 - this->filling].Rows > 0 || this->blocks[this->filling].Rows == ArchiveBlockRows;
+		});
+
+		if (this->rowsDropped != reportedDrops)
+		{
+			spdlog::warn("Archive :: Writer fell behind, {} rows dropped so far", this->rowsDropped);
+			reportedDrops = this->rowsDropped;
+		}
+
+		// A block handed over by Append goes first. Else the one being filled is taken when it is full or
+		// flushInterval passed, and the pages of the segment go to disk with it.
+		auto flush = false;
+		auto stopping = this->stopping;
+		if (this->blocks[1 - this->filling].Rows == 0)
+		{
+			flush = stopping || std::chrono::steady_clock::now() >= flushed + this->flushInterval;
+			this->filling = 1 - this->filling;
+		}
+
+		auto& block = this->blocks[1 - this->filling];
+		lock.unlock();
+
+		std::string error;
+		try
+		{
+			this->Seal(block);
+			if (flush)
+			{
+				// Pages reach the file even if the process crashes, the flush only protects against losing the machine
+				this->region.flush(0, 0, true);
+				flushed = std::chrono::steady_clock::now();
+			}
+		}
+		catch (std::exception const& e)
+		{
+			error = e.what();
+		}
+
+		lock.lock();
+		block.Rows = 0;
+
+		if (!error.empty())
+		{
+			this->failed = true;
+			spdlog::error("Archive :: Stopped archiving to {}: {}", this->segmentPath, error);
+		}
+		else if (stopping && flush)
+		{
+			break;
+		}
+	}
+}
+
+void TelemetryArchive::Seal(Block const& block)
+{
+	if (block.Rows == 0)
+	{
+		return;
+	}
+
+	// Column sizes are filled in once the columns are encoded
+	this->compressed.assign(4 + 4 * BlockColumns, 0);
+	PutUint32(this->compressed, 0, (uint32_t)block.Rows);
+
+	for (int i = 0; i < BlockColumns; i++)
+	{
+		auto start = this->compressed.size();
+
+		if (i == 0)
+		{
+			EncodeTimeColumn(block.Times, block.Rows, this->compressed);
+		}
+		else if (IsFractionalChannel(i - 1))
+		{
+			EncodeXorColumn(block.Values[i - 1], block.Rows, this->compressed);
+		}
+		else
+		{
+			EncodeDeltaColumn(block.Values[i - 1], block.Rows, this->compressed);
+		}
+
+		PutUint32(this->compressed, 4 + 4 * i, (uint32_t)(this->compressed.size() - start));
+	}
+
+	auto header = static_cast<SegmentHeader*>(this->region.get_address());
+	if (header->Blocks == MaxBlocks || header->DataEnd + this->compressed.size() > this->region.get_size())
+	{
+		this->CloseSegment();
+		this->OpenSegment();
+		this->RemoveOldSegments();
+		header = static_cast<SegmentHeader*>(this->region.get_address());
+	}
+
+	auto firstTime = *std::min_element(block.Times, block.Times + block.Rows);
+	auto lastTime = *std::max_element(block.Times, block.Times + block.Rows);
+
+	std::memcpy(static_cast<unsigned char*>(this->region.get_address()) + header->DataEnd, this->compressed.data(), this->compressed.size());
+
+	auto& entry = header->Index[header->Blocks];
+	entry.FirstTime = firstTime;
+	entry.LastTime = lastTime;
+	entry.Offset = header->DataEnd;
+	entry.Size = (uint32_t)this->compressed.size();
+	entry.Rows = (uint32_t)block.Rows;
+
+	header->FirstTime = header->Blocks == 0 ? firstTime : std::min<int64_t>(header->FirstTime, firstTime);
+	header->LastTime = header->Blocks == 0 ? lastTime : std::max<int64_t>(header->LastTime, lastTime);
+	header->DataEnd += this->compressed.size();
+	// Readers only see the block once it is counted
+	header->Blocks++;
+
+	this->rowsWritten += block.Rows;
+	this->bytesWritten += this->compressed.size();
+}
+
+void TelemetryArchive::OpenSegment()
+{
+	this->segmentNumber++;
+	this->segmentPath = SegmentPath(this->path, this->segmentNumber);
+
+	// The mapping needs the file to exist with its final size
+	{
+		std::ofstream stream(this->segmentPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!stream)
+		{
+			throw std::runtime_error("Cannot create archive segment " + this->segmentPath);
+		}
+	}
+	fs::resize_file(this->segmentPath, this->segmentSize);
+
+	this->file = ipc::file_mapping(this->segmentPath.c_str(), ipc::read_write);
+	this->region = ipc::mapped_region(this->file, ipc::read_write, 0, this->segmentSize);
+
+	auto header = static_cast<SegmentHeader*>(this->region.get_address());
+	header->Magic = ArchiveMagic;
+	header->LayoutVersion = LayoutVersion;
+	header->Channels = TelemetryChannelCount;
+	header->Blocks = 0;
+	header->DataEnd = sizeof(SegmentHeader);
+	header->FirstTime = 0;
+	header->LastTime = 0;
+
+	spdlog::info("Archive :: Writing segment {}", this->segmentPath);
+}
+
+void TelemetryArchive::CloseSegment()
+{
+	if (this->region.get_address() == nullptr)
+	{
+		return;
+	}
+
+	auto header = static_cast<SegmentHeader*>(this->region.get_address());
+	auto blocks = header->Blocks;
+	auto used = header->DataEnd;
+
+	this->region.flush(0, 0, false);
+	this->region = ipc::mapped_region();
+	this->file = ipc::file_mapping();
+
+	// The unused tail of the preallocated file is given back
+	fs::resize_file(this->segmentPath, used);
+
+	spdlog::info("Archive :: Closed segment {} ({} blocks, {} KB)", this->segmentPath, blocks, used / 1024);
+}
+
+void TelemetryArchive::RemoveOldSegments()
+{
+	if (this->maxSegments <= 0)
+	{
+		return;
+	}
+
+	auto segments = ListSegments(this->path);
+	for (size_t i = 0; i + this->maxSegments < segments.size(); i++)
+	{
+		std::error_code error;
+		fs::remove(segments[i].second, error);
+		if (error)
+		{
+			spdlog::warn("Archive :: Cannot remove old segment {}: {}", segments[i].second, error.message());
+		}
+		else
+		{
+			spdlog::info("Archive :: Removed old segment {}", segments[i].second);
+		}
+	}
+}
+
+TelemetryArchiveReader::TelemetryArchiveReader(std::string path)
+	: blocksDecoded(0)
+{
+	for (auto const& segment : ListSegments(path))
+	{
+		this->segments.push_back(segment.second);
+	}
+}
+
+std::vector<std::string> const& TelemetryArchiveReader::Segments() const
+{
+	return this->segments;
+}
+
+unsigned long long TelemetryArchiveReader::Scan(long long from, long long to, RowCallback onRow)
+{
+	unsigned long long count = 0;
+	std::vector<ArchiveRow> rows;
+	rows.reserve(ArchiveBlockRows);
+
+	for (auto const& segmentPath : this->segments)
+	{
+		// Only the pages of the header and the blocks in the window are read from disk
+		ipc::file_mapping file(segmentPath.c_str(), ipc::read_only);
+		ipc::mapped_region region(file, ipc::read_only);
+
+		auto header = static_cast<SegmentHeader const*>(region.get_address());
+		if (region.get_size() < sizeof(SegmentHeader) || header->Magic != ArchiveMagic || header->LayoutVersion != LayoutVersion || header->Channels != TelemetryChannelCount)
+		{
+			spdlog::warn("Archive :: Skipping {}, it is not a segment of this version", segmentPath);
+			continue;
+		}
+
+		if (header->Blocks == 0 || header->LastTime < from || header->FirstTime > to)
+		{
+			continue;
+		}
+
+		auto blocks = std::min(header->Blocks, MaxBlocks);
+		for (uint32_t i = 0; i < blocks; i++)
+		{
+			auto const& entry = header->Index[i];
+			if (entry.LastTime < from || entry.FirstTime > to)
+			{
+				continue;
+			}
+
+			if (entry.Offset + entry.Size > region.get_size())
+			{
+				spdlog::warn("Archive :: Block {} of {} lies beyond the end of the file", i, segmentPath);
+				break;
+			}
+
+			try
+			{
+				DecodeBlock(static_cast<const unsigned char*>(region.get_address()) + entry.Offset, entry.Size, entry.Rows, rows);
+				this->blocksDecoded++;
+			}
+			catch (std::exception const& e)
+			{
+				spdlog::warn("Archive :: Skipping block {} of {}: {}", i, segmentPath, e.what());
+				continue;
+			}
+
+			for (auto const& row : rows)
+			{
+				if (row.Time >= from && row.Time <= to)
+				{
+					onRow(row);
+					count++;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+unsigned long long TelemetryArchiveReader::BlocksDecoded() const
+{
+	return this->blocksDecoded;
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "HardwareStateStore.h"
+#include "TelemetryFrame.h"
+
+// On-disk layout of a telemetry archive segment (<path>-NNNNNN.seg):
+//
+//   SegmentHeader  magic, layout version, time range and the index of the blocks written so far
+//   blocks         back to back from the end of the header
+//
+// A block holds up to ArchiveBlockRows rows as columns: u32 rows, u32 size of every column, then
+// the time column followed by one column per telemetry channel. Times (us since the epoch) are
+// delta-of-delta varints, integral fields delta varints and the temperatures and supply voltage
+// XOR-compressed doubles. A block only counts once its index entry is written, so a crash loses
+// at most the rows not sealed yet.
+
+/// Rows collected before they are compressed into a block
+const size_t ArchiveBlockRows = 1024;
+
+/// One archived hardware state, values in TelemetryChannel order. A thermocouple that has not
+/// been sampled yet is NaN.
+class ArchiveRow
+{
+public:
+	long long Time;
+	double Values[TelemetryChannelCount];
+};
+
+/// Appends the state of a rig to compressed, columnar segments whenever a field of the state store
+/// changes or the thermocouples were sampled, every row holding the latest value of each channel. A segment
+/// is a memory-mapped file of a fixed size; once full it is truncated to what was written and the
+/// next one is started. Rows are collected in two blocks: while a writer thread compresses and
+/// writes one of them, the other one is filled.
+class TelemetryArchive
+{
+public:
+	/// Segments are created as path-NNNNNN.seg, numbered on from the ones already there. maxSegments
+	/// above 0 deletes the oldest segments beyond it. A partial block is written once flushInterval
+	/// passed without a full one. Throws if the first segment cannot be mapped.
+	TelemetryArchive(std::string path, size_t segmentSize, int maxSegments, std::chrono::milliseconds flushInterval);
+	/// Stops the writer once it wrote the pending rows and truncates the current segment
+	~TelemetryArchive();
+
+	TelemetryArchive(const TelemetryArchive&) = delete;
+	TelemetryArchive& operator=(const TelemetryArchive&) = delete;
+
+	/// Adds a row if a field of snapshot other than CurrentTemperature changed, time in us since the
+	/// epoch. Called by the publishing thread, it only copies the row: a row arriving while both
+	/// blocks wait for the writer is dropped.
+	void Append(HardwareSnapshot const& snapshot, long long time);
+	/// Adds a row with the thermocouples sampled in reading, CurrentTemperature being thermocouple 0
+	void Append(SensorReading const& reading, long long time);
+
+	unsigned long long RowsWritten() const;
+	unsigned long long BytesWritten() const;
+	unsigned long long RowsDropped() const;
+
+private:
+	class Block
+	{
+	public:
+		long long Times[ArchiveBlockRows];
+		double Values[TelemetryChannelCount][ArchiveBlockRows];
+		size_t Rows;
+	};
+
+	std::string path;
+	const size_t segmentSize;
+	const int maxSegments;
+	const std::chrono::milliseconds flushInterval;
+
+	/// Guards everything up to the writer thread
+	mutable std::mutex mutex;
+	/// Wakes the writer when the block being filled is full or the archive stops
+	std::condition_variable blockFull;
+	Block blocks[2];
+	/// Index of the block Append fills, the writer owns the other one
+	int filling;
+	/// Latest value of every channel, the next row
+	double current[TelemetryChannelCount];
+	/// Change time of every field when the state store last published it
+	std::chrono::steady_clock::time_point changed[TelemetryFieldCount];
+	bool hasSnapshot;
+	bool failed;
+	bool stopping;
+	unsigned long long rowsDropped;
+
+	std::thread writer;
+
+	/// Only used by the writer thread once it started
+	boost::interprocess::file_mapping file;
+	boost::interprocess::mapped_region region;
+	std::string segmentPath;
+	int segmentNumber;
+	/// Compressed block, reused for every block
+	std::vector<unsigned char> compressed;
+
+	std::atomic<unsigned long long> rowsWritten;
+	std::atomic<unsigned long long> bytesWritten;
+
+	void AddRow(long long time);
+	void Write();
+	void Seal(Block const& block);
+	void OpenSegment();
+	void CloseSegment();
+	void RemoveOldSegments();
+};
+
+/// Reads the segments of an archive. Segments and blocks outside the requested time window are
+/// skipped by their index entries, only the blocks overlapping it are decompressed.
+class TelemetryArchiveReader
+{
+public:
+	/// Called with every row in the window, in time order
+	typedef std::function<void(ArchiveRow const&)> RowCallback;
+
+	/// path as given to TelemetryArchive
+	TelemetryArchiveReader(std::string path);
+
+	/// Segment files found, oldest first
+	std::vector<std::string> const& Segments() const;
+
+	/// Calls onRow for every archived row with from <= time <= to and returns how many there were
+	unsigned long long Scan(long long from, long long to, RowCallback onRow);
+
+	/// Blocks decompressed by the scans so far
+	unsigned long long BlocksDecoded() const;
+
+private:
+	std::vector<std::string> segments;
+	unsigned long long blocksDecoded;
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Enums.h"
+#include "SensorProtocol.h"
+
+/// Channel of the telemetry history: a telemetry field, or after them thermocouples 1 to 7 of the
+/// binary sensor protocol. Thermocouple 0 is CurrentTemperature.
+typedef int TelemetryChannel;
+const int TelemetryChannelCount = TelemetryFieldCount + SensorChannelCount - 1;
+
+/// Channel of thermocouple 0 to 7
+inline TelemetryChannel ThermocoupleChannel(int thermocouple)
+{
+	return thermocouple == 0 ? CurrentTemperature : TelemetryFieldCount + thermocouple - 1;
+}
+
+/// Field the server wants streamed and the minimum time between two of its updates
+class FieldSubscription
+{
+public:
+	TelemetryField Field;
+	std::chrono::milliseconds Interval;
+};
+
+class TelemetrySubscription
+{
+public:
+	std::vector<FieldSubscription> Fields;
+	/// Time between two frames carrying every subscribed field, zero for none after the first
+	std::chrono::milliseconds KeyframeInterval;
+};
+
+/// One telemetry message, carrying either every subscribed field (keyframe) or only the changed ones
+class TelemetryFrame
+{
+public:
+	unsigned long long Sequence;
+	bool Keyframe;
+	/// Controller time the values were read (in us)
+	long long SampledAt;
+	std::vector<std::pair<TelemetryField, double>> Values;
+};
+
+/// Range of recorded telemetry the server asked for, times are controller monotonic time in us like sampledAt
+class HistoryQuery
+{
+public:
+	std::vector<TelemetryChannel> Channels;
+	long long From;
+	long long To;
+	/// Only every Decimation-th recorded sample of a channel is sent
+	int Decimation;
+};
+
+/// Part of the response to a history query. Channels are sent one after the other, a chunk
+/// holds the end of one and the start of the next if they fit.
+class HistoryChunk
+{
+public:
+	/// Correlation id of the query (serialized JSON value), empty if it carried none
+	std::string Id;
+	unsigned long long Index;
+	/// Set on the final chunk of the query
+	bool Last;
+	std::vector<TelemetryChannel> Channels;
+	/// Sample times and values of every channel in Channels
+	std::vector<std::vector<long long>> Times;
+	std::vector<std::vector<double>> Columns;
+};
@@ -0,0 +1,136 @@
+#include "TelemetryHistory.h"
+
+#include <algorithm>
+
+#include "ClockSync.h"
+#include "TelemetryStream.h"
+
+TelemetryHistory::TelemetryHistory(size_t capacity)
+	: capacity(std::max<size_t>(capacity, 1)),
+	hasSnapshot(false)
+{
+	// Allocated up front, recording never allocates
+	for (auto& channel : this->channels)
+	{
+		channel.Recorded = 0;
+		channel.LastTime = 0;
+		channel.Times.resize(this->capacity);
+		channel.Values.resize(this->capacity);
+	}
+}
+
+void TelemetryHistory::Record(TelemetryChannel channel, double value, long long time)
+{
+	if (channel < 0 || channel >= TelemetryChannelCount)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->RecordLocked(channel, value, time);
+}
+
+void TelemetryHistory::Record(HardwareSnapshot const& snapshot)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	for (int field = 0; field < TelemetryFieldCount; field++)
+	{
+		if (field == TelemetryField::CurrentTemperature)
+		{
+			continue;
+		}
+
+		// A publish changes some fields, the others keep the time of their last change
+		auto changed = TelemetryStream::FieldChanged(snapshot, (TelemetryField)field);
+		if (this->hasSnapshot && changed <= this->changed[field])
+		{
+			continue;
+		}
+
+		this->changed[field] = changed;
+		this->RecordLocked(field, TelemetryStream::FieldValue(snapshot, (TelemetryField)field), MonotonicMicroseconds(changed));
+	}
+
+	this->hasSnapshot = true;
+}
+
+unsigned long long TelemetryHistory::Find(TelemetryChannel channel, long long time)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	auto const& samples = this->channels[channel];
+	auto oldest = this->Oldest(samples);
+	auto first = oldest;
+	auto last = samples.Recorded;
+
+	while (first < last)
+	{
+		auto middle = first + (last - first) / 2;
+		if (samples.Times[middle % this->capacity] <= time)
+		{
+			first = middle + 1;
+		}
+		else
+		{
+			last = middle;
+		}
+	}
+
+	// first is the first sample after time, the one before it was in effect at time
+	return first > oldest ? first - 1 : first;
+}
+
+bool TelemetryHistory::Read(TelemetryChannel channel, unsigned long long& cursor, long long to, int decimation, size_t maxCount, std::vector<long long>& times, std::vector<double>& values)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	auto const& samples = this->channels[channel];
+	decimation = std::max(decimation, 1);
+
+	// A slow reader lost the samples that were overwritten, it continues in the same decimation phase
+	auto oldest = this->Oldest(samples);
+	if (cursor < oldest)
+	{
+		cursor += (oldest - cursor + decimation - 1) / decimation * decimation;
+	}
+
+	for (size_t count = 0; count < maxCount && cursor < samples.Recorded; count++)
+	{
+		auto index = cursor % this->capacity;
+		if (samples.Times[index] > to)
+		{
+			return true;
+		}
+
+		times.push_back(samples.Times[index]);
+		values.push_back(samples.Values[index]);
+		cursor += decimation;
+	}
+
+	return cursor >= samples.Recorded || samples.Times[cursor % this->capacity] > to;
+}
+
+size_t TelemetryHistory::Capacity() const
+{
+	return this->capacity;
+}
+
+void TelemetryHistory::RecordLocked(TelemetryChannel channel, double value, long long time)
+{
+	auto& samples = this->channels[channel];
+
+	// Queries binary search the times, they have to stay sorted
+	time = std::max(time, samples.LastTime);
+	samples.LastTime = time;
+
+	auto index = samples.Recorded % this->capacity;
+	samples.Times[index] = time;
+	samples.Values[index] = value;
+	samples.Recorded++;
+}
+
+unsigned long long TelemetryHistory::Oldest(Channel const& channel) const
+{
+	return channel.Recorded > this->capacity ? channel.Recorded - this->capacity : 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "HardwareStateStore.h"
+#include "TelemetryFrame.h"
+
+/// Recent telemetry of a rig, kept for servers and dashboards that need to backfill after a
+/// reconnect. Every channel has a fixed-size ring of its own samples, so memory does not grow
+/// with uptime: once capacity samples of a channel are held its oldest one is overwritten.
+/// Times are on the monotonic clock of the outbound timestamps (MonotonicMicroseconds).
+class TelemetryHistory
+{
+public:
+	/// capacity is the number of samples kept per channel
+	TelemetryHistory(size_t capacity);
+
+	TelemetryHistory(const TelemetryHistory&) = delete;
+	TelemetryHistory& operator=(const TelemetryHistory&) = delete;
+
+	/// Appends a sample of channel. Times of a channel never go backwards, an earlier time is
+	/// recorded as the previous one.
+	void Record(TelemetryChannel channel, double value, long long time);
+	/// Appends every field of snapshot that changed since it was last recorded, at the time it
+	/// changed. CurrentTemperature is left out, it is recorded from the thermocouple samples.
+	void Record(HardwareSnapshot const& snapshot);
+
+	/// Cursor of the sample of channel in effect at time: the last one at or before it, else the
+	/// first one after it, or the next one to be recorded
+	unsigned long long Find(TelemetryChannel channel, long long time);
+
+	/// Appends every decimation-th sample of channel from cursor on to times and values, at most maxCount
+	/// of them, and advances cursor past them. Samples overwritten since the cursor was taken are skipped.
+	/// Returns true once the cursor passed to or caught up with the newest sample.
+	bool Read(TelemetryChannel channel, unsigned long long& cursor, long long to, int decimation, size_t maxCount, std::vector<long long>& times, std::vector<double>& values);
+
+	size_t Capacity() const;
+
+private:
+	class Channel
+	{
+	public:
+		/// Number of samples recorded so far, the cursor of the next one
+		unsigned long long Recorded;
+		long long LastTime;
+		std::vector<long long> Times;
+		std::vector<double> Values;
+	};
+
+	const size_t capacity;
+
+	/// Guards everything below
+	std::mutex mutex;
+	Channel channels[TelemetryChannelCount];
+	/// Change time of every field when the state store last published it
+	std::chrono::steady_clock::time_point changed[TelemetryFieldCount];
+	bool hasSnapshot;
+
+	void RecordLocked(TelemetryChannel channel, double value, long long time);
+	unsigned long long Oldest(Channel const& channel) const;
+};
@@ -0,0 +1,154 @@
+#include "TelemetryStream.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+TelemetryStream::TelemetryStream(HardwareStateStore* stateStore, LinkMonitor* linkMonitor, OutboundQueue* outbound)
+	: stateStore(stateStore),
+	linkMonitor(linkMonitor),
+	outbound(outbound),
+	keyframeInterval(0),
+	keyframePending(false),
+	sequence(0),
+	droppedFrames(0),
+	active(false)
+{
+}
+
+void TelemetryStream::Subscribe(TelemetrySubscription const& subscription)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->fields.clear();
+	for (auto const& fieldSubscription : subscription.Fields)
+	{
+		FieldState field;
+		field.Field = fieldSubscription.Field;
+		field.Interval = fieldSubscription.Interval;
+		field.LastValue = 0;
+		this->fields.push_back(field);
+	}
+
+	this->keyframeInterval = subscription.KeyframeInterval;
+	this->keyframePending = true;
+	this->active = !this->fields.empty();
+
+	spdlog::info("Telemetry :: Subscribed to {} fields, keyframe every {} ms", this->fields.size(), this->keyframeInterval.count());
+}
+
+bool TelemetryStream::IsActive() const
+{
+	return this->active.load();
+}
+
+bool TelemetryStream::Tick()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (this->fields.empty())
+	{
+		return true;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	auto snapshot = this->stateStore->Current();
+
+	// Deltas after a dropped frame leave the server out of date until the next keyframe
+	auto dropped = this->outbound->Dropped(OutboundType::TelemetryUpdate);
+	if (dropped != this->droppedFrames)
+	{
+		this->droppedFrames = dropped;
+		this->keyframePending = true;
+	}
+
+	// A degraded link stretches every field interval, keyframes still go out on time
+	auto throttle = this->linkMonitor->TelemetryInterval();
+
+	auto frame = TelemetryFrame();
+	frame.Keyframe = this->keyframePending || (this->keyframeInterval.count() > 0 && now - this->lastKeyframe >= this->keyframeInterval);
+
+	for (auto& field : this->fields)
+	{
+		auto value = FieldValue(*snapshot, field.Field);
+
+		if (!frame.Keyframe && (value == field.LastValue || now - field.LastSent < std::max(field.Interval, throttle)))
+		{
+			continue;
+		}
+
+		frame.Values.push_back(std::make_pair(field.Field, value));
+		field.LastValue = value;
+		field.LastSent = now;
+	}
+
+	if (frame.Values.empty())
+	{
+		return true;
+	}
+
+	if (frame.Keyframe)
+	{
+		this->keyframePending = false;
+		this->lastKeyframe = now;
+	}
+
+	frame.Sequence = ++this->sequence;
+	frame.SampledAt = MonotonicMicroseconds(now);
+	this->outbound->Push(this->messageParser.ParseToTelemetry(frame), OutboundType::TelemetryUpdate);
+
+	return true;
+}
+
+double TelemetryStream::FieldValue(HardwareSnapshot const& snapshot, TelemetryField field)
+{
+	switch (field)
+	{
+		case TelemetryField::Engine1Speed:
+			return snapshot.Engine1Speed.Value;
+		case TelemetryField::Engine2Speed:
+			return snapshot.Engine2Speed.Value;
+		case TelemetryField::Engine1ActualSpeed:
+			return snapshot.Engine1ActualSpeed.Value;
+		case TelemetryField::Engine2ActualSpeed:
+			return snapshot.Engine2ActualSpeed.Value;
+		case TelemetryField::Alarms:
+			return snapshot.Alarms.Value;
+		case TelemetryField::DesiredTemperature:
+			return snapshot.DesiredTemperature.Value;
+		case TelemetryField::CurrentTemperature:
+			return snapshot.CurrentTemperature.Value;
+		case TelemetryField::SupplyVoltage:
+			return snapshot.SupplyVoltage.Value;
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+std::chrono::steady_clock::time_point TelemetryStream::FieldChanged(HardwareSnapshot const& snapshot, TelemetryField field)
+{
+	switch (field)
+	{
+		case TelemetryField::Engine1Speed:
+			return snapshot.Engine1Speed.Timestamp;
+		case TelemetryField::Engine2Speed:
+			return snapshot.Engine2Speed.Timestamp;
+		case TelemetryField::Engine1ActualSpeed:
+			return snapshot.Engine1ActualSpeed.Timestamp;
+		case TelemetryField::Engine2ActualSpeed:
+			return snapshot.Engine2ActualSpeed.Timestamp;
+		case TelemetryField::Alarms:
+			return snapshot.Alarms.Timestamp;
+		case TelemetryField::DesiredTemperature:
+			return snapshot.DesiredTemperature.Timestamp;
+		case TelemetryField::CurrentTemperature:
+			return snapshot.CurrentTemperature.Timestamp;
+		case TelemetryField::SupplyVoltage:
+			return snapshot.SupplyVoltage.Timestamp;
+		default:
+			break;
+	}
+
+	return std::chrono::steady_clock::time_point();
+}
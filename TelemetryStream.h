@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "HardwareStateStore.h"
+#include "LinkMonitor.h"
+#include "MessageParser.h"
+#include "OutboundQueue.h"
+#include "TelemetryFrame.h"
+
+/// Streams the hardware state fields the server subscribed to. Each field is sent
+/// at most once per its interval and only when it changed, with periodic keyframes
+/// carrying every subscribed field so the server can resynchronize.
+class TelemetryStream
+{
+public:
+	TelemetryStream(HardwareStateStore* stateStore, LinkMonitor* linkMonitor, OutboundQueue* outbound);
+
+	/// Replaces the current subscription, the next frame is a keyframe
+	void Subscribe(TelemetrySubscription const& subscription);
+	/// Indicates that the server subscribed to at least one field
+	bool IsActive() const;
+
+	/// Sends a frame if any field is due, run periodically by the scheduler
+	bool Tick();
+
+	/// Value of field in snapshot as it is streamed
+	static double FieldValue(HardwareSnapshot const& snapshot, TelemetryField field);
+	/// When the state store last changed field in snapshot
+	static std::chrono::steady_clock::time_point FieldChanged(HardwareSnapshot const& snapshot, TelemetryField field);
+
+private:
+	class FieldState
+	{
+	public:
+		TelemetryField Field;
+		std::chrono::milliseconds Interval;
+		std::chrono::steady_clock::time_point LastSent;
+		double LastValue;
+	};
+
+	HardwareStateStore* stateStore;
+	LinkMonitor* linkMonitor;
+	OutboundQueue* outbound;
+	MessageParser messageParser;
+
+	/// Guards the subscription state below
+	std::mutex mutex;
+	std::vector<FieldState> fields;
+	std::chrono::milliseconds keyframeInterval;
+	std::chrono::steady_clock::time_point lastKeyframe;
+	bool keyframePending;
+	unsigned long long sequence;
+	/// Frames the outbound queue dropped so far, a new drop triggers a keyframe
+	unsigned long long droppedFrames;
+	std::atomic<bool> active;
+};
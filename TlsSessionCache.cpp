@@ -0,0 +1,93 @@
+#include "TlsSessionCache.h"
+
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#pragma comment(lib, "libssl.lib")
+#pragma comment(lib, "libcrypto.lib")
+#endif
+
+namespace
+{
+	/// Context slot holding the cache. The app data slot belongs to asio, which keeps the verify callback in it.
+	int CacheIndex()
+	{
+		static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+		return index;
+	}
+}
+
+TlsSessionCache::TlsSessionCache(boost::asio::ssl::context* context)
+	: context(context),
+	session(nullptr)
+{
+	auto handle = context->native_handle();
+
+	// Without the internal store OpenSSL hands every ticket to the callback and keeps no copy
+	SSL_CTX_set_session_cache_mode(handle, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	if (CacheIndex() < 0 || SSL_CTX_set_ex_data(handle, CacheIndex(), this) != 1)
+	{
+		throw std::runtime_error("TLS session cache could not be attached to the context");
+	}
+
+	SSL_CTX_sess_set_new_cb(handle, &TlsSessionCache::OnNewSession);
+}
+
+TlsSessionCache::~TlsSessionCache()
+{
+	auto handle = this->context->native_handle();
+	SSL_CTX_sess_set_new_cb(handle, nullptr);
+	SSL_CTX_set_ex_data(handle, CacheIndex(), nullptr);
+
+	this->Clear();
+}
+
+void TlsSessionCache::Prepare(SSL* connection)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (this->session != nullptr && SSL_set_session(connection, this->session) != 1)
+	{
+		spdlog::warn("TLS :: Cached session could not be offered, doing a full handshake");
+	}
+}
+
+void TlsSessionCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (this->session != nullptr)
+	{
+		SSL_SESSION_free(this->session);
+		this->session = nullptr;
+	}
+}
+
+int TlsSessionCache::OnNewSession(SSL* connection, SSL_SESSION* session)
+{
+	auto cache = static_cast<TlsSessionCache*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(connection), CacheIndex()));
+	if (cache == nullptr || SSL_SESSION_is_resumable(session) != 1)
+	{
+		return 0;
+	}
+
+	// The session stays the connection's own, which OpenSSL marks as not resumable when the
+	// connection is dropped without a close_notify. The copy survives such a disconnect.
+	auto copy = SSL_SESSION_dup(session);
+	if (copy == nullptr)
+	{
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(cache->mutex);
+
+	// TLS 1.3 tickets are meant for one use, the newest one replaces the one used for this connection
+	if (cache->session != nullptr)
+	{
+		SSL_SESSION_free(cache->session);
+	}
+	cache->session = copy;
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <mutex>
+#include <boost/asio/ssl.hpp>
+
+/// Keeps the latest TLS session ticket the server issued, so that a reconnect resumes the
+/// session instead of running a full handshake. TLS 1.3 servers send tickets after the
+/// handshake, they are picked up through the context's new session callback.
+class TlsSessionCache
+{
+public:
+	/// Installs the ticket callback on context, which must not outlive the cache
+	TlsSessionCache(boost::asio::ssl::context* context);
+	~TlsSessionCache();
+
+	TlsSessionCache(const TlsSessionCache&) = delete;
+	TlsSessionCache& operator=(const TlsSessionCache&) = delete;
+
+	/// Offers the cached session on connection, to be called before its handshake
+	void Prepare(SSL* connection);
+	/// Forgets the cached session, e.g. after a handshake using it failed
+	void Clear();
+
+private:
+	boost::asio::ssl::context* context;
+
+	/// Guards session, tickets arrive on the I/O thread of the session
+	std::mutex mutex;
+	SSL_SESSION* session;
+
+	static int OnNewSession(SSL* connection, SSL_SESSION* session);
+};
@@ -0,0 +1,210 @@
+#include "Tracer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+namespace TraceDetail
+{
+	std::atomic<bool> Enabled(false);
+}
+
+namespace
+{
+	/// Ring of the most recent events of one thread. The mutex is only ever contended by an export.
+	class TraceBuffer
+	{
+	public:
+		std::mutex Mutex;
+		std::vector<TraceEvent> Events;
+		/// Total number of events recorded, the next one goes to Recorded % Events.size()
+		unsigned long long Recorded;
+		unsigned long ThreadId;
+		const char* ThreadName;
+		/// Set once the owning thread exited
+		bool Retired;
+	};
+
+	/// Buffers of exited threads kept for export, older ones are released. Sessions create new threads on every reconnect.
+	const size_t MaxRetiredBuffers = 16;
+
+	std::mutex registryMutex;
+	std::vector<std::shared_ptr<TraceBuffer>> buffers;
+	size_t bufferSize = 16384;
+	unsigned long nextThreadId = 1;
+	const auto epoch = std::chrono::steady_clock::now();
+
+	/// Retires the buffer of a thread when the thread exits
+	class ThreadBufferOwner
+	{
+	public:
+		std::shared_ptr<TraceBuffer> Buffer;
+
+		~ThreadBufferOwner()
+		{
+			if (!this->Buffer)
+			{
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(registryMutex);
+			this->Buffer->Retired = true;
+
+			size_t retired = std::count_if(buffers.begin(), buffers.end(), [](std::shared_ptr<TraceBuffer> const& buffer) { return buffer->Retired; });
+			for (auto buffer = buffers.begin(); buffer != buffers.end() && retired > MaxRetiredBuffers;)
+			{
+				if ((*buffer)->Retired)
+				{
+					buffer = buffers.erase(buffer);
+					retired--;
+				}
+				else
+				{
+					buffer++;
+				}
+			}
+		}
+	};
+
+	thread_local ThreadBufferOwner threadBuffer;
+
+	TraceBuffer* CurrentBuffer()
+	{
+		if (!threadBuffer.Buffer)
+		{
+			auto buffer = std::make_shared<TraceBuffer>();
+			buffer->Recorded = 0;
+			buffer->ThreadName = nullptr;
+			buffer->Retired = false;
+
+			std::lock_guard<std::mutex> lock(registryMutex);
+			buffer->Events.resize(bufferSize);
+			buffer->ThreadId = nextThreadId++;
+			buffers.push_back(buffer);
+			threadBuffer.Buffer = buffer;
+		}
+
+		return threadBuffer.Buffer.get();
+	}
+
+	long long SinceEpoch(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+	}
+
+	/// Trace-event timestamps are microseconds, fractions keep the nanosecond resolution
+	void WriteMicroseconds(std::ofstream& file, long long nanoseconds)
+	{
+		char text[32];
+		snprintf(text, sizeof(text), "%lld.%03lld", nanoseconds / 1000, nanoseconds % 1000);
+		file << text;
+	}
+}
+
+void SetTracingEnabled(bool enabled)
+{
+	TraceDetail::Enabled.store(enabled);
+	spdlog::info("Tracer :: Tracing {}", enabled ? "enabled" : "disabled");
+}
+
+void SetTraceBufferSize(size_t events)
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	bufferSize = std::max<size_t>(events, 1);
+}
+
+void SetTraceThreadName(const char* name)
+{
+	auto buffer = CurrentBuffer();
+
+	std::lock_guard<std::mutex> lock(buffer->Mutex);
+	buffer->ThreadName = name;
+}
+
+void RecordTraceEvent(const char* name, const char* category, long long argument, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	auto buffer = CurrentBuffer();
+
+	std::lock_guard<std::mutex> lock(buffer->Mutex);
+	auto& event = buffer->Events[buffer->Recorded % buffer->Events.size()];
+	event.Name = name;
+	event.Category = category;
+	event.Argument = argument;
+	event.Start = start;
+	event.Duration = end - start;
+	buffer->Recorded++;
+}
+
+size_t WriteTrace(std::string const& path)
+{
+	std::vector<std::shared_ptr<TraceBuffer>> threads;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		threads = buffers;
+	}
+
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file)
+	{
+		throw std::runtime_error("Cannot open trace file " + path);
+	}
+
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+	size_t written = 0;
+	bool firstEntry = true;
+	std::vector<TraceEvent> events;
+	for (auto const& thread : threads)
+	{
+		const char* threadName;
+		{
+			// Copied out so recording threads are only held up for the copy, not the file write
+			std::lock_guard<std::mutex> lock(thread->Mutex);
+			size_t count = (size_t)std::min<unsigned long long>(thread->Recorded, thread->Events.size());
+			size_t first = (size_t)((thread->Recorded - count) % thread->Events.size());
+
+			events.clear();
+			for (size_t i = 0; i < count; i++)
+			{
+				events.push_back(thread->Events[(first + i) % thread->Events.size()]);
+			}
+			threadName = thread->ThreadName;
+		}
+
+		if (threadName != nullptr)
+		{
+			file << (firstEntry ? "\n" : ",\n");
+			firstEntry = false;
+			file << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->ThreadId << ",\"name\":\"thread_name\",\"args\":{\"name\":\"" << threadName << "\"}}";
+		}
+
+		for (auto const& event : events)
+		{
+			file << (firstEntry ? "\n" : ",\n");
+			firstEntry = false;
+			file << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->ThreadId << ",\"name\":\"" << event.Name << "\",\"cat\":\"" << event.Category << "\",\"ts\":";
+			WriteMicroseconds(file, SinceEpoch(event.Start - epoch));
+			file << ",\"dur\":";
+			WriteMicroseconds(file, SinceEpoch(event.Duration));
+
+			if (event.Argument != TraceNoArgument)
+			{
+				file << ",\"args\":{\"value\":" << event.Argument << "}";
+			}
+
+			file << "}";
+			written++;
+		}
+	}
+
+	file << "\n]}\n";
+	file.close();
+
+	spdlog::info("Tracer :: Wrote {} events of {} threads to {}", written, threads.size(), path);
+	return written;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+
+/// One completed span recorded by a thread. Names and categories must be string literals,
+/// so that recording never copies or allocates.
+class TraceEvent
+{
+public:
+	const char* Name;
+	const char* Category;
+	/// Optional value shown with the event (slave number, result code), TraceNoArgument if none
+	long long Argument;
+	std::chrono::steady_clock::time_point Start;
+	std::chrono::steady_clock::duration Duration;
+};
+
+const long long TraceNoArgument = -1;
+
+namespace TraceDetail
+{
+	extern std::atomic<bool> Enabled;
+}
+
+/// Cheap enough to test on every hot path call
+inline bool TracingEnabled()
+{
+	return TraceDetail::Enabled.load(std::memory_order_relaxed);
+}
+
+void SetTracingEnabled(bool enabled);
+/// Number of events each thread keeps, the oldest are overwritten. Applies to buffers created afterwards.
+void SetTraceBufferSize(size_t events);
+/// Names the calling thread in exported traces
+void SetTraceThreadName(const char* name);
+void RecordTraceEvent(const char* name, const char* category, long long argument, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+/// Writes the buffered events of all threads as Chrome trace-event JSON, which chrome://tracing
+/// and the Perfetto UI open directly. Returns the number of events written.
+size_t WriteTrace(std::string const& path);
+
+/// Records the time from construction to destruction as one event, if tracing was enabled at construction
+class TraceScope
+{
+public:
+	TraceScope(const char* name, const char* category, long long argument = TraceNoArgument)
+		: name(name), category(category), argument(argument), active(TracingEnabled())
+	{
+		if (this->active)
+		{
+			this->start = std::chrono::steady_clock::now();
+		}
+	}
+
+	~TraceScope()
+	{
+		if (this->active)
+		{
+			RecordTraceEvent(this->name, this->category, this->argument, this->start, std::chrono::steady_clock::now());
+		}
+	}
+
+	/// Replaces the argument, e.g. with the result of the traced call
+	void SetArgument(long long argument)
+	{
+		this->argument = argument;
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	const char* name;
+	const char* category;
+	long long argument;
+	bool active;
+	std::chrono::steady_clock::time_point start;
+};
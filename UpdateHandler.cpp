@@ -0,0 +1,32 @@
+#include "UpdateHandler.h"
+
+UpdateHandler::UpdateHandler(EnginesController* enginesController, PowerController* powerController, HardwareStateStore* stateStore)
+	: enginesController(enginesController), powerController(powerController), stateStore(stateStore)
+{
+}
+
+MessageString UpdateHandler::Process(std::string const& message, unsigned long stopGeneration)
+{
+	auto stateUpdate = this->messageParser.ParseToHardwareState(message);
+	auto returnedState = this->Apply(stateUpdate, stopGeneration);
+
+	return this->messageParser.ParseToUpdate(returnedState);
+}
+
+HardwareState UpdateHandler::Apply(HardwareState update, unsigned long stopGeneration)
+{
+	auto desiredState = update.MergedInto(this->stateStore->Current()->ToHardwareState());
+	auto returnedState = desiredState;
+
+	if (update.Fields & HardwareState::EngineFields)
+	{
+		returnedState = this->enginesController->UpdateHardwareState(desiredState, stopGeneration);
+	}
+
+	if (update.Fields & HardwareState::DesiredTemperatureField)
+	{
+		this->powerController->UpdatePowerState(desiredState);
+	}
+
+	return returnedState;
+}
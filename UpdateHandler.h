@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+
+#include "EnginesController.h"
+#include "HardwareStateStore.h"
+#include "PowerController.h"
+#include "MessageParser.h"
+#include "MessageArena.h"
+
+/// Applies hardware state updates to the engines and the power supply. Websocket
+/// update messages are decoded and answered here as well. Updates may carry only
+/// some fields, which are merged into the current desired state.
+class UpdateHandler
+{
+public:
+	UpdateHandler(EnginesController* enginesController, PowerController* powerController, HardwareStateStore* stateStore);
+
+	/// Returns the reply to be sent. Meant to run inside a MessageArenaScope.
+	MessageString Process(std::string const& message, unsigned long stopGeneration);
+	/// Applies the fields of update and returns the resulting hardware state. The engines
+	/// are only touched for engine fields, the power supply only for the temperature.
+	HardwareState Apply(HardwareState update, unsigned long stopGeneration);
+
+private:
+	MessageParser messageParser;
+	EnginesController* enginesController;
+	PowerController* powerController;
+	HardwareStateStore* stateStore;
+};
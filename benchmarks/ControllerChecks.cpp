@@ -0,0 +1,657 @@
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "HardwareStateStore.h"
+#include "MessageParser.h"
+#include "OutboundQueue.h"
+#include "PeriodicScheduler.h"
+#include "SensorProtocol.h"
+#include "TelemetryArchive.h"
+
+namespace
+{
+	/// COBS decoding written independently of SensorFrameDecoder, so that a bug shared by the
+	/// controller and the emulator, which use the same encoder, does not cancel out. Returns
+	/// false if frame is not one COBS packet followed by its delimiter.
+	bool ReferenceCobsDecode(std::vector<unsigned char> const& frame, std::vector<unsigned char>& raw)
+	{
+		raw.clear();
+		if (frame.size() < 2 || frame.back() != 0)
+		{
+			return false;
+		}
+
+		size_t end = frame.size() - 1;
+		size_t i = 0;
+		while (i < end)
+		{
+			size_t code = frame[i];
+			if (code == 0 || i + code > end)
+			{
+				return false;
+			}
+
+			for (size_t j = i + 1; j < i + code; j++)
+			{
+				if (frame[j] == 0)
+				{
+					return false;
+				}
+				raw.push_back(frame[j]);
+			}
+
+			i += code;
+			if (code != 0xFF && i < end)
+			{
+				raw.push_back(0);
+			}
+		}
+
+		return true;
+	}
+
+	/// Frames the decoder delivered, as type followed by the payload
+	std::vector<std::vector<unsigned char>> FeedDecoder(SensorFrameDecoder& decoder, std::vector<unsigned char> const& bytes)
+	{
+		std::vector<std::vector<unsigned char>> frames;
+		decoder.Feed(bytes.data(), bytes.size(), [&frames](SensorFrame const& frame)
+		{
+			std::vector<unsigned char> decoded(1 + std::min(frame.Size, MaxSensorPayload));
+			decoded[0] = frame.Type;
+			for (size_t i = 1; i < decoded.size(); i++)
+			{
+				decoded[i] = frame.Payload[i - 1];
+			}
+			frames.push_back(decoded);
+		});
+		return frames;
+	}
+
+	/// Encodes payload and checks the frame against the reference decoder and SensorFrameDecoder.
+	/// Payloads beyond MaxSensorPayload must be dropped as framing errors without losing sync.
+	std::string CheckSensorFrame(unsigned char type, std::vector<unsigned char> const& payload)
+	{
+		auto name = "type " + std::to_string(type) + " payload of " + std::to_string(payload.size()) + " bytes";
+		auto encoded = EncodeSensorFrame(type, payload.data(), payload.size());
+
+		std::vector<unsigned char> raw;
+		if (!ReferenceCobsDecode(encoded, raw))
+		{
+			return name + ": not a valid COBS frame";
+		}
+
+		std::vector<unsigned char> expected(1, type);
+		expected.insert(expected.end(), payload.begin(), payload.end());
+		auto crc = SensorCrc(expected.data(), expected.size());
+		if (raw.size() != expected.size() + 2 || !std::equal(expected.begin(), expected.end(), raw.begin()) ||
+			raw[raw.size() - 2] != (crc & 0xFF) || raw[raw.size() - 1] != (crc >> 8))
+		{
+			return name + ": encoded bytes do not decode to type, payload and CRC";
+		}
+
+		// A short frame behind it shows whether the decoder is in sync again
+		unsigned char marker = 0x5A;
+		auto follower = EncodeSensorFrame(SensorAck, &marker, 1);
+		encoded.insert(encoded.end(), follower.begin(), follower.end());
+
+		SensorFrameDecoder decoder;
+		auto frames = FeedDecoder(decoder, encoded);
+		std::vector<unsigned char> followerFrame = { SensorAck, marker };
+
+		if (payload.size() <= MaxSensorPayload)
+		{
+			if (frames.size() != 2 || frames[0] != expected || frames[1] != followerFrame)
+			{
+				return name + ": decoder did not return the frame";
+			}
+		}
+		else if (frames.size() != 1 || frames[0] != followerFrame || decoder.FramingErrors() != 1)
+		{
+			return name + ": oversized frame was not dropped as a framing error";
+		}
+
+		return "";
+	}
+
+	std::string CheckSensorProtocol()
+	{
+		// Check value of CRC-16/CCITT-FALSE
+		const char* check = "123456789";
+		if (SensorCrc(reinterpret_cast<const unsigned char*>(check), 9) != 0x29B1)
+		{
+			return "CRC of \"123456789\" is not 0x29B1";
+		}
+
+		std::vector<std::vector<unsigned char>> payloads = { {}, { 0 }, { 0, 0 }, { 0x11, 0x22, 0, 0x33 }, std::vector<unsigned char>(MaxSensorPayload, 0) };
+
+		// Runs just below, at and beyond the 254 bytes a COBS code byte can cover
+		for (size_t size : { MaxSensorPayload, (size_t)252, (size_t)253, (size_t)254, (size_t)255, (size_t)508, (size_t)600 })
+		{
+			payloads.push_back(std::vector<unsigned char>(size, 0xA5));
+		}
+
+		std::vector<unsigned char> mixed(600);
+		for (size_t i = 0; i < mixed.size(); i++)
+		{
+			// A zero every 300 bytes leaves runs longer than 254 bytes between them
+			mixed[i] = i % 300 == 0 ? 0 : (unsigned char)(i % 255 + 1);
+		}
+		payloads.push_back(mixed);
+
+		for (auto const& payload : payloads)
+		{
+			auto error = CheckSensorFrame(SensorSamples, payload);
+			if (!error.empty())
+			{
+				return error;
+			}
+		}
+
+		// Readings whose temperatures and device time encode to zero bytes
+		SensorReading reading = SensorReading();
+		reading.DeviceTime = 0x01000000;
+		reading.ChannelMask = 0xFF;
+		const double temperatures[SensorChannelCount] = { 0, 2.56, -0.01, 327.67, -327.68, 36.62, 0.01, 1.28 };
+		std::copy(temperatures, temperatures + SensorChannelCount, reading.Temperatures);
+
+		SensorFrameDecoder readings;
+		auto frames = FeedDecoder(readings, EncodeSensorReading(reading));
+		SensorFrame frame = SensorFrame();
+		SensorReading decoded = SensorReading();
+		if (frames.size() != 1)
+		{
+			return "Reading with zero bytes was not decoded";
+		}
+
+		frame.Type = frames[0][0];
+		frame.Size = frames[0].size() - 1;
+		std::copy(frames[0].begin() + 1, frames[0].end(), frame.Payload);
+		if (!DecodeSensorReading(frame, decoded) || decoded.DeviceTime != reading.DeviceTime || decoded.ChannelMask != reading.ChannelMask)
+		{
+			return "Reading does not decode to its device time and channels";
+		}
+
+		for (int channel = 0; channel < SensorChannelCount; channel++)
+		{
+			if (std::abs(decoded.Temperatures[channel] - reading.Temperatures[channel]) > 0.001)
+			{
+				return "Channel " + std::to_string(channel) + " decoded as " + std::to_string(decoded.Temperatures[channel]);
+			}
+		}
+
+		// The type byte never is zero, so it directly follows the first code byte. Changing it keeps
+		// the COBS structure intact and has to be caught by the CRC.
+		auto corrupted = EncodeSensorReading(reading);
+		corrupted[1] ^= 0x80;
+		SensorFrameDecoder crcDecoder;
+		if (!FeedDecoder(crcDecoder, corrupted).empty() || crcDecoder.CrcErrors() != 1)
+		{
+			return "Corrupted frame was not rejected by the CRC";
+		}
+
+		// Line noise, a torn frame and an overlong run of garbage, each ended by a delimiter
+		std::vector<unsigned char> stream = { 0x13, 0x37, 0xFF, 0x02, 0 };
+		auto torn = EncodeSensorReading(reading);
+		stream.insert(stream.end(), torn.begin() + torn.size() / 2, torn.end());
+		stream.insert(stream.end(), 200, 0x7E);
+		stream.push_back(0);
+		stream.push_back(0);
+		auto valid = EncodeSensorReading(reading);
+		stream.insert(stream.end(), valid.begin(), valid.end());
+
+		SensorFrameDecoder resync;
+		frames = FeedDecoder(resync, stream);
+		if (frames.size() != 1 || resync.Frames() != 1 || resync.CrcErrors() + resync.FramingErrors() != 3)
+		{
+			return "Decoder did not resynchronize after garbage, " + std::to_string(frames.size()) + " frames " +
+				std::to_string(resync.CrcErrors()) + " CRC errors " + std::to_string(resync.FramingErrors()) + " framing errors";
+		}
+
+		return "";
+	}
+}
+
+namespace
+{
+	/// Any double: runs of one value, a drifting reading, and the ones XOR compression gets wrong
+	/// most easily, NaN, infinity, negative zero, denormals and random bit patterns
+	double ArchiveTestValue(std::mt19937_64& random, double previous)
+	{
+		switch (random() % 16)
+		{
+			case 0:
+				return std::numeric_limits<double>::quiet_NaN();
+			case 1:
+				return -std::numeric_limits<double>::infinity();
+			case 2:
+				return -0.0;
+			case 3:
+				return std::numeric_limits<double>::denorm_min() * (double)(random() % 1000);
+			case 4:
+			case 5:
+			{
+				auto bits = random();
+				double value;
+				std::memcpy(&value, &bits, sizeof(value));
+				return value;
+			}
+			case 6:
+			case 7:
+			case 8:
+				return std::isfinite(previous) ? previous + ((int)(random() % 2001) - 1000) / 100.0 : 21.5;
+			default:
+				return previous;
+		}
+	}
+
+	/// Irregular wall clock steps: jitter around 1 ms, repeated intervals, hour-long gaps and the clock
+	/// being set back, so the delta-of-delta varints take every length and both signs
+	long long NextArchiveTime(std::mt19937_64& random, long long time, long long& delta)
+	{
+		switch (random() % 32)
+		{
+			case 0:
+				delta = 3600000000ll;
+				break;
+			case 1:
+				delta = -(long long)(random() % 86400000000ull);
+				break;
+			case 2:
+			case 3:
+			case 4:
+			case 5:
+				break;
+			default:
+				delta = 1000 + (long long)(random() % 201) - 100;
+				break;
+		}
+		return time + delta;
+	}
+
+	bool SameBits(double a, double b)
+	{
+		return std::memcmp(&a, &b, sizeof(a)) == 0;
+	}
+
+	/// Value and bit pattern, values differing in their last bits print alike otherwise
+	std::string DescribeDouble(double value)
+	{
+		unsigned long long bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		char text[64];
+		snprintf(text, sizeof(text), "%.17g (%016llx)", value, bits);
+		return text;
+	}
+
+	/// Appends rows to an archive at path through both Append overloads, mirroring what every row
+	/// has to hold, and compares them with what Scan decodes again: all rows, then a window. The
+	/// segments are small enough to rotate several times. Returns what differed, empty on success.
+	std::string CheckArchiveRoundTrip(std::string const& path)
+	{
+		std::mt19937_64 random(49);
+		std::vector<ArchiveRow> expected;
+
+		ArchiveRow current = ArchiveRow();
+		for (int channel = 0; channel < TelemetryChannelCount; channel++)
+		{
+			auto thermocouple = channel == TelemetryField::CurrentTemperature || channel >= TelemetryFieldCount;
+			current.Values[channel] = thermocouple ? std::numeric_limits<double>::quiet_NaN() : 0;
+		}
+
+		{
+			// Blocks are written when full, the last one when the archive is destroyed
+			std::unique_ptr<TelemetryArchive> archive(new TelemetryArchive(path, 0, 0, std::chrono::hours(1)));
+
+			HardwareSnapshot snapshot = HardwareSnapshot();
+			StateField<int>* integral[] = { &snapshot.Engine1Speed, &snapshot.Engine2Speed, &snapshot.Engine1ActualSpeed, &snapshot.Engine2ActualSpeed, &snapshot.Alarms, &snapshot.DesiredTemperature };
+			TelemetryField integralFields[] = { TelemetryField::Engine1Speed, TelemetryField::Engine2Speed, TelemetryField::Engine1ActualSpeed, TelemetryField::Engine2ActualSpeed, TelemetryField::Alarms, TelemetryField::DesiredTemperature };
+			auto changedAt = std::chrono::steady_clock::time_point();
+			auto first = true;
+
+			auto time = 1700000000000000ll;
+			auto delta = 1000ll;
+
+			while (expected.size() < 96 * ArchiveBlockRows + 321)
+			{
+				time = NextArchiveTime(random, time, delta);
+				auto added = true;
+
+				if (random() % 3 == 0)
+				{
+					// Fields whose timestamp did not move are left out even though their value differs,
+					// CurrentTemperature always is
+					changedAt += std::chrono::microseconds(1);
+					added = first;
+					for (size_t i = 0; i < sizeof(integral) / sizeof(integral[0]); i++)
+					{
+						auto changes = first || random() % 2 == 0;
+						integral[i]->Value = (int)random();
+						if (changes)
+						{
+							integral[i]->Timestamp = changedAt;
+							current.Values[integralFields[i]] = integral[i]->Value;
+							added = true;
+						}
+					}
+
+					snapshot.SupplyVoltage.Value = ArchiveTestValue(random, snapshot.SupplyVoltage.Value);
+					if (first || random() % 2 == 0)
+					{
+						snapshot.SupplyVoltage.Timestamp = changedAt;
+						current.Values[TelemetryField::SupplyVoltage] = snapshot.SupplyVoltage.Value;
+						added = true;
+					}
+
+					snapshot.CurrentTemperature.Value = ArchiveTestValue(random, snapshot.CurrentTemperature.Value);
+					snapshot.CurrentTemperature.Timestamp = changedAt;
+					first = false;
+
+					archive->Append(snapshot, time);
+				}
+				else
+				{
+					SensorReading reading = SensorReading();
+					reading.ChannelMask = (unsigned char)random();
+					for (int thermocouple = 0; thermocouple < SensorChannelCount; thermocouple++)
+					{
+						auto channel = ThermocoupleChannel(thermocouple);
+						reading.Temperatures[thermocouple] = ArchiveTestValue(random, current.Values[channel]);
+						if (reading.ChannelMask & (1 << thermocouple))
+						{
+							current.Values[channel] = reading.Temperatures[thermocouple];
+						}
+					}
+
+					archive->Append(reading, time);
+				}
+
+				if (!added)
+				{
+					continue;
+				}
+
+				current.Time = time;
+				expected.push_back(current);
+
+				// Rows are only dropped if the writer falls behind by a block, which is not what is checked here
+				if (expected.size() % ArchiveBlockRows == 0)
+				{
+					auto waitUntil = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+					while (archive->RowsWritten() < expected.size() && std::chrono::steady_clock::now() < waitUntil)
+					{
+						std::this_thread::sleep_for(std::chrono::microseconds(100));
+					}
+				}
+			}
+
+			if (archive->RowsDropped() != 0)
+			{
+				return std::to_string(archive->RowsDropped()) + " rows dropped";
+			}
+		}
+
+		TelemetryArchiveReader reader(path);
+		if (reader.Segments().size() < 3)
+		{
+			return "Archive did not rotate, " + std::to_string(reader.Segments().size()) + " segments";
+		}
+
+		size_t index = 0;
+		std::string error;
+		reader.Scan(LLONG_MIN, LLONG_MAX, [&](ArchiveRow const& row)
+		{
+			if (!error.empty())
+			{
+				return;
+			}
+
+			if (index >= expected.size())
+			{
+				error = "More rows scanned than appended";
+				return;
+			}
+
+			auto const& wanted = expected[index];
+			if (row.Time != wanted.Time)
+			{
+				error = "Row " + std::to_string(index) + " time " + std::to_string(row.Time) + " instead of " + std::to_string(wanted.Time);
+			}
+
+			for (int channel = 0; channel < TelemetryChannelCount && error.empty(); channel++)
+			{
+				if (!SameBits(row.Values[channel], wanted.Values[channel]))
+				{
+					error = "Row " + std::to_string(index) + " " + TelemetryChannelName(channel) + " " + DescribeDouble(row.Values[channel]) + " instead of " + DescribeDouble(wanted.Values[channel]);
+				}
+			}
+
+			index++;
+		});
+
+		if (!error.empty())
+		{
+			return error;
+		}
+
+		if (index != expected.size())
+		{
+			return std::to_string(index) + " of " + std::to_string(expected.size()) + " rows scanned";
+		}
+
+		// The index entries skip blocks outside the window, the rows inside have to be found all the same
+		auto from = expected[expected.size() / 3].Time;
+		auto to = from + 600000000ll;
+		auto inWindow = std::count_if(expected.begin(), expected.end(), [from, to](ArchiveRow const& row) { return row.Time >= from && row.Time <= to; });
+		auto scanned = reader.Scan(from, to, [](ArchiveRow const&) {});
+		if (scanned != (unsigned long long)inWindow)
+		{
+			return "Window scan found " + std::to_string(scanned) + " rows instead of " + std::to_string(inWindow);
+		}
+
+		return "";
+	}
+
+	/// Overwrites the row count stored at the start of the first block of segment with rows. The
+	/// offset of the block is read from the first index entry, which follows the fields of the
+	/// segment header: four u32, DataEnd, FirstTime and LastTime, then the entry's own times.
+	bool DamageFirstBlock(std::string const& segment, uint32_t rows)
+	{
+		std::fstream file(segment, std::ios::in | std::ios::out | std::ios::binary);
+		uint64_t offset = 0;
+		file.seekg(4 * 4 + 3 * 8 + 2 * 8);
+		file.read(reinterpret_cast<char*>(&offset), sizeof(offset));
+		file.seekp((std::streamoff)offset);
+		file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+		return (bool)file;
+	}
+
+	/// A block whose row count is damaged is skipped by Scan, the other blocks are still read
+	std::string CheckDamagedArchiveBlocks(std::string const& path)
+	{
+		{
+			std::unique_ptr<TelemetryArchive> archive(new TelemetryArchive(path, 0, 0, std::chrono::hours(1)));
+
+			SensorReading reading = SensorReading();
+			reading.ChannelMask = 1;
+			for (size_t row = 1; row <= 3 * ArchiveBlockRows; row++)
+			{
+				reading.Temperatures[0] = 20 + row * 0.01;
+				archive->Append(reading, 1700000000000000ll + (long long)row * 1000);
+
+				while (row % ArchiveBlockRows == 0 && archive->RowsWritten() < row)
+				{
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+				}
+			}
+		}
+
+		TelemetryArchiveReader reader(path);
+		if (reader.Segments().size() != 1)
+		{
+			return std::to_string(reader.Segments().size()) + " segments written instead of 1";
+		}
+
+		for (uint32_t rows : { 0u, 0xFFFFFFFFu, (uint32_t)ArchiveBlockRows - 1 })
+		{
+			if (!DamageFirstBlock(reader.Segments()[0], rows))
+			{
+				return "Cannot damage " + reader.Segments()[0];
+			}
+
+			auto scanned = reader.Scan(LLONG_MIN, LLONG_MAX, [](ArchiveRow const&) {});
+			if (scanned != 2 * ArchiveBlockRows)
+			{
+				return "Block claiming " + std::to_string(rows) + " rows: " + std::to_string(scanned) + " rows scanned instead of " + std::to_string(2 * ArchiveBlockRows);
+			}
+		}
+
+		return "";
+	}
+
+	std::string CheckTelemetryArchive()
+	{
+		auto directory = std::filesystem::temp_directory_path() / ("controller_checks_archive_" + std::to_string(getpid()));
+		auto error = CheckArchiveRoundTrip((directory / "telemetry").string());
+		std::filesystem::remove_all(directory);
+		return error;
+	}
+
+	std::string CheckDamagedArchive()
+	{
+		auto directory = std::filesystem::temp_directory_path() / ("controller_checks_damaged_" + std::to_string(getpid()));
+		auto error = CheckDamagedArchiveBlocks((directory / "telemetry").string());
+		std::filesystem::remove_all(directory);
+		return error;
+	}
+}
+
+namespace
+{
+	/// Tasks on a pool of several threads run once per period: every pool thread that is idle
+	/// waits for the earliest deadline, only one of them may run the task when it is reached
+	std::string CheckSchedulerRunsOncePerPeriod()
+	{
+		const auto duration = std::chrono::milliseconds(600);
+		const std::chrono::microseconds periods[] = { std::chrono::milliseconds(2), std::chrono::milliseconds(3), std::chrono::milliseconds(5) };
+		std::atomic<unsigned long long> runs[3];
+
+		auto started = std::chrono::steady_clock::now();
+		{
+			PeriodicScheduler scheduler(-1, 0, 8);
+			std::vector<PeriodicScheduler::TaskId> tasks;
+			for (int i = 0; i < 3; i++)
+			{
+				runs[i] = 0;
+				tasks.push_back(scheduler.Add("check " + std::to_string(i), periods[i], [&runs, i]
+				{
+					runs[i]++;
+					return true;
+				}));
+			}
+
+			std::this_thread::sleep_for(duration);
+			for (auto task : tasks)
+			{
+				scheduler.Remove(task);
+			}
+		}
+		auto elapsed = std::chrono::steady_clock::now() - started;
+
+		for (int i = 0; i < 3; i++)
+		{
+			// The first run is immediate, overruns skip periods but never add runs
+			auto maxRuns = (unsigned long long)(elapsed / periods[i]) + 1;
+			if (runs[i] > maxRuns || runs[i] == 0)
+			{
+				return "Task with a period of " + std::to_string(periods[i].count()) + " us ran " + std::to_string(runs[i].load()) +
+					" times in " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) + " ms, at most " + std::to_string(maxRuns) + " expected";
+			}
+		}
+
+		return "";
+	}
+}
+
+namespace
+{
+	/// Readings waiting for the writer are coalesced per thermocouple, one channel never replaces another
+	std::string CheckTemperatureCoalescing()
+	{
+		OutboundQueue queue;
+		for (int round = 0; round < 3; round++)
+		{
+			for (int channel = 0; channel < SensorChannelCount; channel++)
+			{
+				queue.Push(std::to_string(channel) + ":" + std::to_string(round), OutboundType::TemperatureReading, channel);
+			}
+		}
+
+		std::vector<std::string> messages;
+		queue.PopBatch(messages, 64, std::chrono::milliseconds(0));
+		if (messages.size() != (size_t)SensorChannelCount)
+		{
+			return std::to_string(messages.size()) + " readings queued for " + std::to_string(SensorChannelCount) + " channels";
+		}
+
+		for (int channel = 0; channel < SensorChannelCount; channel++)
+		{
+			if (messages[channel] != std::to_string(channel) + ":2")
+			{
+				return "Channel " + std::to_string(channel) + " sent " + messages[channel] + " instead of its latest reading";
+			}
+		}
+
+		return "";
+	}
+}
+
+/// Correctness checks of the codecs and formats the benchmarks time. Unlike a benchmark, a failed
+/// check fails the run: the exit code is non-zero.
+int main()
+{
+	// Only the outcome of the checks is reported
+	spdlog::set_level(spdlog::level::off);
+
+	std::vector<std::pair<std::string, std::function<std::string()>>> checks = {
+		{ "sensor protocol", CheckSensorProtocol },
+		{ "telemetry archive", CheckTelemetryArchive },
+		{ "damaged archive blocks skipped", CheckDamagedArchive },
+		{ "scheduler runs once per period", CheckSchedulerRunsOncePerPeriod },
+		{ "temperature readings coalesced per channel", CheckTemperatureCoalescing },
+	};
+
+	int failed = 0;
+	for (auto const& check : checks)
+	{
+		auto error = check.second();
+		if (error.empty())
+		{
+			std::printf("ok    %s\n", check.first.c_str());
+		}
+		else
+		{
+			std::printf("FAIL  %s: %s\n", check.first.c_str(), error.c_str());
+			failed++;
+		}
+	}
+
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
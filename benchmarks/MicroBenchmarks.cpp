@@ -0,0 +1,493 @@
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "AllocationCounter.h"
+#include "ConfigFile.h"
+#include "EnginesController.h"
+#include "HardwareStateStore.h"
+#include "MessageArena.h"
+#include "MessageParser.h"
+#include "OutboundQueue.h"
+#include "PeriodicScheduler.h"
+#include "PowerController.h"
+#include "PowerSupplyEmulator.h"
+#include "PseudoTerminal.h"
+#include "SensorProtocol.h"
+#include "SimulatedDriver.h"
+#include "TelemetryArchive.h"
+#include "ThermalModel.h"
+#include "Tracer.h"
+
+namespace
+{
+	/// Messages as sent by the websocket server
+	const std::vector<std::string> UpdateCorpus = {
+		R"({"type":"update","desiredTemperature":"0","engine1Direction":"1","engine1Speed":"0","engine2Direction":"1","engine2Speed":"0"})",
+		R"({"type":"update","desiredTemperature":"40","engine1Direction":"1","engine1Speed":"2000","engine2Direction":"0","engine2Speed":"1500"})",
+		R"({"type":"update","desiredTemperature":"120","engine1Direction":"0","engine1Speed":"12500","engine2Direction":"1","engine2Speed":"12500"})",
+		R"({"type":"update","engine1Speed":"2500"})",
+	};
+
+	const std::vector<std::string> CommandCorpus = {
+		R"({"type":"command","command":"connect"})",
+		R"({"type":"command","command":"disconnect"})",
+		R"({"type":"command","command":"stop"})",
+	};
+
+	const std::vector<std::string> MessageCorpus = {
+		UpdateCorpus[1],
+		CommandCorpus[0],
+		R"({"type":"status"})",
+	};
+
+	/// Reports global allocations per iteration next to the timings
+	class AllocationCounter
+	{
+	public:
+		AllocationCounter() : start(AllocationCount())
+		{
+		}
+
+		void Report(benchmark::State& state)
+		{
+			state.counters["allocs"] = benchmark::Counter((double)(AllocationCount() - this->start), benchmark::Counter::kAvgIterations);
+		}
+
+	private:
+		unsigned long long start;
+	};
+
+	/// Ramp steps run here like in the application, with a zero period they run back to back
+	PeriodicScheduler scheduler;
+
+	EnginesController CreateEnginesController(HardwareStateStore* stateStore)
+	{
+		return EnginesController(6, 115200, 0, 1, 1, 1, 1, 1, 1, 1, stateStore, &scheduler);
+	}
+}
+
+static void BM_GetMessageType(benchmark::State& state)
+{
+	MessageParser parser;
+	auto const& message = MessageCorpus[state.range(0)];
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(parser.GetMessageType(message));
+	}
+
+	allocations.Report(state);
+	state.SetBytesProcessed(state.iterations() * message.size());
+}
+BENCHMARK(BM_GetMessageType)->DenseRange(0, 2);
+
+static void BM_GetCommandType(benchmark::State& state)
+{
+	MessageParser parser;
+	auto const& message = CommandCorpus[state.range(0)];
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(parser.GetCommandType(message));
+	}
+
+	allocations.Report(state);
+}
+BENCHMARK(BM_GetCommandType)->DenseRange(0, 2);
+
+static void BM_ParseToHardwareState(benchmark::State& state)
+{
+	MessageParser parser;
+	MessageArena arena;
+	auto const& message = UpdateCorpus[state.range(0)];
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		MessageArenaScope arenaScope(arena);
+		benchmark::DoNotOptimize(parser.ParseToHardwareState(message));
+	}
+
+	allocations.Report(state);
+	state.SetBytesProcessed(state.iterations() * message.size());
+}
+BENCHMARK(BM_ParseToHardwareState)->DenseRange(0, 3);
+
+static void BM_ParseToUpdate(benchmark::State& state)
+{
+	MessageParser parser;
+	MessageArena arena;
+	auto hardwareState = HardwareState();
+	hardwareState.Engine1Speed = 12500;
+	hardwareState.Engine2Speed = 1500;
+	hardwareState.Engine1Direction = 1;
+	hardwareState.Engine2Direction = 0;
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		MessageArenaScope arenaScope(arena);
+		auto reply = parser.ParseToUpdate(hardwareState);
+		benchmark::DoNotOptimize(reply.data());
+	}
+
+	allocations.Report(state);
+}
+BENCHMARK(BM_ParseToUpdate);
+
+static void BM_ParseToStatus(benchmark::State& state)
+{
+	MessageParser parser;
+	HardwareStateStore stateStore;
+	stateStore.SetEngines(12500, 1, 1500, 0, StateSource::EnginesDriver);
+	stateStore.SetCurrentTemperature(36.6, StateSource::Arduino);
+	auto snapshot = stateStore.Current();
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(parser.ParseToStatus(*snapshot, true, 81234567));
+	}
+
+	allocations.Report(state);
+}
+BENCHMARK(BM_ParseToStatus);
+
+static void BM_ParseToEngineConnectionState(benchmark::State& state)
+{
+	MessageParser parser;
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(parser.ParseToEngineConnectionState(true));
+	}
+
+	allocations.Report(state);
+}
+BENCHMARK(BM_ParseToEngineConnectionState);
+
+static void BM_ParseToTemperatureState(benchmark::State& state)
+{
+	MessageParser parser;
+	std::string temperature("36.62");
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(parser.ParseToTemperatureState(temperature, 81234567));
+	}
+
+	allocations.Report(state);
+}
+BENCHMARK(BM_ParseToTemperatureState);
+
+static void BM_ParseToStopState(benchmark::State& state)
+{
+	MessageParser parser;
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(parser.ParseToStopState(81234567, std::chrono::microseconds(420), std::chrono::microseconds(1800)));
+	}
+
+	allocations.Report(state);
+}
+BENCHMARK(BM_ParseToStopState);
+
+static void BM_ParseToTelemetry(benchmark::State& state)
+{
+	MessageParser parser;
+	auto frame = TelemetryFrame();
+	frame.Sequence = 1042;
+	frame.Keyframe = false;
+	frame.SampledAt = 81234567;
+	frame.Values.push_back(std::make_pair(TelemetryField::Engine1ActualSpeed, 12480.0));
+	frame.Values.push_back(std::make_pair(TelemetryField::CurrentTemperature, 36.62));
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(parser.ParseToTelemetry(frame));
+	}
+
+	allocations.Report(state);
+}
+BENCHMARK(BM_ParseToTelemetry);
+
+/// Push and batch pop under a full queue, where every push drops or coalesces a queued message
+static void BM_OutboundQueueFull(benchmark::State& state)
+{
+	OutboundQueue queue(256);
+	std::vector<std::string> batch;
+	const std::string frame = R"({"type":"telemetry","sequence":1042,"keyframe":false,"fields":{"currentTemperature":36.62}})";
+
+	for (int i = 0; i < 256; i++)
+	{
+		queue.Push(frame, OutboundType::TelemetryUpdate);
+	}
+
+	for (auto _ : state)
+	{
+		queue.Push(frame, OutboundType::TelemetryUpdate);
+		queue.Push(frame, OutboundType::TemperatureReading);
+		queue.Push(frame, OutboundType::StatusReply);
+	}
+
+	batch.clear();
+	queue.PopBatch(batch, 1024, std::chrono::milliseconds(0));
+	state.counters["dropped"] = (double)queue.Dropped(OutboundType::TelemetryUpdate);
+}
+BENCHMARK(BM_OutboundQueueFull);
+
+/// Cost a trace scope adds to an instrumented call, with tracing off (0) and on (1)
+static void BM_TraceScope(benchmark::State& state)
+{
+	SetTracingEnabled(state.range(0) != 0);
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		TraceScope trace("benchmark", "benchmark", 1);
+		benchmark::ClobberMemory();
+	}
+
+	allocations.Report(state);
+	SetTracingEnabled(false);
+}
+BENCHMARK(BM_TraceScope)->Arg(0)->Arg(1);
+
+/// Full start ramp followed by a full stop ramp of both engines. The argument is the
+/// simulated driver latency per call (in us); ramp ticks have no period.
+static void BM_RampStartStop(benchmark::State& state)
+{
+	HardwareStateStore stateStore;
+	auto enginesController = CreateEnginesController(&stateStore);
+	enginesController.SetRampTickInterval(std::chrono::microseconds(0));
+	SimulatedDriverSetLatency(std::chrono::microseconds(state.range(0)));
+	enginesController.Connect();
+
+	auto running = HardwareState();
+	running.Engine1Speed = 12500;
+	running.Engine2Speed = 10000;
+	running.Engine1Direction = 1;
+	running.Engine2Direction = 1;
+	auto stopped = running;
+	stopped.Engine1Speed = 0;
+	stopped.Engine2Speed = 0;
+
+	auto calls = SimulatedDriverCallCount();
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		enginesController.UpdateHardwareState(running, enginesController.StopGeneration());
+		enginesController.UpdateHardwareState(stopped, enginesController.StopGeneration());
+	}
+
+	allocations.Report(state);
+	state.counters["driverCalls"] = benchmark::Counter((double)(SimulatedDriverCallCount() - calls), benchmark::Counter::kAvgIterations);
+
+	enginesController.Disconnect();
+	SimulatedDriverSetLatency(std::chrono::microseconds(0));
+}
+BENCHMARK(BM_RampStartStop)->Arg(0)->Arg(50)->Unit(benchmark::kMicrosecond);
+
+/// Speed change ramp of one engine, alternating between two speeds
+static void BM_RampChangeSpeed(benchmark::State& state)
+{
+	HardwareStateStore stateStore;
+	auto enginesController = CreateEnginesController(&stateStore);
+	enginesController.SetRampTickInterval(std::chrono::microseconds(0));
+	enginesController.Connect();
+
+	auto slow = HardwareState();
+	slow.Engine1Speed = 2000;
+	slow.Engine2Speed = 0;
+	slow.Engine1Direction = 1;
+	slow.Engine2Direction = 1;
+	auto fast = slow;
+	fast.Engine1Speed = 8000;
+
+	enginesController.UpdateHardwareState(slow, enginesController.StopGeneration());
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		enginesController.UpdateHardwareState(fast, enginesController.StopGeneration());
+		enginesController.UpdateHardwareState(slow, enginesController.StopGeneration());
+	}
+
+	allocations.Report(state);
+	enginesController.Disconnect();
+}
+BENCHMARK(BM_RampChangeSpeed)->Unit(benchmark::kMicrosecond);
+
+/// Voltage sequence of the power controller written to the emulated supply over a
+/// pseudo-terminal, until the supply accepted all of its commands. The controller paces its
+/// commands 100 ms apart and does not wait for the replies.
+static void BM_PowerSupplySequence(benchmark::State& state)
+{
+	const unsigned long long commandsPerSequence = 3;
+
+	ThermalModel model(22, std::chrono::seconds(30));
+	PseudoTerminal terminal("/tmp/ttyWDS-benchmark-psu");
+	PowerSupplyEmulator supply(&terminal, &model, std::chrono::milliseconds(20), std::chrono::milliseconds(0));
+	supply.Start();
+
+	boost::asio::io_service io;
+	HardwareStateStore stateStore;
+	PowerController powerController(terminal.LinkPath(), 9600, &io, &stateStore, &scheduler);
+
+	auto update = HardwareState();
+	update.DesiredTemperature = 40;
+
+	for (auto _ : state)
+	{
+		auto accepted = supply.Commands() + commandsPerSequence;
+
+		// Alternating temperatures, an unchanged one would not be sent at all
+		update.DesiredTemperature = update.DesiredTemperature == 40 ? 120 : 40;
+		powerController.UpdatePowerState(update);
+
+		while (supply.Commands() < accepted)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	state.counters["unknownCommands"] = (double)supply.UnknownCommands();
+
+	// Lets the sequence close the port before the terminal goes away
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	supply.Stop();
+}
+BENCHMARK(BM_PowerSupplySequence)->Unit(benchmark::kMillisecond)->Iterations(5);
+
+static void BM_ConfigFileLoad(benchmark::State& state)
+{
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		ConfigFile cf(WDS_CONFIG_FILE);
+		benchmark::DoNotOptimize(&cf);
+	}
+
+	allocations.Report(state);
+}
+BENCHMARK(BM_ConfigFileLoad);
+
+static void BM_ConfigFileLookup(benchmark::State& state)
+{
+	ConfigFile cf(WDS_CONFIG_FILE);
+	AllocationCounter allocations;
+
+	for (auto _ : state)
+	{
+		std::string value = cf.Value("engines", "engine2EasyChange");
+		benchmark::DoNotOptimize(value.data());
+	}
+
+	allocations.Report(state);
+}
+BENCHMARK(BM_ConfigFileLookup);
+
+/// Sensor frames encoded and decoded again, controller_checks verifies the codec itself
+static void BM_SensorFrameRoundTrip(benchmark::State& state)
+{
+	SensorReading reading = SensorReading();
+	reading.DeviceTime = 81234567;
+	reading.ChannelMask = 0xFF;
+	for (int channel = 0; channel < SensorChannelCount; channel++)
+	{
+		reading.Temperatures[channel] = 20 + channel * 0.25;
+	}
+
+	SensorFrameDecoder decoder;
+	SensorReading decoded = SensorReading();
+
+	for (auto _ : state)
+	{
+		auto encoded = EncodeSensorReading(reading);
+		decoder.Feed(encoded.data(), encoded.size(), [&decoded](SensorFrame const& frame) { DecodeSensorReading(frame, decoded); });
+		benchmark::DoNotOptimize(decoded);
+	}
+
+	state.counters["crcErrors"] = (double)decoder.CrcErrors();
+}
+BENCHMARK(BM_SensorFrameRoundTrip);
+
+/// Scans a whole archive of thermocouple readings drifting like in a heating run, controller_checks
+/// verifies that the rows come back unchanged
+static void BM_ArchiveScan(benchmark::State& state)
+{
+	auto directory = std::filesystem::temp_directory_path() / ("controller_benchmark_archive_" + std::to_string(getpid()));
+	auto path = (directory / "telemetry").string();
+	const size_t rows = 64 * ArchiveBlockRows;
+
+	{
+		std::unique_ptr<TelemetryArchive> archive(new TelemetryArchive(path, 0, 0, std::chrono::hours(1)));
+
+		SensorReading reading = SensorReading();
+		reading.ChannelMask = 0xFF;
+		auto time = 1700000000000000ll;
+		for (size_t row = 1; row <= rows; row++)
+		{
+			for (int channel = 0; channel < SensorChannelCount; channel++)
+			{
+				reading.Temperatures[channel] = std::round((20 + row * 0.001 + channel * 0.5 + std::sin(row * 0.1 + channel)) * 100) / 100;
+			}
+			time += 1000 + (long long)(row % 7) - 3;
+			archive->Append(reading, time);
+
+			// Full blocks are only dropped while the writer is busy with the other one
+			while (row % ArchiveBlockRows == 0 && archive->RowsWritten() < row)
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		}
+	}
+
+	TelemetryArchiveReader reader(path);
+	for (auto _ : state)
+	{
+		double sum = 0;
+		reader.Scan(LLONG_MIN, LLONG_MAX, [&sum](ArchiveRow const& row) { sum += row.Values[TelemetryField::CurrentTemperature]; });
+		benchmark::DoNotOptimize(sum);
+	}
+
+	state.SetItemsProcessed(state.iterations() * rows);
+	state.counters["segments"] = (double)reader.Segments().size();
+	std::filesystem::remove_all(directory);
+}
+BENCHMARK(BM_ArchiveScan)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char** argv)
+{
+	// Logging on the measured paths would dominate the timings
+	spdlog::set_level(spdlog::level::off);
+
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+	{
+		return 1;
+	}
+
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
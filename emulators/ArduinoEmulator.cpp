@@ -0,0 +1,165 @@
+#include "ArduinoEmulator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+ArduinoEmulator::ArduinoEmulator(PseudoTerminal* terminal, ThermalModel* model, double linesPerSecond, double noise, bool binary, unsigned char channelMask)
+	: terminal(terminal),
+	model(model),
+	linePeriod((long long)(1e9 / std::max(linesPerSecond, 0.001))),
+	noise(noise),
+	binary(binary),
+	channelMask(channelMask),
+	running(false),
+	linesWritten(0),
+	linesDropped(0),
+	bytesWritten(0),
+	commands(0)
+{
+}
+
+ArduinoEmulator::~ArduinoEmulator()
+{
+	this->Stop();
+}
+
+void ArduinoEmulator::Start()
+{
+	this->running = true;
+	this->thread = std::thread(&ArduinoEmulator::Run, this);
+}
+
+void ArduinoEmulator::Stop()
+{
+	this->running = false;
+
+	if (this->thread.joinable())
+	{
+		this->thread.join();
+	}
+}
+
+unsigned long long ArduinoEmulator::LinesWritten() const
+{
+	return this->linesWritten.load();
+}
+
+unsigned long long ArduinoEmulator::LinesDropped() const
+{
+	return this->linesDropped.load();
+}
+
+unsigned long long ArduinoEmulator::BytesWritten() const
+{
+	return this->bytesWritten.load();
+}
+
+unsigned long long ArduinoEmulator::Commands() const
+{
+	return this->commands.load();
+}
+
+void ArduinoEmulator::Run()
+{
+	std::mt19937 generator(std::random_device{}());
+	std::normal_distribution<double> noiseDistribution(0.0, this->noise > 0 ? this->noise : 1.0);
+
+	auto started = std::chrono::steady_clock::now();
+	auto nextLine = started;
+	SensorFrameDecoder decoder;
+	char line[32];
+
+	while (this->running)
+	{
+		double temperature = this->model->Temperature();
+		std::vector<unsigned char> frame;
+		size_t length;
+
+		if (this->binary)
+		{
+			this->ReadCommands(decoder);
+
+			// Thermocouples further from the heater read a little lower
+			SensorReading reading;
+			reading.DeviceTime = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+			reading.ChannelMask = this->channelMask;
+			for (int channel = 0; channel < SensorChannelCount; channel++)
+			{
+				reading.Temperatures[channel] = temperature - 0.5 * channel + (this->noise > 0 ? noiseDistribution(generator) : 0);
+			}
+
+			frame = EncodeSensorReading(reading);
+			length = frame.size();
+		}
+		else
+		{
+			if (this->noise > 0)
+			{
+				temperature += noiseDistribution(generator);
+			}
+
+			length = (size_t)snprintf(line, sizeof(line), "%.2f\r\n", temperature);
+		}
+
+		auto written = this->terminal->Write(this->binary ? (const char*)frame.data() : line, length);
+
+		// A UART keeps transmitting whether or not anybody listens, what does not fit is lost
+		if (written == length)
+		{
+			this->linesWritten++;
+		}
+		else
+		{
+			this->linesDropped++;
+		}
+		this->bytesWritten += written;
+
+		// Paced against absolute deadlines, so the rate does not drift with the time spent writing
+		nextLine += this->linePeriod;
+		std::this_thread::sleep_until(nextLine);
+	}
+}
+
+void ArduinoEmulator::ReadCommands(SensorFrameDecoder& decoder)
+{
+	char buffer[64];
+	auto received = this->terminal->Read(buffer, sizeof(buffer), std::chrono::milliseconds(0));
+
+	decoder.Feed((const unsigned char*)buffer, received, [this](SensorFrame const& frame)
+	{
+		unsigned char status = 0;
+
+		if (frame.Type == SensorSetSampleRate && frame.Size == 2)
+		{
+			int rate = frame.Payload[0] | (frame.Payload[1] << 8);
+			if (rate > 0)
+			{
+				this->linePeriod = std::chrono::nanoseconds((long long)(1e9 / rate));
+				spdlog::info("Arduino emulator :: Sample rate set to {} samples/s", rate);
+			}
+			else
+			{
+				status = 1;
+			}
+		}
+		else if (frame.Type == SensorSetChannels && frame.Size == 1)
+		{
+			this->channelMask = frame.Payload[0];
+			spdlog::info("Arduino emulator :: Channel mask set to {:#04x}", this->channelMask);
+		}
+		else
+		{
+			spdlog::warn("Arduino emulator :: Unknown command {:#x}", frame.Type);
+			status = 2;
+		}
+
+		this->commands++;
+
+		unsigned char ack[] = { frame.Type, status };
+		auto reply = EncodeSensorFrame(SensorAck, ack, sizeof(ack));
+		this->terminal->Write((const char*)reply.data(), reply.size());
+	});
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "PseudoTerminal.h"
+#include "SensorProtocol.h"
+#include "ThermalModel.h"
+
+/// Sends the heater temperature at a fixed rate, like the Arduino thermometer. Old firmware sends
+/// text lines, binary firmware sends framed multi-channel samples and takes rate and channel commands.
+class ArduinoEmulator
+{
+public:
+	/// noise is the standard deviation (in degrees) added to every reading. In binary mode
+	/// channelMask selects the thermocouples sampled until the controller sets other ones.
+	ArduinoEmulator(PseudoTerminal* terminal, ThermalModel* model, double linesPerSecond, double noise, bool binary = false, unsigned char channelMask = 1);
+	~ArduinoEmulator();
+
+	ArduinoEmulator(const ArduinoEmulator&) = delete;
+	ArduinoEmulator& operator=(const ArduinoEmulator&) = delete;
+
+	void Start();
+	void Stop();
+
+	/// Lines, or frames in binary mode
+	unsigned long long LinesWritten() const;
+	/// Lines that did not fit into the terminal buffer because nobody was reading
+	unsigned long long LinesDropped() const;
+	unsigned long long BytesWritten() const;
+	/// Commands received from the controller in binary mode
+	unsigned long long Commands() const;
+
+private:
+	PseudoTerminal* terminal;
+	ThermalModel* model;
+	/// Changed by sample rate commands, only touched by the emulator thread
+	std::chrono::nanoseconds linePeriod;
+	const double noise;
+	const bool binary;
+	unsigned char channelMask;
+
+	std::atomic<bool> running;
+	std::thread thread;
+	std::atomic<unsigned long long> linesWritten;
+	std::atomic<unsigned long long> linesDropped;
+	std::atomic<unsigned long long> bytesWritten;
+	std::atomic<unsigned long long> commands;
+
+	void Run();
+	/// Applies the commands the controller sent since the last line
+	void ReadCommands(SensorFrameDecoder& decoder);
+};
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <spdlog/spdlog.h>
+
+#include "ArduinoEmulator.h"
+#include "PowerSupplyEmulator.h"
+#include "PseudoTerminal.h"
+#include "ThermalModel.h"
+
+// Emulates the Arduino thermometer and the heater power supply on Linux pseudo-terminals.
+// Point arduinoPortName and powerSupplyPortName in config.txt at the printed links.
+
+namespace
+{
+	std::atomic<bool> interrupted(false);
+
+	void OnSignal(int)
+	{
+		interrupted = true;
+	}
+
+	const std::map<std::string, std::string> Defaults = {
+		{ "--arduino", "/tmp/ttyWDS-arduino" },
+		{ "--arduino-protocol", "ascii" },
+		{ "--channels", "1" },
+		{ "--psu", "/tmp/ttyWDS-psu" },
+		{ "--rate", "10" },
+		{ "--noise", "0.1" },
+		{ "--response-delay", "20" },
+		{ "--command-interval", "0" },
+		{ "--ambient", "22" },
+		{ "--time-constant", "30000" },
+		{ "--duration", "0" },
+		{ "--report", "5" },
+	};
+
+	void PrintUsage()
+	{
+		spdlog::info("Usage: device_emulators [option value]...");
+		for (auto const& option : Defaults)
+		{
+			spdlog::info("  {} (default {})", option.first, option.second);
+		}
+		spdlog::info("  --arduino or --psu set to \"off\" disables that device; --arduino-protocol ascii or binary, --channels is the");
+		spdlog::info("  initial channel mask of binary firmware; --rate in lines (frames) per s, --noise in degrees,");
+		spdlog::info("  --response-delay, --command-interval and --time-constant in ms, --duration and --report in s (0 runs until interrupted)");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	auto options = Defaults;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (options.count(option) == 0 || i + 1 == argc)
+		{
+			PrintUsage();
+			return option == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		options[option] = argv[++i];
+	}
+
+	try
+	{
+		ThermalModel model(std::stod(options["--ambient"]), std::chrono::milliseconds(std::stoi(options["--time-constant"])));
+
+		std::unique_ptr<PseudoTerminal> arduinoTerminal;
+		std::unique_ptr<ArduinoEmulator> arduino;
+		if (options["--arduino"] != "off")
+		{
+			arduinoTerminal.reset(new PseudoTerminal(options["--arduino"]));
+			bool binary = options["--arduino-protocol"] == "binary";
+			arduino.reset(new ArduinoEmulator(arduinoTerminal.get(), &model, std::stod(options["--rate"]), std::stod(options["--noise"]), binary, (unsigned char)std::stoi(options["--channels"])));
+			spdlog::info("Arduino emulator :: {} -> {}, {} {}/s", arduinoTerminal->LinkPath(), arduinoTerminal->SlavePath(), options["--rate"], binary ? "frames" : "lines");
+		}
+
+		std::unique_ptr<PseudoTerminal> supplyTerminal;
+		std::unique_ptr<PowerSupplyEmulator> supply;
+		if (options["--psu"] != "off")
+		{
+			supplyTerminal.reset(new PseudoTerminal(options["--psu"]));
+			supply.reset(new PowerSupplyEmulator(supplyTerminal.get(), &model,
+				std::chrono::milliseconds(std::stoi(options["--response-delay"])),
+				std::chrono::milliseconds(std::stoi(options["--command-interval"]))));
+			spdlog::info("Power supply emulator :: {} -> {}", supplyTerminal->LinkPath(), supplyTerminal->SlavePath());
+		}
+
+		std::signal(SIGINT, OnSignal);
+		std::signal(SIGTERM, OnSignal);
+
+		if (arduino)
+		{
+			arduino->Start();
+		}
+		if (supply)
+		{
+			supply->Start();
+		}
+
+		auto started = std::chrono::steady_clock::now();
+		auto duration = std::chrono::seconds(std::stoi(options["--duration"]));
+		auto reportInterval = std::chrono::seconds(std::max(std::stoi(options["--report"]), 1));
+		auto nextReport = started + reportInterval;
+
+		for (;;)
+		{
+			auto now = std::chrono::steady_clock::now();
+			bool finished = interrupted || (duration.count() > 0 && now - started >= duration);
+
+			if (now >= nextReport || finished)
+			{
+				double elapsed = std::chrono::duration<double>(now - started).count();
+				nextReport += reportInterval;
+
+				if (arduino)
+				{
+					spdlog::info("Arduino emulator :: {} lines ({:.1f} lines/s, {} bytes), {} dropped, {} commands, temperature {:.2f}",
+						arduino->LinesWritten(), arduino->LinesWritten() / elapsed, arduino->BytesWritten(), arduino->LinesDropped(), arduino->Commands(), model.Temperature());
+				}
+				if (supply)
+				{
+					spdlog::info("Power supply emulator :: {} commands, {} unknown, {} overruns, output {} {:.2f} V {:.2f} A",
+						supply->Commands(), supply->UnknownCommands(), supply->Overruns(), supply->OutputEnabled() ? "on" : "off", supply->Voltage(), supply->CurrentLimit());
+				}
+			}
+
+			if (finished)
+			{
+				break;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+
+		// Dropped lines mean the reader could not keep up, which a CI run treats as a failure
+		bool keptUp = !arduino || arduino->LinesDropped() == 0;
+		return keptUp ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	catch (std::exception const& e)
+	{
+		spdlog::error("Error: {} ", e.what());
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,178 @@
+#include "PowerSupplyEmulator.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <spdlog/spdlog.h>
+
+PowerSupplyEmulator::PowerSupplyEmulator(PseudoTerminal* terminal, ThermalModel* model, std::chrono::milliseconds responseDelay, std::chrono::milliseconds minCommandInterval)
+	: terminal(terminal),
+	model(model),
+	responseDelay(responseDelay),
+	minCommandInterval(minCommandInterval),
+	running(false),
+	commands(0),
+	unknownCommands(0),
+	overruns(0),
+	outputEnabled(false),
+	preset(0),
+	voltage(0),
+	currentLimit(0)
+{
+}
+
+PowerSupplyEmulator::~PowerSupplyEmulator()
+{
+	this->Stop();
+}
+
+void PowerSupplyEmulator::Start()
+{
+	this->running = true;
+	this->thread = std::thread(&PowerSupplyEmulator::Run, this);
+}
+
+void PowerSupplyEmulator::Stop()
+{
+	this->running = false;
+
+	if (this->thread.joinable())
+	{
+		this->thread.join();
+	}
+}
+
+unsigned long long PowerSupplyEmulator::Commands() const
+{
+	return this->commands.load();
+}
+
+unsigned long long PowerSupplyEmulator::UnknownCommands() const
+{
+	return this->unknownCommands.load();
+}
+
+unsigned long long PowerSupplyEmulator::Overruns() const
+{
+	return this->overruns.load();
+}
+
+double PowerSupplyEmulator::Voltage()
+{
+	std::lock_guard<std::mutex> lock(this->stateMutex);
+	return this->voltage;
+}
+
+double PowerSupplyEmulator::CurrentLimit()
+{
+	std::lock_guard<std::mutex> lock(this->stateMutex);
+	return this->currentLimit;
+}
+
+bool PowerSupplyEmulator::OutputEnabled()
+{
+	std::lock_guard<std::mutex> lock(this->stateMutex);
+	return this->outputEnabled;
+}
+
+void PowerSupplyEmulator::Run()
+{
+	const std::string reply = "OK\r";
+	char buffer[256];
+	std::string command;
+
+	while (this->running)
+	{
+		// Short timeout, so that Stop does not wait long for an idle line
+		auto received = this->terminal->Read(buffer, sizeof(buffer), std::chrono::milliseconds(50));
+
+		for (size_t i = 0; i < received; i++)
+		{
+			// Terminal programs used for manual testing send CR LF
+			if (buffer[i] == '\n')
+			{
+				continue;
+			}
+
+			if (buffer[i] != '\r')
+			{
+				command += buffer[i];
+				continue;
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			bool overrun;
+			{
+				std::lock_guard<std::mutex> lock(this->stateMutex);
+				overrun = this->minCommandInterval.count() > 0 && this->commands > 0 && now - this->lastCommand < this->minCommandInterval;
+				this->lastCommand = now;
+			}
+
+			if (overrun)
+			{
+				spdlog::warn("Power supply emulator :: Ignored {}, sent too soon after the previous command", command);
+				this->overruns++;
+			}
+			else if (this->Execute(command))
+			{
+				this->commands++;
+				std::this_thread::sleep_for(this->responseDelay);
+				this->terminal->Write(reply.data(), reply.size());
+			}
+			else
+			{
+				spdlog::warn("Power supply emulator :: Unknown command {}", command);
+				this->unknownCommands++;
+			}
+
+			command.clear();
+		}
+	}
+}
+
+bool PowerSupplyEmulator::Execute(std::string const& command)
+{
+	if (command.size() < 4)
+	{
+		return false;
+	}
+
+	auto name = command.substr(0, 4);
+	auto argument = command.substr(4);
+
+	// Arguments are plain decimal numbers, optionally after a space
+	char* end;
+	long value = std::strtol(argument.c_str(), &end, 10);
+	if (argument.empty() || *end != '\0')
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(this->stateMutex);
+
+	if (name == "SOUT")
+	{
+		this->outputEnabled = value != 0;
+	}
+	else if (name == "SABC")
+	{
+		this->preset = (int)value;
+	}
+	else if (name == "VOLT")
+	{
+		this->voltage = value / 100.0;
+	}
+	else if (name == "CURR")
+	{
+		this->currentLimit = value / 100.0;
+	}
+	else
+	{
+		return false;
+	}
+
+	spdlog::debug("Power supply emulator :: {} (output {}, preset {}, {:.2f} V, {:.2f} A)", command, this->outputEnabled ? "on" : "off", this->preset, this->voltage, this->currentLimit);
+
+	// Without a current limit the supply delivers nothing into the heater
+	this->model->SetSupplyVoltage(this->voltage, this->outputEnabled && this->currentLimit > 0);
+	return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "PseudoTerminal.h"
+#include "ThermalModel.h"
+
+/// Programmable power supply answering the commands the controller sends:
+///  - SOUT<n>   output on (1) or off (0)
+///  - SABC <n>  selects preset n
+///  - VOLT <n>  output voltage in hundredths of a volt
+///  - CURR <n>  current limit in hundredths of an ampere
+/// Every command is terminated by CR and answered with "OK\r" after the response delay.
+class PowerSupplyEmulator
+{
+public:
+	/// Commands arriving sooner than minCommandInterval after the previous one are ignored, as by the real
+	/// supply, and counted as overruns. Zero accepts every command.
+	PowerSupplyEmulator(PseudoTerminal* terminal, ThermalModel* model, std::chrono::milliseconds responseDelay, std::chrono::milliseconds minCommandInterval);
+	~PowerSupplyEmulator();
+
+	PowerSupplyEmulator(const PowerSupplyEmulator&) = delete;
+	PowerSupplyEmulator& operator=(const PowerSupplyEmulator&) = delete;
+
+	void Start();
+	void Stop();
+
+	/// Commands accepted since start
+	unsigned long long Commands() const;
+	unsigned long long UnknownCommands() const;
+	unsigned long long Overruns() const;
+	double Voltage();
+	double CurrentLimit();
+	bool OutputEnabled();
+
+private:
+	PseudoTerminal* terminal;
+	ThermalModel* model;
+	const std::chrono::milliseconds responseDelay;
+	const std::chrono::milliseconds minCommandInterval;
+
+	std::atomic<bool> running;
+	std::thread thread;
+	std::atomic<unsigned long long> commands;
+	std::atomic<unsigned long long> unknownCommands;
+	std::atomic<unsigned long long> overruns;
+
+	/// Guards the output state below
+	std::mutex stateMutex;
+	bool outputEnabled;
+	int preset;
+	double voltage;
+	double currentLimit;
+	std::chrono::steady_clock::time_point lastCommand;
+
+	void Run();
+	/// Applies one command, returns false if it is not understood
+	bool Execute(std::string const& command);
+};
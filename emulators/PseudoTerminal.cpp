@@ -0,0 +1,97 @@
+#include "PseudoTerminal.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace
+{
+	std::runtime_error SystemError(std::string const& what)
+	{
+		return std::runtime_error(what + ": " + std::strerror(errno));
+	}
+}
+
+PseudoTerminal::PseudoTerminal(std::string linkPath)
+	: master(-1),
+	slave(-1),
+	linkPath(linkPath)
+{
+	this->master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (this->master < 0)
+	{
+		throw SystemError("Cannot open pseudo-terminal");
+	}
+
+	if (grantpt(this->master) != 0 || unlockpt(this->master) != 0)
+	{
+		close(this->master);
+		throw SystemError("Cannot unlock pseudo-terminal");
+	}
+
+	this->slavePath = ptsname(this->master);
+	this->slave = open(this->slavePath.c_str(), O_RDWR | O_NOCTTY);
+	if (this->slave < 0)
+	{
+		close(this->master);
+		throw SystemError("Cannot open " + this->slavePath);
+	}
+
+	// Like a serial line: no echo, no line editing, no CR/LF translation
+	termios settings;
+	tcgetattr(this->slave, &settings);
+	cfmakeraw(&settings);
+	tcsetattr(this->slave, TCSANOW, &settings);
+
+	unlink(this->linkPath.c_str());
+	if (symlink(this->slavePath.c_str(), this->linkPath.c_str()) != 0)
+	{
+		close(this->slave);
+		close(this->master);
+		throw SystemError("Cannot link " + this->linkPath);
+	}
+}
+
+PseudoTerminal::~PseudoTerminal()
+{
+	unlink(this->linkPath.c_str());
+	close(this->slave);
+	close(this->master);
+}
+
+std::string const& PseudoTerminal::SlavePath() const
+{
+	return this->slavePath;
+}
+
+std::string const& PseudoTerminal::LinkPath() const
+{
+	return this->linkPath;
+}
+
+size_t PseudoTerminal::Write(const char* data, size_t size)
+{
+	auto written = write(this->master, data, size);
+	return written < 0 ? 0 : (size_t)written;
+}
+
+size_t PseudoTerminal::Read(char* buffer, size_t size, std::chrono::milliseconds timeout)
+{
+	pollfd descriptor;
+	descriptor.fd = this->master;
+	descriptor.events = POLLIN;
+	descriptor.revents = 0;
+
+	if (poll(&descriptor, 1, (int)timeout.count()) <= 0 || (descriptor.revents & POLLIN) == 0)
+	{
+		return 0;
+	}
+
+	auto received = read(this->master, buffer, size);
+	return received < 0 ? 0 : (size_t)received;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <chrono>
+#include <string>
+
+/// Master side of a Linux pseudo-terminal. The controller opens the slave side like a serial
+/// port, through a symlink with a stable name that can go into config.txt.
+class PseudoTerminal
+{
+public:
+	/// Opens a raw pseudo-terminal and links linkPath to its slave, throws on failure
+	PseudoTerminal(std::string linkPath);
+	~PseudoTerminal();
+
+	PseudoTerminal(const PseudoTerminal&) = delete;
+	PseudoTerminal& operator=(const PseudoTerminal&) = delete;
+
+	/// Path of the slave device, e.g. /dev/pts/3
+	std::string const& SlavePath() const;
+	std::string const& LinkPath() const;
+
+	/// Writes as much of data as fits into the terminal buffer without blocking, returns the number of bytes written
+	size_t Write(const char* data, size_t size);
+	/// Waits at most timeout for input, returns the number of bytes read, zero if none arrived
+	size_t Read(char* buffer, size_t size, std::chrono::milliseconds timeout);
+
+private:
+	int master;
+	/// Kept open so the terminal survives the controller closing and reopening the port
+	int slave;
+	std::string slavePath;
+	std::string linkPath;
+};
@@ -0,0 +1,40 @@
+#include "ThermalModel.h"
+
+#include <algorithm>
+#include <cmath>
+
+const double ThermalModel::VoltsPerDegree = 0.025643;
+
+ThermalModel::ThermalModel(double ambientTemperature, std::chrono::milliseconds timeConstant)
+	: ambientTemperature(ambientTemperature),
+	timeConstant(std::max<double>((double)timeConstant.count() / 1000.0, 0.001)),
+	temperature(ambientTemperature),
+	targetTemperature(ambientTemperature),
+	updatedAt(std::chrono::steady_clock::now())
+{
+}
+
+void ThermalModel::SetSupplyVoltage(double voltage, bool outputEnabled)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->Advance();
+
+	// The heater cannot cool below ambient
+	this->targetTemperature = outputEnabled ? std::max(this->ambientTemperature, voltage / VoltsPerDegree) : this->ambientTemperature;
+}
+
+double ThermalModel::Temperature()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->Advance();
+	return this->temperature;
+}
+
+void ThermalModel::Advance()
+{
+	auto now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - this->updatedAt).count();
+	this->updatedAt = now;
+
+	this->temperature += (this->targetTemperature - this->temperature) * (1.0 - std::exp(-elapsed / this->timeConstant));
+}
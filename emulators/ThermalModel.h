@@ -0,0 +1,29 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+
+/// Heater driven by the power supply and read by the Arduino thermometer. The temperature
+/// follows the one the supply voltage is meant for with a first order lag.
+class ThermalModel
+{
+public:
+	/// timeConstant is the time the temperature needs for 63% of a step
+	ThermalModel(double ambientTemperature, std::chrono::milliseconds timeConstant);
+
+	/// Called by the power supply whenever its output changes
+	void SetSupplyVoltage(double voltage, bool outputEnabled);
+	double Temperature();
+
+	/// Volts per degree, as used by the controller to pick the supply voltage
+	static const double VoltsPerDegree;
+
+private:
+	std::mutex mutex;
+	const double ambientTemperature;
+	const double timeConstant;
+	double temperature;
+	double targetTemperature;
+	std::chrono::steady_clock::time_point updatedAt;
+
+	void Advance();
+};
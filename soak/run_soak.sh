@@ -0,0 +1,13 @@
+#!/bin/sh
+# usage: run_soak.sh device_emulators soak_controller soak.txt
+# Serves the rig's Arduino and power supply from the emulators for the length of the soak.
+set -u
+
+"$1" --duration 0 &
+emulators=$!
+trap 'kill $emulators 2>/dev/null' EXIT
+
+# The controller opens the serial ports right away, give the emulators time to link them
+sleep 1
+
+"$2" --soak "$3"